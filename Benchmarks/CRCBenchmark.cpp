@@ -0,0 +1,213 @@
+/*
+  ==============================================================================
+
+    CRC microbenchmark: what each CRC.h path and the CRC-32C implementations
+    cost per call and per byte on 4 B, 64 B, 1 KB and 64 KB inputs (64 KB
+    being about the largest DataChannel message).
+
+    Paths:
+        bits        CRC::CalculateBits with Parameters, bit-by-bit
+        parameters  CRC::Calculate with Parameters, bit-by-bit per byte
+        table       CRC::Calculate with a Table, one lookup per byte
+        crc32c-*    CRC32C.cpp, every implementation this CPU supports, and
+                    the dispatching CRC::Calculate(..., CRC_32_C_Accelerated())
+
+    Not part of the plugin build. From the repository root:
+
+        c++ -std=c++17 -O2 -ISource Benchmarks/CRCBenchmark.cpp Source/CRC32C.cpp -o crc-benchmark
+        ./crc-benchmark [--json] [--quick]
+
+    Prints one CSV row per measurement (or a JSON array with --json):
+
+        algorithm,path,bytes,calls,ns_per_call,ns_per_byte,mb_per_s,crc
+
+    Every measurement is the fastest of several runs of at least the
+    minimum run time; --quick shortens that for a smoke test.
+
+  ==============================================================================
+*/
+
+#define CRCPP_INCLUDE_ESOTERIC_CRC_DEFINITIONS
+#include "CRC.h"
+#include "CRC32C.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace
+{
+	using Clock = std::chrono::steady_clock;
+
+	constexpr std::size_t inputSizes[] = { 4, 64, 1024, 65536 };
+	constexpr int numRuns = 5;
+
+	struct Options
+	{
+		bool json = false;
+		Clock::duration minRunTime = std::chrono::milliseconds(50);
+	};
+
+	struct Result
+	{
+		std::string algorithm;
+		std::string path;
+		std::size_t bytes = 0;
+		std::uint64_t calls = 0;
+		double nsPerCall = 0.0;
+		std::uint64_t crc = 0;
+	};
+
+	//keeps the compiler from dropping the work
+	volatile std::uint64_t sink = 0;
+
+	template <typename Function>
+	double timeCalls(Function&& function, std::uint64_t calls)
+	{
+		std::uint64_t accumulated = 0;
+		const auto start = Clock::now();
+
+		for (std::uint64_t i = 0; i < calls; i++)
+			accumulated += function();
+
+		const auto elapsed = Clock::now() - start;
+		sink = sink + accumulated;
+		return double(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+	}
+
+	//doubles the number of calls until one run takes the minimum run time, then keeps the best of numRuns
+	template <typename Function>
+	Result measure(const Options& options, const char* algorithm, const char* path, std::size_t bytes, Function&& function)
+	{
+		const auto minNanos = double(std::chrono::duration_cast<std::chrono::nanoseconds>(options.minRunTime).count());
+		std::uint64_t calls = 1;
+
+		while (timeCalls(function, calls) < minNanos && calls < (std::uint64_t(1) << 40))
+			calls *= 2;
+
+		auto best = timeCalls(function, calls);
+
+		for (int run = 1; run < numRuns; run++)
+			best = std::min(best, timeCalls(function, calls));
+
+		Result result;
+		result.algorithm = algorithm;
+		result.path = path;
+		result.bytes = bytes;
+		result.calls = calls;
+		result.nsPerCall = best / double(calls);
+		result.crc = std::uint64_t(function());
+		return result;
+	}
+
+	template <typename CRCType, crcpp_uint16 CRCWidth>
+	void benchmarkParameters(const Options& options, std::vector<Result>& results, const char* algorithm,
+		const CRC::Parameters<CRCType, CRCWidth>& parameters, const std::vector<std::uint8_t>& input)
+	{
+		const CRC::Table<CRCType, CRCWidth> table(parameters);
+
+		for (const auto size : inputSizes)
+		{
+			const auto* data = input.data();
+
+			results.push_back(measure(options, algorithm, "bits", size,
+				[&] { return CRC::CalculateBits(data, size * 8, parameters); }));
+
+			results.push_back(measure(options, algorithm, "parameters", size,
+				[&] { return CRC::Calculate(data, size, parameters); }));
+
+			results.push_back(measure(options, algorithm, "table", size,
+				[&] { return CRC::Calculate(data, size, table); }));
+		}
+	}
+
+	void benchmarkCrc32c(const Options& options, std::vector<Result>& results, const std::vector<std::uint8_t>& input)
+	{
+		using CRC32C::Implementation;
+
+		for (const auto size : inputSizes)
+		{
+			const auto* data = input.data();
+
+			for (const auto implementation : { Implementation::slicingBy8, Implementation::sse42, Implementation::armv8 })
+			{
+				if (!CRC32C::isSupported(implementation))
+					continue;
+
+				const auto path = std::string("crc32c-") + CRC32C::getImplementationName(implementation);
+				results.push_back(measure(options, "CRC-32C", path.c_str(), size,
+					[&] { return CRC32C::calculate(implementation, data, size); }));
+			}
+
+			results.push_back(measure(options, "CRC-32C", "crc32c-dispatch", size,
+				[&] { return CRC::Calculate(data, size, CRC::CRC_32_C_Accelerated()); }));
+		}
+	}
+
+	void print(const Options& options, const std::vector<Result>& results)
+	{
+		if (!options.json)
+			std::printf("algorithm,path,bytes,calls,ns_per_call,ns_per_byte,mb_per_s,crc\n");
+		else
+			std::printf("[\n");
+
+		for (std::size_t i = 0; i < results.size(); i++)
+		{
+			const auto& r = results[i];
+			const auto nsPerByte = r.nsPerCall / double(r.bytes);
+			const auto megabytesPerSecond = 1000.0 / nsPerByte;
+
+			if (!options.json)
+				std::printf("%s,%s,%zu,%llu,%.3f,%.4f,%.1f,0x%llx\n", r.algorithm.c_str(), r.path.c_str(), r.bytes,
+					(unsigned long long) r.calls, r.nsPerCall, nsPerByte, megabytesPerSecond, (unsigned long long) r.crc);
+			else
+				std::printf("  {\"algorithm\": \"%s\", \"path\": \"%s\", \"bytes\": %zu, \"calls\": %llu, \"ns_per_call\": %.3f, "
+					"\"ns_per_byte\": %.4f, \"mb_per_s\": %.1f, \"crc\": \"0x%llx\"}%s\n", r.algorithm.c_str(), r.path.c_str(),
+					r.bytes, (unsigned long long) r.calls, r.nsPerCall, nsPerByte, megabytesPerSecond,
+					(unsigned long long) r.crc, i + 1 < results.size() ? "," : "");
+		}
+
+		if (options.json)
+			std::printf("]\n");
+	}
+}
+
+int main(int argc, char** argv)
+{
+	Options options;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (std::strcmp(argv[i], "--json") == 0)
+			options.json = true;
+		else if (std::strcmp(argv[i], "--quick") == 0)
+			options.minRunTime = std::chrono::milliseconds(2);
+		else
+		{
+			std::fprintf(stderr, "usage: %s [--json] [--quick]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	// fixed seed, the crc column lets runs on different machines be checked against each other
+	std::vector<std::uint8_t> input(*std::max_element(std::begin(inputSizes), std::end(inputSizes)));
+	std::mt19937 random(1234);
+	std::generate(input.begin(), input.end(), [&] { return std::uint8_t(random()); });
+
+	std::vector<Result> results;
+	benchmarkParameters(options, results, "CRC-8", CRC::CRC_8(), input);
+	benchmarkParameters(options, results, "CRC-16/ARC", CRC::CRC_16_ARC(), input);
+	benchmarkParameters(options, results, "CRC-16/CCITT-FALSE", CRC::CRC_16_CCITTFALSE(), input);
+	benchmarkParameters(options, results, "CRC-32", CRC::CRC_32(), input);
+	benchmarkParameters(options, results, "CRC-32C", CRC::CRC_32_C(), input);
+	benchmarkParameters(options, results, "CRC-64", CRC::CRC_64(), input);
+	benchmarkCrc32c(options, results, input);
+
+	print(options, results);
+	return 0;
+}
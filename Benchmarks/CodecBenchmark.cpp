@@ -0,0 +1,345 @@
+/*
+  ==============================================================================
+
+    MidiCodec microbenchmark: what encoding and decoding a stream of MIDI
+    messages costs per message, with the status table and without it.
+
+    Paths:
+        table       MidiCodec::encode()/decode(), one table lookup per message
+        switch      the same loops with MidiCodec::makeStatusInfo() evaluated
+                    at run time, the branches the table replaces
+
+    The stream is 4096 messages in a fixed mix of what a keyboard and a
+    controller surface send: note ons and offs on all 16 channels,
+    controllers, pitch bend, both aftertouches, program changes and MIDI
+    clock. Before measuring, every carried message (every status byte
+    with every data byte value) is encoded, decoded and compared, and
+    every status byte that is not carried must be rejected.
+
+    Not part of the plugin build. From the repository root:
+
+        c++ -std=c++17 -O2 -ISource Benchmarks/CodecBenchmark.cpp -o codec-benchmark
+        ./codec-benchmark [--json] [--quick]
+
+    Prints one CSV row per measurement (or a JSON array with --json):
+
+        operation,path,messages,calls,ns_per_message,messages_per_s,mb_per_s,checksum
+
+    mb_per_s is in wire bytes. Every measurement is the fastest of several
+    runs of at least the minimum run time; --quick shortens that for a
+    smoke test. Exits with 1 if the round trip check fails.
+
+  ==============================================================================
+*/
+
+#include "MidiCodec.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace
+{
+	using Clock = std::chrono::steady_clock;
+
+	constexpr std::size_t numMessages = 4096;
+	constexpr int numRuns = 5;
+
+	struct Options
+	{
+		bool json = false;
+		Clock::duration minRunTime = std::chrono::milliseconds(50);
+	};
+
+	struct Result
+	{
+		std::string operation;
+		std::string path;
+		std::uint64_t calls = 0;
+		double nsPerCall = 0.0;
+		std::uint64_t checksum = 0;
+	};
+
+	//messages back to back, as they are laid out in a batch without the time offsets
+	struct Stream
+	{
+		std::vector<std::uint8_t> messages;
+		std::vector<std::uint8_t> wire;
+		std::size_t numMessages = 0;
+	};
+
+	//keeps the compiler from dropping the work
+	volatile std::uint64_t sink = 0;
+
+	//MidiCodec::encode() with the branches instead of the table
+	std::size_t encodeWithSwitch(const std::uint8_t* message, std::size_t size, std::uint8_t* out) noexcept
+	{
+		if (size == 0)
+			return 0;
+
+		const std::size_t length = MidiCodec::makeStatusInfo(message[0]).length;
+
+		if (length == 0 || size < length)
+			return 0;
+
+		out[0] = message[0];
+
+		for (std::size_t i = 1; i < length; i++)
+			out[i] = message[i] & 0x7f;
+
+		return length;
+	}
+
+	std::size_t decodeWithSwitch(const std::uint8_t* in, std::size_t available, std::uint8_t* message) noexcept
+	{
+		if (available == 0)
+			return 0;
+
+		const std::size_t length = MidiCodec::makeStatusInfo(in[0]).length;
+
+		if (length == 0 || available < length)
+			return 0;
+
+		std::uint8_t highBits = 0;
+		message[0] = in[0];
+
+		for (std::size_t i = 1; i < length; i++)
+		{
+			message[i] = in[i];
+			highBits |= in[i];
+		}
+
+		return (highBits & 0x80) == 0 ? length : 0;
+	}
+
+	//fixed seed, the checksum column lets runs on different machines be checked against each other
+	Stream makeStream()
+	{
+		std::mt19937 random(1234);
+		const auto next = [&](unsigned range) { return std::uint8_t(random() % range); };
+
+		Stream stream;
+
+		for (std::size_t i = 0; i < numMessages; i++)
+		{
+			const auto channel = next(16);
+			const auto pick = next(100);
+			std::uint8_t message[3] = {};
+
+			if (pick < 30)       { message[0] = std::uint8_t(0x90 | channel); message[1] = next(128); message[2] = next(127) + 1; }
+			else if (pick < 60)  { message[0] = std::uint8_t(0x80 | channel); message[1] = next(128); message[2] = next(128); }
+			else if (pick < 80)  { message[0] = std::uint8_t(0xb0 | channel); message[1] = next(120); message[2] = next(128); }
+			else if (pick < 88)  { message[0] = std::uint8_t(0xe0 | channel); message[1] = next(128); message[2] = next(128); }
+			else if (pick < 92)  { message[0] = std::uint8_t(0xd0 | channel); message[1] = next(128); }
+			else if (pick < 95)  { message[0] = std::uint8_t(0xa0 | channel); message[1] = next(128); message[2] = next(128); }
+			else if (pick < 96)  { message[0] = std::uint8_t(0xc0 | channel); message[1] = next(128); }
+			else                 { message[0] = 0xf8; }
+
+			const auto length = MidiCodec::getMessageLength(message[0]);
+			stream.messages.insert(stream.messages.end(), message, message + length);
+		}
+
+		stream.numMessages = numMessages;
+		stream.wire.resize(stream.messages.size());
+		return stream;
+	}
+
+	template <typename Encode>
+	std::uint64_t encodeStream(Stream& stream, Encode&& encode)
+	{
+		std::size_t in = 0, out = 0;
+
+		while (in < stream.messages.size())
+		{
+			const auto length = encode(stream.messages.data() + in, stream.messages.size() - in, stream.wire.data() + out);
+
+			if (length == 0)
+				return 0;
+
+			in += length;
+			out += length;
+		}
+
+		return std::uint64_t(out) + stream.wire[out - 1];
+	}
+
+	template <typename Decode>
+	std::uint64_t decodeStream(const Stream& stream, Decode&& decode)
+	{
+		std::uint8_t message[MidiCodec::maxMessageLength];
+		std::size_t offset = 0;
+		std::uint64_t checksum = 0;
+
+		while (offset < stream.wire.size())
+		{
+			const auto length = decode(stream.wire.data() + offset, stream.wire.size() - offset, message);
+
+			if (length == 0)
+				return 0;
+
+			checksum += message[0] + message[length - 1];
+			offset += length;
+		}
+
+		return checksum;
+	}
+
+	//every status byte with every value of its data bytes, plus the ones that must be rejected; the number of failures
+	int checkRoundTrip()
+	{
+		int failures = 0;
+
+		for (unsigned status = 0; status < 256; status++)
+		{
+			const auto length = MidiCodec::getMessageLength(std::uint8_t(status));
+			std::uint8_t message[3] = { std::uint8_t(status), 0, 0 };
+			std::uint8_t wire[3] = {};
+			std::uint8_t decoded[3] = {};
+
+			if (length == 0)
+			{
+				failures += MidiCodec::encode(message, 3, wire) != 0 ? 1 : 0;
+				failures += MidiCodec::decode(message, 3, decoded) != 0 ? 1 : 0;
+				continue;
+			}
+
+			const unsigned numValues = length == 1 ? 1 : length == 2 ? 128 : 128 * 128;
+
+			for (unsigned value = 0; value < numValues; value++)
+			{
+				message[1] = std::uint8_t(value & 0x7f);
+				message[2] = std::uint8_t(value >> 7);
+
+				const auto encoded = MidiCodec::encode(message, length, wire);
+				const auto consumed = MidiCodec::decode(wire, encoded, decoded);
+
+				if (encoded != length || consumed != length || std::memcmp(message, decoded, length) != 0)
+					failures++;
+			}
+
+			//a data byte with the high bit set is not a message
+			if (length > 1)
+			{
+				wire[0] = std::uint8_t(status);
+				wire[1] = 0x80;
+				failures += MidiCodec::decode(wire, length, decoded) != 0 ? 1 : 0;
+			}
+		}
+
+		return failures;
+	}
+
+	template <typename Function>
+	double timeCalls(Function&& function, std::uint64_t calls)
+	{
+		std::uint64_t accumulated = 0;
+		const auto start = Clock::now();
+
+		for (std::uint64_t i = 0; i < calls; i++)
+			accumulated += function();
+
+		const auto elapsed = Clock::now() - start;
+		sink = sink + accumulated;
+		return double(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+	}
+
+	//doubles the number of calls until one run takes the minimum run time, then keeps the best of numRuns
+	template <typename Function>
+	Result measure(const Options& options, const char* operation, const char* path, Function&& function)
+	{
+		const auto minNanos = double(std::chrono::duration_cast<std::chrono::nanoseconds>(options.minRunTime).count());
+		std::uint64_t calls = 1;
+
+		while (timeCalls(function, calls) < minNanos && calls < (std::uint64_t(1) << 40))
+			calls *= 2;
+
+		auto best = timeCalls(function, calls);
+
+		for (int run = 1; run < numRuns; run++)
+			best = std::min(best, timeCalls(function, calls));
+
+		Result result;
+		result.operation = operation;
+		result.path = path;
+		result.calls = calls;
+		result.nsPerCall = best / double(calls);
+		result.checksum = function();
+		return result;
+	}
+
+	void print(const Options& options, const Stream& stream, const std::vector<Result>& results)
+	{
+		if (!options.json)
+			std::printf("operation,path,messages,calls,ns_per_message,messages_per_s,mb_per_s,checksum\n");
+		else
+			std::printf("[\n");
+
+		for (std::size_t i = 0; i < results.size(); i++)
+		{
+			const auto& r = results[i];
+			const auto nsPerMessage = r.nsPerCall / double(stream.numMessages);
+			const auto messagesPerSecond = 1.0e9 / nsPerMessage;
+			const auto megabytesPerSecond = double(stream.wire.size()) * 1000.0 / r.nsPerCall;
+
+			if (!options.json)
+				std::printf("%s,%s,%zu,%llu,%.3f,%.0f,%.1f,%llu\n", r.operation.c_str(), r.path.c_str(), stream.numMessages,
+					(unsigned long long) r.calls, nsPerMessage, messagesPerSecond, megabytesPerSecond,
+					(unsigned long long) r.checksum);
+			else
+				std::printf("  {\"operation\": \"%s\", \"path\": \"%s\", \"messages\": %zu, \"calls\": %llu, \"ns_per_message\": %.3f, "
+					"\"messages_per_s\": %.0f, \"mb_per_s\": %.1f, \"checksum\": %llu}%s\n", r.operation.c_str(), r.path.c_str(),
+					stream.numMessages, (unsigned long long) r.calls, nsPerMessage, messagesPerSecond, megabytesPerSecond,
+					(unsigned long long) r.checksum, i + 1 < results.size() ? "," : "");
+		}
+
+		if (options.json)
+			std::printf("]\n");
+	}
+}
+
+int main(int argc, char** argv)
+{
+	Options options;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (std::strcmp(argv[i], "--json") == 0)
+			options.json = true;
+		else if (std::strcmp(argv[i], "--quick") == 0)
+			options.minRunTime = std::chrono::milliseconds(2);
+		else
+		{
+			std::fprintf(stderr, "usage: %s [--json] [--quick]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	if (const auto failures = checkRoundTrip())
+	{
+		std::fprintf(stderr, "Round trip check failed for %d messages\n", failures);
+		return 1;
+	}
+
+	auto stream = makeStream();
+	std::vector<Result> results;
+
+	results.push_back(measure(options, "encode", "table",
+		[&] { return encodeStream(stream, MidiCodec::encode); }));
+
+	results.push_back(measure(options, "encode", "switch",
+		[&] { return encodeStream(stream, encodeWithSwitch); }));
+
+	results.push_back(measure(options, "decode", "table",
+		[&] { return decodeStream(stream, MidiCodec::decode); }));
+
+	results.push_back(measure(options, "decode", "switch",
+		[&] { return decodeStream(stream, decodeWithSwitch); }));
+
+	print(options, stream, results);
+	return 0;
+}
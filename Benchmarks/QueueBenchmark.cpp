@@ -0,0 +1,341 @@
+/*
+  ==============================================================================
+
+    Sender pipeline microbenchmark: the SpscQueue processBlock hands its
+    events to the sender through, and the PacketBatcher framing the sender
+    puts them on the wire with.
+
+    Stages and cases:
+        queue       same-thread   push and pop in turn on one thread, the
+                                  cost of the queue without contention
+                    two-threads   one producer, one consumer, each yields
+                                  while the ring is full or empty
+        framing     K events of one block (a K note chord, or a sweep of K
+                    controller values) framed as
+                    batched       one packet for the block, as the sender does
+                    per-event     one packet per event, as before batching
+
+    Not part of the plugin build. From the repository root:
+
+        c++ -std=c++17 -O2 -ISource Benchmarks/QueueBenchmark.cpp Source/PacketFramer.cpp -lpthread -o queue-benchmark
+        ./queue-benchmark [--json] [--quick]
+
+    Prints one CSV row per measurement (or a JSON array with --json):
+
+        stage,case,events,ns_per_event,events_per_s,packets_per_s,packets_per_event,bytes_per_event,checksum
+
+    For the queue, bytes_per_event is the size of one MidiEventRecord and
+    packets_per_s is 0. For the framing, packets_per_s is how many packets
+    one core frames per second and bytes_per_event the wire bytes of the
+    DataChannel messages; every message also pays SCTP, DTLS and UDP
+    headers on top, so packets_per_event is what batching saves there.
+    Every measurement is the fastest of several runs; --quick shortens
+    them for a smoke test.
+
+  ==============================================================================
+*/
+
+#include "MidiEventQueue.h"
+#include "PacketFramer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+	using Clock = std::chrono::steady_clock;
+
+	constexpr int numRuns = 5;
+	constexpr std::uint32_t sampleRate = 48000;
+	constexpr std::size_t framingSizes[] = { 1, 4, 16, 64 };
+
+	using Queue = SpscQueue<MidiEventRecord, 1024>;
+
+	struct Options
+	{
+		bool json = false;
+		Clock::duration minRunTime = std::chrono::milliseconds(50);
+		std::uint64_t queueEvents = std::uint64_t(1) << 23;
+	};
+
+	struct Result
+	{
+		std::string stage;
+		std::string name;
+		std::size_t events = 0;             //per call
+		double nsPerCall = 0.0;
+		double packetsPerCall = 0.0;
+		double bytesPerCall = 0.0;
+		std::uint64_t checksum = 0;
+	};
+
+	//keeps the compiler from dropping the work
+	volatile std::uint64_t sink = 0;
+
+	MidiEventRecord makeEvent(std::uint8_t status, std::uint8_t data1, std::uint8_t data2, std::int64_t timestamp)
+	{
+		MidiEventRecord event;
+		event.data[0] = status;
+		event.data[1] = data1;
+		event.data[2] = data2;
+		event.size = 3;
+		event.timestamp = timestamp;
+		return event;
+	}
+
+	std::vector<MidiEventRecord> makeChord(std::size_t numEvents)
+	{
+		std::vector<MidiEventRecord> events;
+
+		for (std::size_t i = 0; i < numEvents; i++)
+			events.push_back(makeEvent(std::uint8_t(0x90 | (i / 16) % 16), std::uint8_t(36 + i % 64), 100, 0));
+
+		return events;
+	}
+
+	//one controller value every few samples over a 256 sample block
+	std::vector<MidiEventRecord> makeSweep(std::size_t numEvents)
+	{
+		std::vector<MidiEventRecord> events;
+
+		for (std::size_t i = 0; i < numEvents; i++)
+			events.push_back(makeEvent(0xb0, 1, std::uint8_t(i * 127 / numEvents), std::int64_t(i * 256 / numEvents)));
+
+		return events;
+	}
+
+	template <typename Function>
+	double timeCalls(Function&& function, std::uint64_t calls)
+	{
+		std::uint64_t accumulated = 0;
+		const auto start = Clock::now();
+
+		for (std::uint64_t i = 0; i < calls; i++)
+			accumulated += function();
+
+		const auto elapsed = Clock::now() - start;
+		sink = sink + accumulated;
+		return double(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+	}
+
+	//doubles the number of calls until one run takes the minimum run time, then keeps the best of numRuns
+	template <typename Function>
+	double measure(const Options& options, Function&& function, std::uint64_t& calls)
+	{
+		const auto minNanos = double(std::chrono::duration_cast<std::chrono::nanoseconds>(options.minRunTime).count());
+		calls = 1;
+
+		while (timeCalls(function, calls) < minNanos && calls < (std::uint64_t(1) << 40))
+			calls *= 2;
+
+		auto best = timeCalls(function, calls);
+
+		for (int run = 1; run < numRuns; run++)
+			best = std::min(best, timeCalls(function, calls));
+
+		return best / double(calls);
+	}
+
+	Result benchmarkSameThread(const Options& options)
+	{
+		auto queue = std::make_unique<Queue>();
+		const auto event = makeEvent(0x90, 60, 100, 0);
+		MidiEventRecord popped;
+		std::uint64_t calls = 0;
+
+		Result result;
+		result.stage = "queue";
+		result.name = "same-thread";
+		result.events = 1;
+		result.bytesPerCall = double(sizeof(MidiEventRecord));
+		result.nsPerCall = measure(options, [&] {
+			queue->push(event);
+			queue->pop(popped);
+			return std::uint64_t(popped.data[1]);
+		}, calls);
+		result.checksum = popped.data[1];
+		return result;
+	}
+
+	//one run moves queueEvents events from one thread to the other, the best of numRuns counts
+	Result benchmarkTwoThreads(const Options& options)
+	{
+		auto queue = std::make_unique<Queue>();
+		const auto numEvents = options.queueEvents;
+		double best = 0.0;
+		std::uint64_t checksum = 0;
+
+		for (int run = 0; run < numRuns; run++)
+		{
+			std::uint64_t sum = 0;
+			const auto start = Clock::now();
+
+			std::thread consumer([&] {
+				MidiEventRecord event;
+
+				for (std::uint64_t received = 0; received < numEvents;)
+				{
+					if (queue->pop(event))
+					{
+						sum += std::uint64_t(event.timestamp);
+						received++;
+					}
+					else
+					{
+						std::this_thread::yield();
+					}
+				}
+			});
+
+			for (std::uint64_t i = 0; i < numEvents; i++)
+			{
+				const auto event = makeEvent(0x90, std::uint8_t(i & 0x7f), 100, std::int64_t(i & 0xff));
+
+				while (!queue->push(event))
+					std::this_thread::yield();
+			}
+
+			consumer.join();
+
+			const auto elapsed = double(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count());
+			best = run == 0 ? elapsed : std::min(best, elapsed);
+			checksum = sum;
+		}
+
+		Result result;
+		result.stage = "queue";
+		result.name = "two-threads";
+		result.events = 1;
+		result.bytesPerCall = double(sizeof(MidiEventRecord));
+		result.nsPerCall = best / double(numEvents);
+		result.checksum = checksum;
+		return result;
+	}
+
+	Result benchmarkFraming(const Options& options, const std::string& name, const std::vector<MidiEventRecord>& events,
+		bool isBatched)
+	{
+		PacketBatcher batcher;
+		const auto now = PacketBatcher::Clock::now();
+		std::uint32_t sequence = 0;
+		std::size_t numPackets = 0, numBytes = 0;
+
+		const auto frame = [&] {
+			numPackets = 0;
+			numBytes = 0;
+			std::uint64_t crcs = 0;
+
+			const auto finish = [&] {
+				const auto& packet = batcher.finish(sequence++, sampleRate);
+				numPackets++;
+				numBytes += packet.size();
+				crcs += std::uint64_t(packet.back());
+			};
+
+			for (const auto& event : events)
+			{
+				batcher.add(event, now);
+
+				if (!isBatched)
+					finish();
+			}
+
+			if (isBatched)
+				finish();
+
+			return crcs;
+		};
+
+		std::uint64_t calls = 0;
+
+		Result result;
+		result.stage = "framing";
+		result.name = name + (isBatched ? "-batched" : "-per-event");
+		result.events = events.size();
+		result.nsPerCall = measure(options, frame, calls);
+		result.packetsPerCall = double(numPackets);
+		result.bytesPerCall = double(numBytes);
+
+		sequence = 0;
+		result.checksum = frame();
+		return result;
+	}
+
+	void print(const Options& options, const std::vector<Result>& results)
+	{
+		if (!options.json)
+			std::printf("stage,case,events,ns_per_event,events_per_s,packets_per_s,packets_per_event,bytes_per_event,checksum\n");
+		else
+			std::printf("[\n");
+
+		for (std::size_t i = 0; i < results.size(); i++)
+		{
+			const auto& r = results[i];
+			const auto events = double(r.events);
+			const auto nsPerEvent = r.nsPerCall / events;
+			const auto eventsPerSecond = 1.0e9 / nsPerEvent;
+			const auto packetsPerSecond = r.packetsPerCall * 1.0e9 / r.nsPerCall;
+			const auto packetsPerEvent = r.packetsPerCall / events;
+			const auto bytesPerEvent = r.bytesPerCall / events;
+
+			if (!options.json)
+				std::printf("%s,%s,%zu,%.3f,%.0f,%.0f,%.4f,%.2f,%llu\n", r.stage.c_str(), r.name.c_str(), r.events,
+					nsPerEvent, eventsPerSecond, packetsPerSecond, packetsPerEvent, bytesPerEvent,
+					(unsigned long long) r.checksum);
+			else
+				std::printf("  {\"stage\": \"%s\", \"case\": \"%s\", \"events\": %zu, \"ns_per_event\": %.3f, \"events_per_s\": %.0f, "
+					"\"packets_per_s\": %.0f, \"packets_per_event\": %.4f, \"bytes_per_event\": %.2f, \"checksum\": %llu}%s\n",
+					r.stage.c_str(), r.name.c_str(), r.events, nsPerEvent, eventsPerSecond, packetsPerSecond, packetsPerEvent,
+					bytesPerEvent, (unsigned long long) r.checksum, i + 1 < results.size() ? "," : "");
+		}
+
+		if (options.json)
+			std::printf("]\n");
+	}
+}
+
+int main(int argc, char** argv)
+{
+	Options options;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (std::strcmp(argv[i], "--json") == 0)
+			options.json = true;
+		else if (std::strcmp(argv[i], "--quick") == 0)
+		{
+			options.minRunTime = std::chrono::milliseconds(2);
+			options.queueEvents = std::uint64_t(1) << 16;
+		}
+		else
+		{
+			std::fprintf(stderr, "usage: %s [--json] [--quick]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	std::vector<Result> results;
+	results.push_back(benchmarkSameThread(options));
+	results.push_back(benchmarkTwoThreads(options));
+
+	for (const auto size : framingSizes)
+	{
+		const auto chord = makeChord(size);
+		results.push_back(benchmarkFraming(options, "chord-" + std::to_string(size), chord, true));
+		results.push_back(benchmarkFraming(options, "chord-" + std::to_string(size), chord, false));
+	}
+
+	const auto sweep = makeSweep(128);
+	results.push_back(benchmarkFraming(options, "sweep-128", sweep, true));
+	results.push_back(benchmarkFraming(options, "sweep-128", sweep, false));
+
+	print(options, results);
+	return 0;
+}
@@ -0,0 +1,312 @@
+/*
+  ==============================================================================
+
+    The relay's forwarding core.
+
+  ==============================================================================
+*/
+
+#include "ForwardingCore.h"
+
+#include <algorithm>
+
+ForwardingCore::Participant::Participant(std::uint16_t idToUse, std::shared_ptr<PacketSink> sinkToUse, const Settings& settings)
+	: id(idToUse), sink(std::move(sinkToUse)), bundler(settings.maxBundleSize, PacketFormat::relayBundle)
+{
+}
+
+ForwardingCore::ForwardingCore(const Settings& settingsToUse)
+	: settings(settingsToUse), participants(std::make_shared<const Snapshot>())
+{
+	const auto numWorkers = settings.numWorkers > 0 ? unsigned(settings.numWorkers)
+	                                                : std::max(1u, std::thread::hardware_concurrency());
+
+	for (unsigned i = 0; i < numWorkers; i++)
+		workers.push_back(std::make_unique<Worker>());
+
+	for (auto& worker : workers)
+		worker->thread = std::thread([this, current = worker.get()] { run(*current); });
+}
+
+ForwardingCore::~ForwardingCore()
+{
+	shouldExit = true;
+
+	for (auto& worker : workers)
+		worker->wakeup.signal();
+
+	for (auto& worker : workers)
+		worker->thread.join();
+}
+
+std::shared_ptr<const ForwardingCore::Snapshot> ForwardingCore::load() const
+{
+	return std::atomic_load(&participants);
+}
+
+ForwardingCore::ParticipantPtr ForwardingCore::find(const Snapshot& current, std::uint16_t id)
+{
+	const auto it = std::lower_bound(current.begin(), current.end(), id,
+		[](const ParticipantPtr& participant, std::uint16_t value) { return participant->id < value; });
+
+	return it != current.end() && (*it)->id == id ? *it : nullptr;
+}
+
+//==============================================================================
+std::uint16_t ForwardingCore::addParticipant(std::shared_ptr<PacketSink> sink)
+{
+	const std::lock_guard<std::mutex> lock(writerMutex);
+	auto next = std::make_shared<Snapshot>(*load());
+
+	//the first gap in the sorted ids; wraps to 0 once all are taken
+	std::uint16_t id = 1;
+	auto position = next->begin();
+
+	for (; position != next->end() && (*position)->id == id; ++position)
+		id++;
+
+	if (id == 0)
+		return 0;
+
+	next->insert(position, std::make_shared<Participant>(id, std::move(sink), settings));
+	std::atomic_store(&participants, std::shared_ptr<const Snapshot>(std::move(next)));
+	return id;
+}
+
+void ForwardingCore::removeParticipant(std::uint16_t id)
+{
+	std::shared_ptr<const Snapshot> remaining;
+	{
+		const std::lock_guard<std::mutex> lock(writerMutex);
+		auto next = std::make_shared<Snapshot>(*load());
+		const auto it = std::find_if(next->begin(), next->end(), [id](const ParticipantPtr& p) { return p->id == id; });
+
+		if (it == next->end())
+			return;
+
+		next->erase(it);
+		remaining = next;
+		std::atomic_store(&participants, std::shared_ptr<const Snapshot>(std::move(next)));
+	}
+
+	//an empty entry from the one who left, sent by the workers like any other
+	std::vector<ParticipantPtr> touched;
+
+	for (const auto& participant : *remaining)
+		append(participant, id, nullptr, 0, touched);
+
+	for (const auto& participant : touched)
+		post({ participant->id, {} });
+}
+
+void ForwardingCore::receive(std::uint16_t from, const rtc::binary& packet)
+{
+	if (packet.empty())
+		return;
+
+	packetsReceived.fetch_add(1, std::memory_order_relaxed);
+	post({ from, packet });
+}
+
+void ForwardingCore::drain(std::uint16_t id)
+{
+	post({ id, {} });
+}
+
+//the same sender always lands on the same worker, which keeps its packets in order
+void ForwardingCore::post(Job job)
+{
+	auto& worker = *workers[job.from % workers.size()];
+	{
+		const std::lock_guard<std::mutex> lock(worker.mutex);
+		worker.jobs.push_back(std::move(job));
+	}
+
+	worker.wakeup.signal();
+}
+
+ForwardingCore::Stats ForwardingCore::getStats() const
+{
+	Stats stats;
+	stats.numParticipants = load()->size();
+	stats.numWorkers = workers.size();
+	stats.packetsReceived = packetsReceived.load(std::memory_order_relaxed);
+	stats.packetsForwarded = packetsForwarded.load(std::memory_order_relaxed);
+	stats.packetsIgnored = packetsIgnored.load(std::memory_order_relaxed);
+	stats.bundlesSent = bundlesSent.load(std::memory_order_relaxed);
+	stats.bytesSent = bytesSent.load(std::memory_order_relaxed);
+	stats.bundlesDropped = bundlesDropped.load(std::memory_order_relaxed);
+	return stats;
+}
+
+//==============================================================================
+//one signal per job, the jobs that piled up meanwhile are taken in one go and later signals find nothing
+void ForwardingCore::run(Worker& worker)
+{
+	std::vector<Job> jobs;
+	std::vector<ParticipantPtr> touched;
+
+	for (;;)
+	{
+		worker.wakeup.wait();
+
+		if (shouldExit)
+			return;
+
+		{
+			const std::lock_guard<std::mutex> lock(worker.mutex);
+			jobs.swap(worker.jobs);
+		}
+
+		if (jobs.empty())
+			continue;
+
+		const auto current = load();
+
+		for (const auto& job : jobs)
+			forward(job, *current, touched);
+
+		std::sort(touched.begin(), touched.end());
+		touched.erase(std::unique(touched.begin(), touched.end()), touched.end());
+
+		for (const auto& participant : touched)
+			flush(*participant);
+
+		jobs.clear();
+		touched.clear();
+	}
+}
+
+void ForwardingCore::forward(const Job& job, const Snapshot& current, std::vector<ParticipantPtr>& touched)
+{
+	const auto sender = find(current, job.from);
+
+	if (sender == nullptr) {
+		packetsIgnored.fetch_add(job.packet.empty() ? 0 : 1, std::memory_order_relaxed);
+		return;
+	}
+
+	if (job.packet.empty()) {
+		touched.push_back(sender);
+		return;
+	}
+
+	const auto* bytes = reinterpret_cast<const std::uint8_t*>(job.packet.data());
+
+	switch (bytes[0])
+	{
+		case PacketFormat::midiBatch:
+		case PacketFormat::fecParity:
+			for (const auto& participant : current)
+				if (participant != sender)
+					append(participant, job.from, bytes, job.packet.size(), touched);
+			return;
+
+		case PacketFormat::relayBundle:
+		{
+			const auto isWellFormed = StreamBundle::forEachPacket(bytes, job.packet.size(),
+				[&](std::uint16_t to, const std::uint8_t* packet, std::size_t size) {
+					const auto receiver = to != job.from && size > 0 ? find(current, to) : nullptr;
+
+					if (receiver != nullptr)
+						append(receiver, job.from, packet, size, touched);
+					else
+						packetsIgnored.fetch_add(1, std::memory_order_relaxed);
+				});
+
+			if (!isWellFormed)
+				packetsIgnored.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+
+		default:
+			packetsIgnored.fetch_add(1, std::memory_order_relaxed);
+			return;
+	}
+}
+
+void ForwardingCore::append(const ParticipantPtr& to, std::uint16_t from, const void* packet, std::size_t size,
+                            std::vector<ParticipantPtr>& touched)
+{
+	{
+		const std::lock_guard<std::mutex> lock(to->mutex);
+
+		if (!to->bundler.add(from, packet, size))
+		{
+			closeBundle(*to);
+			sendQueued(*to);
+
+			if (!to->bundler.add(from, packet, size)) {
+				packetsIgnored.fetch_add(1, std::memory_order_relaxed);
+				return;
+			}
+		}
+	}
+
+	if (size > 0)
+		packetsForwarded.fetch_add(1, std::memory_order_relaxed);
+
+	if (touched.empty() || touched.back() != to)
+		touched.push_back(to);
+}
+
+//participant's mutex must be held
+void ForwardingCore::closeBundle(Participant& participant)
+{
+	const auto& bundle = participant.bundler.getBundle();
+
+	while (!participant.queue.empty() && participant.queuedBytes + bundle.size() > settings.maxQueuedBytes)
+	{
+		participant.queuedBytes -= participant.queue.front().size();
+		participant.queue.pop_front();
+		bundlesDropped.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	participant.queuedBytes += bundle.size();
+	participant.queue.push_back(bundle);
+	participant.bundler.clear();
+}
+
+//the bundle that is still filling up leaves too
+void ForwardingCore::flush(Participant& participant)
+{
+	const std::lock_guard<std::mutex> lock(participant.mutex);
+
+	if (!participant.bundler.isEmpty())
+		closeBundle(participant);
+
+	sendQueued(participant);
+}
+
+//participant's mutex must be held; sends what the channel takes now, the rest waits for drain().
+//A send that calls back into drain() only posts a job
+void ForwardingCore::sendQueued(Participant& participant)
+{
+	while (!participant.queue.empty())
+	{
+		if (!participant.sink->isOpen())
+		{
+			bundlesDropped.fetch_add(participant.queue.size(), std::memory_order_relaxed);
+			participant.queue.clear();
+			participant.queuedBytes = 0;
+			return;
+		}
+
+		if (participant.sink->getBufferedAmount() > settings.maxBufferedAmount)
+			return;
+
+		const auto& bundle = participant.queue.front();
+
+		try {
+			participant.sink->send(bundle);
+			bundlesSent.fetch_add(1, std::memory_order_relaxed);
+			bytesSent.fetch_add(bundle.size(), std::memory_order_relaxed);
+		}
+		catch (const std::exception&) {
+			bundlesDropped.fetch_add(1, std::memory_order_relaxed);
+		}
+
+		participant.queuedBytes -= bundle.size();
+		participant.queue.pop_front();
+	}
+}
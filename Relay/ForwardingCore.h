@@ -0,0 +1,151 @@
+/*
+  ==============================================================================
+
+    The relay's forwarding core: what one participant sends goes to all
+    the others, and every participant has an output queue of its own.
+
+    Received packets are handed to one of the worker threads, picked by
+    the sender's id, so one participant's packets stay in order while many
+    participants spread over all cores. A worker forwards everything that
+    piled up since it last ran and then flushes each output queue it
+    touched once, so a burst from many senders leaves as a few full
+    bundles per receiver rather than one message per packet; bundles that
+    fill up meanwhile go out right away.
+
+    What is forwarded:
+
+        midiBatch, fecParity    to everybody else
+        relayBundle             every entry to the participant whose id it
+                                carries; pings, pongs, loss reports,
+                                journal acks, NACKs and retransmissions go
+                                this way, end to end
+        anything else           dropped
+
+    Everything leaves as a relayBundle whose ids are the senders. An empty
+    entry tells the others that a participant left.
+
+    Output queues: packets collect in one StreamBundler per receiver.
+    Closed bundles go out while the receiver's channel holds no more than
+    maxBufferedAmount and wait otherwise, until drain() says the channel
+    has room again; past maxQueuedBytes the oldest waiting bundles are
+    dropped. A slow receiver holds up neither the workers nor the others.
+
+    Participants are looked up in a copy-on-write snapshot, as in
+    ConnectionRegistry, so the workers never wait for joins and leaves.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <rtc/rtc.hpp>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "PacketSink.h"
+#include "SenderThread.h"
+#include "StreamBundle.h"
+
+class ForwardingCore
+{
+public:
+    struct Settings
+    {
+        int numWorkers = 0;                                         //0 = one per hardware thread
+        std::size_t maxBundleSize = StreamBundle::defaultMaxSize;
+        std::size_t maxBufferedAmount = 64 * 1024;                  //in a receiver's channel
+        std::size_t maxQueuedBytes = 512 * 1024;                    //waiting in its output queue
+    };
+
+    struct Stats
+    {
+        std::size_t numParticipants = 0;
+        std::size_t numWorkers = 0;
+        std::uint64_t packetsReceived = 0;
+        std::uint64_t packetsForwarded = 0;     //counted once per receiver
+        std::uint64_t packetsIgnored = 0;       //malformed, of another type or for nobody
+        std::uint64_t bundlesSent = 0;
+        std::uint64_t bytesSent = 0;
+        std::uint64_t bundlesDropped = 0;       //output queue full or channel gone
+    };
+
+    explicit ForwardingCore(const Settings& settings);
+    ~ForwardingCore();
+
+    ForwardingCore(const ForwardingCore&) = delete;
+    ForwardingCore& operator=(const ForwardingCore&) = delete;
+
+    //the lowest free id, 0 if all 65535 are taken
+    std::uint16_t addParticipant(std::shared_ptr<PacketSink> sink);
+
+    //the others learn about it with their next bundle
+    void removeParticipant(std::uint16_t id);
+
+    //any thread, normally the participant's DataChannel; never waits for other participants
+    void receive(std::uint16_t from, const rtc::binary& packet);
+
+    //the participant's channel has room again, a worker sends what waits for it
+    void drain(std::uint16_t id);
+
+    Stats getStats() const;
+
+private:
+    struct Participant
+    {
+        Participant(std::uint16_t id, std::shared_ptr<PacketSink> sink, const Settings& settings);
+
+        const std::uint16_t id;
+        const std::shared_ptr<PacketSink> sink;
+        std::mutex mutex;                   //everything below
+        StreamBundler bundler;
+        std::deque<rtc::binary> queue;      //closed bundles waiting for room in the channel
+        std::size_t queuedBytes = 0;
+    };
+
+    using ParticipantPtr = std::shared_ptr<Participant>;
+    using Snapshot = std::vector<ParticipantPtr>;       //sorted by id
+
+    struct Job
+    {
+        std::uint16_t from = 0;
+        rtc::binary packet;                 //empty: only flush the queue of from
+    };
+
+    struct Worker
+    {
+        std::thread thread;
+        LightweightSemaphore wakeup;
+        std::mutex mutex;
+        std::vector<Job> jobs;              //swapped out by the worker thread
+    };
+
+    void run(Worker& worker);
+    void post(Job job);
+    void forward(const Job& job, const Snapshot& current, std::vector<ParticipantPtr>& touched);
+    void append(const ParticipantPtr& to, std::uint16_t from, const void* packet, std::size_t size,
+                std::vector<ParticipantPtr>& touched);
+    void closeBundle(Participant& participant);
+    void sendQueued(Participant& participant);
+    void flush(Participant& participant);
+
+    std::shared_ptr<const Snapshot> load() const;
+    static ParticipantPtr find(const Snapshot& current, std::uint16_t id);
+
+    const Settings settings;
+
+    std::shared_ptr<const Snapshot> participants;
+    std::mutex writerMutex;
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::atomic<bool> shouldExit{ false };
+
+    std::atomic<std::uint64_t> packetsReceived{ 0 }, packetsForwarded{ 0 }, packetsIgnored{ 0 },
+        bundlesSent{ 0 }, bytesSent{ 0 }, bundlesDropped{ 0 };
+};
@@ -0,0 +1,151 @@
+/*
+  ==============================================================================
+
+    A signaling server on 127.0.0.1.
+
+  ==============================================================================
+*/
+
+#include "LocalSignalingServer.h"
+
+#include <nlohmann/json.hpp>
+
+#include <variant>
+#include <vector>
+
+using json = nlohmann::json;
+
+rtc::WebSocketServer::Configuration LocalSignalingServer::makeConfiguration(std::uint16_t port)
+{
+	rtc::WebSocketServer::Configuration configuration;
+	configuration.port = port;
+	configuration.bindAddress = "127.0.0.1";
+	return configuration;
+}
+
+LocalSignalingServer::LocalSignalingServer(std::uint16_t port)
+	: server(makeConfiguration(port))
+{
+	server.onClient([this](std::shared_ptr<rtc::WebSocket> socket) { addClient(std::move(socket)); });
+}
+
+//nothing calls back once the server is stopped and the callbacks are gone
+LocalSignalingServer::~LocalSignalingServer()
+{
+	server.stop();
+
+	std::unordered_map<rtc::WebSocket*, std::shared_ptr<rtc::WebSocket>> closing;
+	{
+		const std::lock_guard<std::mutex> lock(mutex);
+		closing.swap(sockets);
+		socketIds.clear();
+		clients.clear();
+		closedSockets.clear();
+	}
+
+	for (const auto& entry : closing)
+	{
+		entry.second->resetCallbacks();
+		entry.second->close();
+	}
+}
+
+std::size_t LocalSignalingServer::getNumClients() const
+{
+	const std::lock_guard<std::mutex> lock(mutex);
+	return clients.size();
+}
+
+//the path, and with it the id, is only known once the handshake is done
+void LocalSignalingServer::addClient(std::shared_ptr<rtc::WebSocket> socket)
+{
+	auto* const key = socket.get();
+	std::vector<std::shared_ptr<rtc::WebSocket>> released;
+	{
+		const std::lock_guard<std::mutex> lock(mutex);
+		sockets[key] = socket;
+		released.swap(closedSockets);
+	}
+
+	socket->onOpen([this, key] { clientOpened(key); });
+	socket->onClosed([this, key] { clientClosed(key); });
+	socket->onError([this, key](std::string) { clientClosed(key); });
+
+	socket->onMessage([this, key](rtc::message_variant data) {
+		if (const auto* text = std::get_if<std::string>(&data))
+			forward(key, *text);
+	});
+}
+
+//a client that connects again under the same id replaces the old connection
+void LocalSignalingServer::clientOpened(rtc::WebSocket* socket)
+{
+	const std::lock_guard<std::mutex> lock(mutex);
+	const auto it = sockets.find(socket);
+
+	if (it == sockets.end())
+		return;
+
+	const auto path = it->second->path();
+
+	if (!path || path->size() < 2 || path->front() != '/')
+		return;
+
+	const auto id = path->substr(1);
+	socketIds[socket] = id;
+	clients[id] = it->second;
+}
+
+//the socket is only let go of with the next client, never inside its own callback
+void LocalSignalingServer::clientClosed(rtc::WebSocket* socket)
+{
+	const std::lock_guard<std::mutex> lock(mutex);
+	const auto it = sockets.find(socket);
+
+	if (it == sockets.end())
+		return;
+
+	if (const auto idIt = socketIds.find(socket); idIt != socketIds.end())
+	{
+		if (const auto client = clients.find(idIt->second); client != clients.end() && client->second == it->second)
+			clients.erase(client);
+
+		socketIds.erase(idIt);
+	}
+
+	closedSockets.push_back(std::move(it->second));
+	sockets.erase(it);
+}
+
+void LocalSignalingServer::forward(rtc::WebSocket* from, const std::string& message)
+{
+	auto parsed = json::parse(message, nullptr, false);
+
+	if (!parsed.is_object())
+		return;
+
+	const auto id = parsed.find("id");
+
+	if (id == parsed.end() || !id->is_string())
+		return;
+
+	std::shared_ptr<rtc::WebSocket> destination;
+	{
+		const std::lock_guard<std::mutex> lock(mutex);
+		const auto sender = socketIds.find(from);
+		const auto client = clients.find(id->get<std::string>());
+
+		if (sender == socketIds.end() || client == clients.end())
+			return;
+
+		*id = sender->second;
+		destination = client->second;
+	}
+
+	try {
+		destination->send(parsed.dump());
+	}
+	catch (const std::exception&) {
+		//gone meanwhile, its onClosed cleans up
+	}
+}
@@ -0,0 +1,58 @@
+/*
+  ==============================================================================
+
+    A signaling server on 127.0.0.1, so the relay and simulated clients
+    can be tested without the one on the network.
+
+    Does what the plugin expects of the real one: a client connects to
+    ws://127.0.0.1:<port>/<its id>, and every JSON message it sends goes to
+    the client named in its "id" field, with "id" replaced by the sender's
+    id (see PeerSignaling). Messages for unknown clients are dropped.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <rtc/rtc.hpp>
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class LocalSignalingServer
+{
+public:
+    //0 picks a free port
+    explicit LocalSignalingServer(std::uint16_t port = 0);
+    ~LocalSignalingServer();
+
+    LocalSignalingServer(const LocalSignalingServer&) = delete;
+    LocalSignalingServer& operator=(const LocalSignalingServer&) = delete;
+
+    std::uint16_t getPort() const { return server.port(); }
+
+    //what SignalingClient::Settings::url needs, without the client id
+    std::string getUrl() const { return "ws://127.0.0.1:" + std::to_string(getPort()); }
+
+    std::size_t getNumClients() const;
+
+private:
+    void addClient(std::shared_ptr<rtc::WebSocket> socket);
+    void clientOpened(rtc::WebSocket* socket);
+    void clientClosed(rtc::WebSocket* socket);
+    void forward(rtc::WebSocket* from, const std::string& message);
+
+    static rtc::WebSocketServer::Configuration makeConfiguration(std::uint16_t port);
+
+    rtc::WebSocketServer server;
+
+    mutable std::mutex mutex;
+    std::unordered_map<rtc::WebSocket*, std::shared_ptr<rtc::WebSocket>> sockets;     //keeps them alive
+    std::unordered_map<rtc::WebSocket*, std::string> socketIds;
+    std::unordered_map<std::string, std::shared_ptr<rtc::WebSocket>> clients;
+    std::vector<std::shared_ptr<rtc::WebSocket>> closedSockets;
+};
@@ -0,0 +1,248 @@
+/*
+  ==============================================================================
+
+    midirtc-relay: a headless relay for sessions too large for every
+    plugin to connect to every other one. Each plugin keeps one connection,
+    to the relay, and sends every batch once; the relay forwards it to
+    everybody else (see ForwardingCore, RelayServer). Uses the plugin's
+    wire format and PeerConnection setup, and no JUCE.
+
+    Not part of the plugin build. From the repository root, with
+    libdatachannel and nlohmann/json installed:
+
+        c++ -std=c++17 -O2 -ISource Relay/Main.cpp Relay/ForwardingCore.cpp Relay/LocalSignalingServer.cpp
+            Relay/RelayServer.cpp Relay/SimulatedSession.cpp Source/ConnectionRegistry.cpp
+            Source/PacketFramer.cpp Source/PeerSignaling.cpp Source/SenderThread.cpp
+            Source/SignalingClient.cpp Source/StreamBundle.cpp -ldatachannel -lpthread -o midirtc-relay
+
+    Modes:
+
+        ./midirtc-relay [--signaling ws://host:port] [--id RLAY] [--workers N]
+            relays for plugins that join the session with the relay's id,
+            until Ctrl+C; prints its stats every few seconds
+
+        ./midirtc-relay --serve-signaling PORT [--id RLAY] [--workers N]
+            the same with a signaling server of its own on 127.0.0.1:PORT
+
+        ./midirtc-relay --simulate N [--seconds S] [--block-us US] [--notes K]
+                        [--workers N] [--json]
+            localhost test: signaling server, relay and N simulated clients
+            in one process (see SimulatedSession). Every client sends one
+            batch per block, prints one CSV row (or a JSON object with
+            --json):
+
+        clients,workers,seconds,batches_sent,batches_expected,batches_received,
+        delivered,corrupt,p50_ms,p99_ms,max_ms,forwarded,bundles,bundles_dropped
+
+    delivered is received/expected; with the reliable channel the plugin
+    uses by default anything below 1 is a relay bug or an overload, which
+    bundles_dropped tells apart. Exits with 1 if not every client got
+    connected.
+
+  ==============================================================================
+*/
+
+#include "LocalSignalingServer.h"
+#include "RelayServer.h"
+#include "SimulatedSession.h"
+
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+
+namespace
+{
+	struct Options
+	{
+		RelayServer::Settings relay;
+		int signalingPort = -1;         //-1 = use relay.signalingUrl
+		int numClients = 0;             //0 = no simulation
+		int seconds = 10;
+		int blockMicros = 5333;
+		int notesPerBatch = 1;
+		bool json = false;
+	};
+
+	std::atomic<bool> shouldQuit{ false };
+
+	void quit(int)
+	{
+		shouldQuit = true;
+	}
+
+	void printUsage(const char* name)
+	{
+		std::fprintf(stderr,
+			"usage: %s [--signaling URL | --serve-signaling PORT] [--id ID] [--workers N]\n"
+			"       %s --simulate N [--seconds S] [--block-us US] [--notes K] [--workers N] [--json]\n",
+			name, name);
+	}
+
+	bool parse(int argc, char** argv, Options& options)
+	{
+		for (int i = 1; i < argc; i++)
+		{
+			const auto hasValue = i + 1 < argc;
+
+			if (std::strcmp(argv[i], "--json") == 0)
+				options.json = true;
+			else if (std::strcmp(argv[i], "--signaling") == 0 && hasValue)
+				options.relay.signalingUrl = argv[++i];
+			else if (std::strcmp(argv[i], "--serve-signaling") == 0 && hasValue)
+				options.signalingPort = std::atoi(argv[++i]);
+			else if (std::strcmp(argv[i], "--id") == 0 && hasValue)
+				options.relay.relayId = argv[++i];
+			else if (std::strcmp(argv[i], "--workers") == 0 && hasValue)
+				options.relay.forwarding.numWorkers = std::atoi(argv[++i]);
+			else if (std::strcmp(argv[i], "--simulate") == 0 && hasValue)
+				options.numClients = std::atoi(argv[++i]);
+			else if (std::strcmp(argv[i], "--seconds") == 0 && hasValue)
+				options.seconds = std::atoi(argv[++i]);
+			else if (std::strcmp(argv[i], "--block-us") == 0 && hasValue)
+				options.blockMicros = std::atoi(argv[++i]);
+			else if (std::strcmp(argv[i], "--notes") == 0 && hasValue)
+				options.notesPerBatch = std::atoi(argv[++i]);
+			else
+				return false;
+		}
+
+		//simulated client ids are S000 to S999
+		return options.signalingPort <= 65535 && options.numClients >= 0 && options.numClients <= 1000
+			&& options.seconds > 0 && options.blockMicros > 0 && options.notesPerBatch > 0;
+	}
+
+	void printStats(const ForwardingCore::Stats& stats)
+	{
+		std::fprintf(stderr, "participants %zu, received %llu, forwarded %llu, ignored %llu, bundles %llu (%llu bytes), dropped %llu\n",
+			stats.numParticipants, (unsigned long long) stats.packetsReceived, (unsigned long long) stats.packetsForwarded,
+			(unsigned long long) stats.packetsIgnored, (unsigned long long) stats.bundlesSent,
+			(unsigned long long) stats.bytesSent, (unsigned long long) stats.bundlesDropped);
+	}
+
+	bool waitForSignaling(const RelayServer& relay, std::chrono::milliseconds timeout)
+	{
+		const auto deadline = std::chrono::steady_clock::now() + timeout;
+
+		while (relay.getSignalingStatus() != SignalingClient::Status::connected)
+		{
+			if (std::chrono::steady_clock::now() > deadline)
+				return false;
+
+			std::this_thread::sleep_for(std::chrono::milliseconds(20));
+		}
+
+		return true;
+	}
+
+	int serve(Options& options)
+	{
+		std::unique_ptr<LocalSignalingServer> signalingServer;
+
+		if (options.signalingPort >= 0)
+		{
+			signalingServer = std::make_unique<LocalSignalingServer>(std::uint16_t(options.signalingPort));
+			options.relay.signalingUrl = signalingServer->getUrl();
+			std::fprintf(stderr, "Signaling server on %s\n", options.relay.signalingUrl.c_str());
+		}
+
+		RelayServer relay(options.relay);
+		relay.start();
+		std::fprintf(stderr, "Relay %s on %s\n", options.relay.relayId.c_str(), options.relay.signalingUrl.c_str());
+
+		std::signal(SIGINT, quit);
+		std::signal(SIGTERM, quit);
+		auto nextStats = std::chrono::steady_clock::now();
+
+		while (!shouldQuit)
+		{
+			if (std::chrono::steady_clock::now() >= nextStats)
+			{
+				printStats(relay.getStats());
+				nextStats += std::chrono::seconds(5);
+			}
+
+			std::this_thread::sleep_for(std::chrono::milliseconds(100));
+		}
+
+		relay.stop();
+		printStats(relay.getStats());
+		return 0;
+	}
+
+	int simulate(Options& options)
+	{
+		LocalSignalingServer signalingServer(0);
+		options.relay.signalingUrl = signalingServer.getUrl();
+
+		RelayServer relay(options.relay);
+		relay.start();
+
+		if (!waitForSignaling(relay, std::chrono::seconds(5)))
+		{
+			std::fprintf(stderr, "Relay could not reach %s\n", options.relay.signalingUrl.c_str());
+			return 1;
+		}
+
+		SimulatedSession::Settings settings;
+		settings.signalingUrl = options.relay.signalingUrl;
+		settings.relayId = options.relay.relayId;
+		settings.numClients = options.numClients;
+		settings.blockInterval = std::chrono::microseconds(options.blockMicros);
+		settings.notesPerBatch = options.notesPerBatch;
+
+		SimulatedSession session(settings);
+
+		if (!session.connect(std::chrono::seconds(10 + options.numClients / 10)))
+			std::fprintf(stderr, "Only %d of %d clients connected\n", session.getReport().numConnected, options.numClients);
+
+		session.run(std::chrono::seconds(options.seconds));
+
+		const auto report = session.getReport();
+		const auto stats = relay.getStats();
+		const auto delivered = report.batchesExpected > 0 ? double(report.batchesReceived) / double(report.batchesExpected) : 0.0;
+
+		if (options.json)
+		{
+			std::printf("{\"clients\": %d, \"workers\": %zu, \"seconds\": %d, \"batches_sent\": %llu, \"batches_expected\": %llu, "
+				"\"batches_received\": %llu, \"delivered\": %.4f, \"corrupt\": %llu, \"p50_ms\": %.2f, \"p99_ms\": %.2f, "
+				"\"max_ms\": %.2f, \"forwarded\": %llu, \"bundles\": %llu, \"bundles_dropped\": %llu}\n",
+				report.numConnected, stats.numWorkers, options.seconds, (unsigned long long) report.batchesSent,
+				(unsigned long long) report.batchesExpected, (unsigned long long) report.batchesReceived, delivered,
+				(unsigned long long) report.batchesCorrupt, report.p50LatencyMs, report.p99LatencyMs, report.maxLatencyMs,
+				(unsigned long long) stats.packetsForwarded, (unsigned long long) stats.bundlesSent,
+				(unsigned long long) stats.bundlesDropped);
+		}
+		else
+		{
+			std::printf("clients,workers,seconds,batches_sent,batches_expected,batches_received,"
+				"delivered,corrupt,p50_ms,p99_ms,max_ms,forwarded,bundles,bundles_dropped\n");
+			std::printf("%d,%zu,%d,%llu,%llu,%llu,%.4f,%llu,%.2f,%.2f,%.2f,%llu,%llu,%llu\n",
+				report.numConnected, stats.numWorkers, options.seconds, (unsigned long long) report.batchesSent,
+				(unsigned long long) report.batchesExpected, (unsigned long long) report.batchesReceived, delivered,
+				(unsigned long long) report.batchesCorrupt, report.p50LatencyMs, report.p99LatencyMs, report.maxLatencyMs,
+				(unsigned long long) stats.packetsForwarded, (unsigned long long) stats.bundlesSent,
+				(unsigned long long) stats.bundlesDropped);
+		}
+
+		return report.numConnected == options.numClients ? 0 : 1;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	Options options;
+
+	if (!parse(argc, argv, options))
+	{
+		printUsage(argv[0]);
+		return 1;
+	}
+
+	return options.numClients > 0 ? simulate(options) : serve(options);
+}
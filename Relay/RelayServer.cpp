@@ -0,0 +1,228 @@
+/*
+  ==============================================================================
+
+    The relay as a WebRTC peer.
+
+  ==============================================================================
+*/
+
+#include "RelayServer.h"
+
+#include "PacketSink.h"
+#include "PeerSignaling.h"
+
+#include <cstdio>
+#include <variant>
+
+namespace
+{
+	const char* getStatusName(SignalingClient::Status status)
+	{
+		switch (status)
+		{
+			case SignalingClient::Status::disconnected: return "disconnected";
+			case SignalingClient::Status::connecting:   return "connecting";
+			case SignalingClient::Status::connected:    return "connected";
+			case SignalingClient::Status::retrying:     return "retrying";
+			case SignalingClient::Status::failed:       return "failed";
+		}
+
+		return "unknown";
+	}
+}
+
+RelayServer::RelayServer(const Settings& settingsToUse)
+	: settings(settingsToUse), core(settingsToUse.forwarding)
+{
+	signaling.onStatus([this](SignalingClient::Status status, const std::string& detail) { handleSignalingStatus(status, detail); });
+	signaling.onMessage([this](const std::string& message) { handleSignalingMessage(message); });
+
+	housekeeping = std::thread([this] { runHousekeeping(); });
+}
+
+RelayServer::~RelayServer()
+{
+	stop();
+
+	{
+		const std::lock_guard<std::mutex> lock(membersMutex);
+		shouldStop = true;
+	}
+
+	housekeepingWakeup.notify_one();
+	housekeeping.join();
+}
+
+void RelayServer::start()
+{
+	SignalingClient::Settings signalingSettings;
+	signalingSettings.url = settings.signalingUrl + "/" + settings.relayId;
+	signalingSettings.maxRetries = -1;      //a relay waits for the server as long as it takes
+
+	signaling.connect(signalingSettings);
+}
+
+void RelayServer::stop()
+{
+	signaling.disconnect();
+	connections.closeAll();
+
+	std::unordered_map<std::string, Member> leaving;
+	{
+		const std::lock_guard<std::mutex> lock(membersMutex);
+		leaving.swap(members);
+		retired.clear();
+	}
+
+	for (const auto& entry : leaving)
+		if (entry.second.id != 0)
+			core.removeParticipant(entry.second.id);
+}
+
+//==============================================================================
+void RelayServer::handleSignalingStatus(SignalingClient::Status status, const std::string& detail)
+{
+	std::fprintf(stderr, "Signaling %s%s%s\n", getStatusName(status), detail.empty() ? "" : ": ", detail.c_str());
+}
+
+//WebSocket thread: an offer replaces whatever connection the partner had, answers and candidates go to the current one
+void RelayServer::handleSignalingMessage(const std::string& text)
+{
+	PeerSignaling::Message message;
+
+	if (!PeerSignaling::parse(text, message))
+		return;
+
+	auto connection = connections.findPeer(message.partnerId);
+
+	if (PeerSignaling::isOffer(message))
+	{
+		connection = createPeerConnection(message.partnerId);
+		{
+			const std::lock_guard<std::mutex> lock(membersMutex);
+			auto& member = members[message.partnerId];
+
+			if (member.id != 0)
+				core.removeParticipant(member.id);
+
+			member = Member{ connection, 0 };
+		}
+
+		connections.setPeer(message.partnerId, connection);
+	}
+
+	if (connection == nullptr)
+		return;
+
+	try {
+		PeerSignaling::apply(*connection, message);
+	}
+	catch (const std::exception& e) {
+		std::fprintf(stderr, "Signaling from %s failed: %s\n", message.partnerId.c_str(), e.what());
+	}
+}
+
+std::shared_ptr<rtc::PeerConnection> RelayServer::createPeerConnection(const std::string& partnerId)
+{
+	auto connection = PeerSignaling::createPeerConnection(config, partnerId,
+		[this](const std::string& message) { return signaling.send(message); });
+
+	const auto* identity = connection.get();
+
+	connection->onStateChange([this, partnerId, identity](rtc::PeerConnection::State state) {
+		if (state == rtc::PeerConnection::State::Failed || state == rtc::PeerConnection::State::Closed)
+			leave(partnerId, identity);
+	});
+
+	connection->onDataChannel([this, partnerId, identity](std::shared_ptr<rtc::DataChannel> channel) {
+		join(partnerId, identity, std::move(channel));
+	});
+
+	return connection;
+}
+
+//the channel is open when it arrives; one per participant, a second one is closed
+void RelayServer::join(const std::string& partnerId, const rtc::PeerConnection* identity, std::shared_ptr<rtc::DataChannel> channel)
+{
+	std::uint16_t id = 0;
+	{
+		const std::lock_guard<std::mutex> lock(membersMutex);
+		const auto it = members.find(partnerId);
+
+		if (it != members.end() && it->second.id == 0 && it->second.connection.lock().get() == identity)
+		{
+			id = core.addParticipant(std::make_shared<DataChannelSink>(channel));
+			it->second.id = id;
+		}
+	}
+
+	if (id == 0) {
+		std::fprintf(stderr, "No room for %s\n", partnerId.c_str());
+		channel->close();
+		return;
+	}
+
+	connections.addChannel(partnerId, channel);
+
+	//the core holds bundles back above this, and sends them once the channel has room again
+	channel->setBufferedAmountLowThreshold(settings.forwarding.maxBufferedAmount);
+	channel->onBufferedAmountLow([this, id] { core.drain(id); });
+	channel->onClosed([this, partnerId, identity] { leave(partnerId, identity); });
+
+	channel->onMessage([this, id](rtc::message_variant data) {
+		if (const auto* packet = std::get_if<rtc::binary>(&data))
+			core.receive(id, *packet);
+	});
+
+	std::fprintf(stderr, "%s joined as %u\n", partnerId.c_str(), unsigned(id));
+}
+
+void RelayServer::leave(const std::string& partnerId, const rtc::PeerConnection* identity)
+{
+	{
+		const std::lock_guard<std::mutex> lock(membersMutex);
+		const auto it = members.find(partnerId);
+
+		if (it == members.end())
+			return;
+
+		auto connection = it->second.connection.lock();
+
+		if (connection.get() != identity)
+			return;
+
+		if (it->second.id != 0) {
+			core.removeParticipant(it->second.id);
+			std::fprintf(stderr, "%s left\n", partnerId.c_str());
+		}
+
+		members.erase(it);
+		retired.emplace_back(partnerId, std::move(connection));
+	}
+
+	housekeepingWakeup.notify_one();
+}
+
+//closes the connections of participants that left, outside their callbacks
+void RelayServer::runHousekeeping()
+{
+	std::unique_lock<std::mutex> lock(membersMutex);
+
+	for (;;)
+	{
+		housekeepingWakeup.wait(lock, [this] { return shouldStop || !retired.empty(); });
+
+		if (shouldStop)
+			return;
+
+		auto closing = std::move(retired);
+		retired.clear();
+		lock.unlock();
+
+		for (const auto& [partnerId, connection] : closing)
+			connections.removePeer(partnerId, connection);
+
+		closing.clear();
+		lock.lock();
+	}
+}
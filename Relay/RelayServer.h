@@ -0,0 +1,92 @@
+/*
+  ==============================================================================
+
+    The relay as a WebRTC peer. It registers at the signaling server under
+    an id of its own and answers every offer like a plugin instance would,
+    with the PeerConnection setup of PeerSignaling. Each participant's
+    DataChannel becomes one participant of the ForwardingCore, which does
+    the forwarding.
+
+    Plugins join by connecting to the relay's id (connectToPartner or
+    joinSession). A participant leaves when its channel closes, its
+    PeerConnection fails or it offers again; its connection is closed on
+    the relay's housekeeping thread, never inside one of its own callbacks.
+
+    Free of JUCE, built with the relay (see Main.cpp).
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <rtc/rtc.hpp>
+
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "ConnectionRegistry.h"
+#include "ForwardingCore.h"
+#include "SignalingClient.h"
+
+class RelayServer
+{
+public:
+    struct Settings
+    {
+        std::string signalingUrl = "ws://192.168.178.50:8080";     //without the id
+        std::string relayId = "RLAY";
+        ForwardingCore::Settings forwarding;
+    };
+
+    explicit RelayServer(const Settings& settings);
+    ~RelayServer();
+
+    RelayServer(const RelayServer&) = delete;
+    RelayServer& operator=(const RelayServer&) = delete;
+
+    //returns right away, signaling connects and reconnects in the background
+    void start();
+
+    //closes every participant's connection, start() begins again
+    void stop();
+
+    SignalingClient::Status getSignalingStatus() const { return signaling.getStatus(); }
+    ForwardingCore::Stats getStats() const { return core.getStats(); }
+
+private:
+    //the current connection of a partner and its id in the core, 0 until its channel arrived
+    struct Member
+    {
+        std::weak_ptr<rtc::PeerConnection> connection;
+        std::uint16_t id = 0;
+    };
+
+    void handleSignalingStatus(SignalingClient::Status status, const std::string& detail);
+    void handleSignalingMessage(const std::string& message);
+    std::shared_ptr<rtc::PeerConnection> createPeerConnection(const std::string& partnerId);
+
+    //identity only tells callbacks of a replaced connection apart, it is never dereferenced
+    void join(const std::string& partnerId, const rtc::PeerConnection* identity, std::shared_ptr<rtc::DataChannel> channel);
+    void leave(const std::string& partnerId, const rtc::PeerConnection* identity);
+    void runHousekeeping();
+
+    const Settings settings;
+    rtc::Configuration config;
+    ForwardingCore core;
+    ConnectionRegistry connections;
+    SignalingClient signaling;
+
+    std::mutex membersMutex;        //everything below
+    std::unordered_map<std::string, Member> members;
+    std::vector<std::pair<std::string, std::shared_ptr<rtc::PeerConnection>>> retired;
+    std::condition_variable housekeepingWakeup;
+    bool shouldStop = false;
+    std::thread housekeeping;
+};
@@ -0,0 +1,300 @@
+/*
+  ==============================================================================
+
+    Many plugin-like clients in one process, for testing the relay.
+
+  ==============================================================================
+*/
+
+#include "SimulatedSession.h"
+
+#include "ConnectionRegistry.h"
+#include "PacketFramer.h"
+#include "PeerSignaling.h"
+#include "SignalingClient.h"
+#include "StreamBundle.h"
+
+#include <rtc/rtc.hpp>
+
+#include <algorithm>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+#include <variant>
+
+namespace
+{
+	constexpr std::uint32_t sampleRate = 1000000;       //one sample per microsecond
+}
+
+class SimulatedSession::Client
+{
+public:
+	Client(SimulatedSession& ownerToUse, std::string localIdToUse)
+		: owner(ownerToUse), localId(std::move(localIdToUse))
+	{
+		signaling.onStatus([this](SignalingClient::Status status, const std::string&) {
+			if (status == SignalingClient::Status::connected)
+				offer();
+		});
+
+		signaling.onMessage([this](const std::string& message) { handleSignalingMessage(message); });
+	}
+
+	~Client()
+	{
+		signaling.disconnect();
+		connections.closeAll();
+	}
+
+	void start()
+	{
+		SignalingClient::Settings signalingSettings;
+		signalingSettings.url = owner.settings.signalingUrl + "/" + localId;
+		signaling.connect(signalingSettings);
+	}
+
+	bool isOpen() const
+	{
+		const std::lock_guard<std::mutex> lock(channelMutex);
+		return channel != nullptr && channel->isOpen();
+	}
+
+	//driver thread only, like the plugin's sender thread; false if the channel didn't take it
+	bool sendBatch(std::uint32_t now)
+	{
+		std::shared_ptr<rtc::DataChannel> current;
+		{
+			const std::lock_guard<std::mutex> lock(channelMutex);
+			current = channel;
+		}
+
+		if (current == nullptr || !current->isOpen())
+			return false;
+
+		const auto batchTime = PacketBatcher::Clock::now();
+
+		for (int i = 0; i < owner.settings.notesPerBatch; i++)
+		{
+			const auto note = std::uint8_t(36 + (sequence + std::uint32_t(i)) % 60);
+			MidiEventRecord noteOn{ { 0x90, note, 100 }, 3, now };
+			MidiEventRecord noteOff{ { 0x80, note, 0 }, 3, now };
+
+			if (!batcher.add(noteOn, batchTime) || !batcher.add(noteOff, batchTime))
+				break;
+		}
+
+		const auto& packet = batcher.finish(sequence++, sampleRate);
+
+		try {
+			current->send(packet);
+			return true;
+		}
+		catch (const std::exception&) {
+			return false;
+		}
+	}
+
+private:
+	//the relay answers, so the client always offers, once its signaling is up
+	void offer()
+	{
+		if (connections.findPeer(owner.settings.relayId) != nullptr)
+			return;
+
+		auto connection = PeerSignaling::createPeerConnection(config, owner.settings.relayId,
+			[this](const std::string& message) { return signaling.send(message); });
+
+		connections.setPeer(owner.settings.relayId, connection);
+
+		auto dataChannel = connection->createDataChannel("DC-1");
+
+		dataChannel->onMessage([this](rtc::message_variant data) {
+			if (const auto* bundle = std::get_if<rtc::binary>(&data))
+				receive(*bundle);
+		});
+
+		connections.addChannel(owner.settings.relayId, dataChannel);
+
+		const std::lock_guard<std::mutex> lock(channelMutex);
+		channel = std::move(dataChannel);
+	}
+
+	void handleSignalingMessage(const std::string& text)
+	{
+		PeerSignaling::Message message;
+
+		if (!PeerSignaling::parse(text, message) || message.partnerId != owner.settings.relayId)
+			return;
+
+		if (const auto connection = connections.findPeer(message.partnerId))
+		{
+			try {
+				PeerSignaling::apply(*connection, message);
+			}
+			catch (const std::exception& e) {
+				std::fprintf(stderr, "%s: signaling failed: %s\n", localId.c_str(), e.what());
+			}
+		}
+	}
+
+	//DataChannel thread: every other client's batches, as the relay bundled them
+	void receive(const rtc::binary& bundle)
+	{
+		const auto arrival = nowMicros();
+
+		const auto isWellFormed = StreamBundle::forEachPacket(bundle.data(), bundle.size(),
+			[&](std::uint16_t, const std::uint8_t* bytes, std::size_t length) {
+				//an empty packet says a participant left
+				if (length == 0 || bytes[0] != PacketFormat::midiBatch)
+					return;
+
+				PacketFormat::BatchView batch;
+
+				if (PacketFormat::readBatch(reinterpret_cast<const std::byte*>(bytes), length, batch))
+					owner.received(std::int32_t(arrival - batch.baseTime));
+				else
+					owner.corrupt();
+			});
+
+		if (!isWellFormed)
+			owner.corrupt();
+	}
+
+	SimulatedSession& owner;
+	const std::string localId;
+	rtc::Configuration config;
+	ConnectionRegistry connections;
+	SignalingClient signaling;
+
+	mutable std::mutex channelMutex;
+	std::shared_ptr<rtc::DataChannel> channel;
+
+	PacketBatcher batcher;
+	std::uint32_t sequence = 0;
+};
+
+//==============================================================================
+SimulatedSession::SimulatedSession(const Settings& settingsToUse)
+	: settings(settingsToUse), latencies(std::make_unique<std::array<std::atomic<std::uint64_t>, numBuckets>>())
+{
+	for (auto& bucket : *latencies)
+		bucket = 0;
+
+	//4 characters like the plugin's ids, Main keeps numClients at 1000 or less
+	for (int i = 0; i < settings.numClients; i++)
+	{
+		char id[8];
+		std::snprintf(id, sizeof(id), "S%03d", i);
+		clients.push_back(std::make_unique<Client>(*this, id));
+	}
+}
+
+SimulatedSession::~SimulatedSession() = default;
+
+std::uint32_t SimulatedSession::nowMicros()
+{
+	const auto now = std::chrono::steady_clock::now().time_since_epoch();
+	return std::uint32_t(std::chrono::duration_cast<std::chrono::microseconds>(now).count());
+}
+
+bool SimulatedSession::connect(std::chrono::milliseconds timeout)
+{
+	for (auto& client : clients)
+		client->start();
+
+	const auto deadline = std::chrono::steady_clock::now() + timeout;
+
+	while (getNumOpen() < settings.numClients && std::chrono::steady_clock::now() < deadline)
+		std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+	return getNumOpen() == settings.numClients;
+}
+
+void SimulatedSession::run(std::chrono::milliseconds duration)
+{
+	const auto start = std::chrono::steady_clock::now();
+	auto nextBlock = start;
+
+	while (nextBlock - start < duration)
+	{
+		const auto numOpen = getNumOpen();
+		const auto now = nowMicros();
+
+		for (auto& client : clients)
+		{
+			if (!client->sendBatch(now))
+				continue;
+
+			batchesSent.fetch_add(1, std::memory_order_relaxed);
+			batchesExpected.fetch_add(std::uint64_t(std::max(numOpen - 1, 0)), std::memory_order_relaxed);
+		}
+
+		nextBlock += settings.blockInterval;
+		std::this_thread::sleep_until(nextBlock);
+	}
+
+	//what is still in flight or queued at the relay
+	std::this_thread::sleep_for(std::chrono::milliseconds(500));
+}
+
+int SimulatedSession::getNumOpen() const
+{
+	return int(std::count_if(clients.begin(), clients.end(), [](const auto& client) { return client->isOpen(); }));
+}
+
+void SimulatedSession::received(std::int64_t latencyMicros)
+{
+	latencyMicros = std::max<std::int64_t>(latencyMicros, 0);
+	batchesReceived.fetch_add(1, std::memory_order_relaxed);
+
+	const auto bucket = std::min(std::size_t(latencyMicros / bucketMicros), numBuckets - 1);
+	(*latencies)[bucket].fetch_add(1, std::memory_order_relaxed);
+
+	auto currentMax = maxLatencyMicros.load(std::memory_order_relaxed);
+
+	while (latencyMicros > currentMax && !maxLatencyMicros.compare_exchange_weak(currentMax, latencyMicros))
+	{
+	}
+}
+
+void SimulatedSession::corrupt()
+{
+	batchesCorrupt.fetch_add(1, std::memory_order_relaxed);
+}
+
+SimulatedSession::Report SimulatedSession::getReport() const
+{
+	Report report;
+	report.numClients = settings.numClients;
+	report.numConnected = getNumOpen();
+	report.batchesSent = batchesSent.load();
+	report.batchesExpected = batchesExpected.load();
+	report.batchesReceived = batchesReceived.load();
+	report.batchesCorrupt = batchesCorrupt.load();
+	report.maxLatencyMs = double(maxLatencyMicros.load()) / 1000.0;
+
+	//upper edge of the bucket the percentile falls into
+	const auto percentile = [&](double fraction) {
+		const auto target = std::uint64_t(double(report.batchesReceived) * fraction);
+		std::uint64_t count = 0;
+
+		for (std::size_t i = 0; i < numBuckets; i++)
+		{
+			count += (*latencies)[i].load(std::memory_order_relaxed);
+
+			if (count > target)
+				return double(std::int64_t(i + 1) * bucketMicros) / 1000.0;
+		}
+
+		return report.maxLatencyMs;
+	};
+
+	if (report.batchesReceived > 0)
+	{
+		report.p50LatencyMs = percentile(0.5);
+		report.p99LatencyMs = percentile(0.99);
+	}
+
+	return report;
+}
@@ -0,0 +1,84 @@
+/*
+  ==============================================================================
+
+    Many plugin-like clients in one process, for testing the relay on
+    localhost. Each has its own SignalingClient, PeerConnection and
+    DataChannel to the relay, set up with PeerSignaling like the plugin's.
+
+    Every open client sends one MIDI batch per block in the plugin's wire
+    format (PacketBatcher). The batch header's sample rate is 1 MHz and
+    its base time the sender's steady clock in microseconds, so whoever
+    receives it can tell its one-way latency through the relay from the
+    header alone; all clients share the clock. Receivers check every
+    batch's crc and framing.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+class SimulatedSession
+{
+public:
+    struct Settings
+    {
+        std::string signalingUrl;                           //without the id
+        std::string relayId = "RLAY";
+        int numClients = 16;
+        std::chrono::microseconds blockInterval{ 5333 };    //256 samples at 48 kHz
+        int notesPerBatch = 1;                              //a note on and a note off each
+    };
+
+    struct Report
+    {
+        int numClients = 0;
+        int numConnected = 0;
+        std::uint64_t batchesSent = 0;
+        std::uint64_t batchesExpected = 0;      //every batch once at each other client that was open
+        std::uint64_t batchesReceived = 0;
+        std::uint64_t batchesCorrupt = 0;
+        double p50LatencyMs = 0.0;
+        double p99LatencyMs = 0.0;
+        double maxLatencyMs = 0.0;
+    };
+
+    explicit SimulatedSession(const Settings& settings);
+    ~SimulatedSession();
+
+    SimulatedSession(const SimulatedSession&) = delete;
+    SimulatedSession& operator=(const SimulatedSession&) = delete;
+
+    //false if not every client's channel was open before the timeout
+    bool connect(std::chrono::milliseconds timeout);
+
+    //sends from this thread for the duration, then waits a moment for what is still on its way
+    void run(std::chrono::milliseconds duration);
+
+    Report getReport() const;
+
+private:
+    class Client;
+
+    static constexpr std::int64_t bucketMicros = 10;
+    static constexpr std::size_t numBuckets = 50000;       //up to 500 ms, later ones count as the last
+
+    static std::uint32_t nowMicros();
+    void received(std::int64_t latencyMicros);
+    void corrupt();
+    int getNumOpen() const;
+
+    const Settings settings;
+    std::vector<std::unique_ptr<Client>> clients;
+
+    std::atomic<std::uint64_t> batchesSent{ 0 }, batchesExpected{ 0 }, batchesReceived{ 0 }, batchesCorrupt{ 0 };
+    std::atomic<std::int64_t> maxLatencyMicros{ 0 };
+    std::unique_ptr<std::array<std::atomic<std::uint64_t>, numBuckets>> latencies;
+};
@@ -53,6 +53,11 @@
                                                           may be faster on processor architectures which support single-instruction integer multiplication.
         #define CRCPP_USE_CPP11                         - Define to enables C++11 features (move semantics, constexpr, static_assert, etc.).
         #define CRCPP_INCLUDE_ESOTERIC_CRC_DEFINITIONS  - Define to include definitions for little-used CRCs.
+        #define CRCPP_CONSTEXPR_TABLE                   - Define to make CRC::Table a literal type that can be built at compile time.
+                                                          Defined automatically when compiling as C++14 or later.
+
+    CRC::Calculate(data, size, CRC::CRC_32_C_Accelerated()) computes a CRC-32C with the hardware accelerated
+    or slicing-by-8 implementation in CRC32C.cpp, which has to be linked in for it.
 */
 
 #ifndef CRCPP_CRC_H_
@@ -127,6 +132,18 @@
 #   define crcpp_constexpr const
 #endif
 
+#if !defined(CRCPP_CONSTEXPR_TABLE) && (__cplusplus >= 201402L || (defined(_MSVC_LANG) && _MSVC_LANG >= 201402L))
+#   define CRCPP_CONSTEXPR_TABLE
+#endif
+
+#ifdef CRCPP_CONSTEXPR_TABLE
+    /// @brief Marks what is needed to build a lookup table at compile time (relaxed constexpr, C++14).
+#   define crcpp_table_constexpr constexpr
+#else
+    /// @brief Marks what is needed to build a lookup table at compile time (relaxed constexpr, C++14).
+#   define crcpp_table_constexpr
+#endif
+
 #ifdef CRCPP_USE_NAMESPACE
 namespace CRCPP
 {
@@ -164,25 +181,30 @@ public:
     /**
         @brief CRC lookup table. After construction, the CRC parameters are fixed.
         @note A CRC table can be used for multiple CRC calculations.
+        @note With CRCPP_CONSTEXPR_TABLE the table can be a compile-time constant, e.g.
+
+            constexpr CRC::Table<std::uint8_t, 8> table(CRC::Parameters<std::uint8_t, 8>{ 0x07, 0x00, 0x00, false, false });
+
+            which leaves nothing to initialize at runtime.
     */
     template <typename CRCType, crcpp_uint16 CRCWidth>
     struct Table
     {
         // Constructors are intentionally NOT marked explicit.
-        Table(const Parameters<CRCType, CRCWidth> & parameters);
+        crcpp_table_constexpr Table(const Parameters<CRCType, CRCWidth> & parameters);
 
 #ifdef CRCPP_USE_CPP11
-        Table(Parameters<CRCType, CRCWidth> && parameters);
+        crcpp_table_constexpr Table(Parameters<CRCType, CRCWidth> && parameters);
 #endif
 
-        const Parameters<CRCType, CRCWidth> & GetParameters() const;
+        crcpp_table_constexpr const Parameters<CRCType, CRCWidth> & GetParameters() const;
 
-        const CRCType * GetTable() const;
+        crcpp_table_constexpr const CRCType * GetTable() const;
 
-        CRCType operator[](unsigned char index) const;
+        crcpp_table_constexpr CRCType operator[](unsigned char index) const;
 
     private:
-        void InitTable();
+        crcpp_table_constexpr void InitTable();
 
         Parameters<CRCType, CRCWidth> parameters; ///< CRC parameters used to construct the table
         CRCType table[1 << CHAR_BIT];             ///< CRC lookup table
@@ -214,6 +236,18 @@ public:
     template <typename CRCType, crcpp_uint16 CRCWidth>
     static CRCType CalculateBits(const void * data, crcpp_size size, const Table<CRCType, CRCWidth> & lookupTable, CRCType crc);
 
+    /**
+        @brief Selects the CRC-32C implementation of CRC32C.cpp (SSE4.2, ARMv8 CRC or slicing-by-8, picked by CPU).
+        @note Same result as CRC_32_C(), defined in CRC32C.cpp.
+    */
+    struct Accelerated32C {};
+
+    static Accelerated32C CRC_32_C_Accelerated() { return Accelerated32C(); }
+
+    static crcpp_uint32 Calculate(const void * data, crcpp_size size, const Accelerated32C & accelerated);
+
+    static crcpp_uint32 Calculate(const void * data, crcpp_size size, const Accelerated32C & accelerated, crcpp_uint32 crc);
+
     // Common CRCs up to 64 bits.
     // Note: Check values are the computed CRCs when given an ASCII input of "123456789" (without null terminator)
 #ifdef CRCPP_INCLUDE_ESOTERIC_CRC_DEFINITIONS
@@ -306,7 +340,7 @@ private:
 #endif
 
     template <typename IntegerType>
-    static IntegerType Reflect(IntegerType value, crcpp_uint16 numBits);
+    static crcpp_table_constexpr IntegerType Reflect(IntegerType value, crcpp_uint16 numBits);
 
     template <typename CRCType, crcpp_uint16 CRCWidth>
     static CRCType Finalize(CRCType remainder, CRCType finalXOR, bool reflectOutput);
@@ -322,6 +356,9 @@ private:
 
     template <typename CRCType, crcpp_uint16 CRCWidth>
     static CRCType CalculateRemainderBits(unsigned char byte, crcpp_size numBits, const Parameters<CRCType, CRCWidth> & parameters, CRCType remainder);
+
+    template <typename CRCType, crcpp_uint16 CRCWidth>
+    static crcpp_table_constexpr CRCType CalculateTableEntry(unsigned char byte, const Parameters<CRCType, CRCWidth> & parameters);
 };
 
 /**
@@ -346,8 +383,9 @@ inline CRC::Table<CRCType, CRCWidth> CRC::Parameters<CRCType, CRCWidth>::MakeTab
     @tparam CRCWidth Number of bits in the CRC
 */
 template <typename CRCType, crcpp_uint16 CRCWidth>
-inline CRC::Table<CRCType, CRCWidth>::Table(const Parameters<CRCType, CRCWidth> & params) :
-    parameters(params)
+inline crcpp_table_constexpr CRC::Table<CRCType, CRCWidth>::Table(const Parameters<CRCType, CRCWidth> & params) :
+    parameters(params),
+    table()
 {
     InitTable();
 }
@@ -360,8 +398,9 @@ inline CRC::Table<CRCType, CRCWidth>::Table(const Parameters<CRCType, CRCWidth>
     @tparam CRCWidth Number of bits in the CRC
 */
 template <typename CRCType, crcpp_uint16 CRCWidth>
-inline CRC::Table<CRCType, CRCWidth>::Table(Parameters<CRCType, CRCWidth> && params) :
-    parameters(::std::move(params))
+inline crcpp_table_constexpr CRC::Table<CRCType, CRCWidth>::Table(Parameters<CRCType, CRCWidth> && params) :
+    parameters(::std::move(params)),
+    table()
 {
     InitTable();
 }
@@ -374,7 +413,7 @@ inline CRC::Table<CRCType, CRCWidth>::Table(Parameters<CRCType, CRCWidth> && par
     @return CRC parameters
 */
 template <typename CRCType, crcpp_uint16 CRCWidth>
-inline const CRC::Parameters<CRCType, CRCWidth> & CRC::Table<CRCType, CRCWidth>::GetParameters() const
+inline crcpp_table_constexpr const CRC::Parameters<CRCType, CRCWidth> & CRC::Table<CRCType, CRCWidth>::GetParameters() const
 {
     return parameters;
 }
@@ -386,7 +425,7 @@ inline const CRC::Parameters<CRCType, CRCWidth> & CRC::Table<CRCType, CRCWidth>:
     @return CRC table
 */
 template <typename CRCType, crcpp_uint16 CRCWidth>
-inline const CRCType * CRC::Table<CRCType, CRCWidth>::GetTable() const
+inline crcpp_table_constexpr const CRCType * CRC::Table<CRCType, CRCWidth>::GetTable() const
 {
     return table;
 }
@@ -399,49 +438,93 @@ inline const CRCType * CRC::Table<CRCType, CRCWidth>::GetTable() const
     @return CRC table entry
 */
 template <typename CRCType, crcpp_uint16 CRCWidth>
-inline CRCType CRC::Table<CRCType, CRCWidth>::operator[](unsigned char index) const
+inline crcpp_table_constexpr CRCType CRC::Table<CRCType, CRCWidth>::operator[](unsigned char index) const
 {
     return table[index];
 }
 
 /**
     @brief Initializes a CRC table.
+    @note With CRCPP_CONSTEXPR_TABLE this can run at compile time.
     @tparam CRCType Integer type for storing the CRC result
     @tparam CRCWidth Number of bits in the CRC
 */
 template <typename CRCType, crcpp_uint16 CRCWidth>
-inline void CRC::Table<CRCType, CRCWidth>::InitTable()
+inline crcpp_table_constexpr void CRC::Table<CRCType, CRCWidth>::InitTable()
 {
-    // For masking off the bits for the CRC (in the event that the number of bits in CRCType is larger than CRCWidth)
-    static crcpp_constexpr CRCType BIT_MASK((CRCType(1) << (CRCWidth - CRCType(1))) |
-                                           ((CRCType(1) << (CRCWidth - CRCType(1))) - CRCType(1)));
-
-    // The conditional expression is used to avoid a -Wshift-count-overflow warning.
-    static crcpp_constexpr CRCType SHIFT((CHAR_BIT >= CRCWidth) ? static_cast<CRCType>(CHAR_BIT - CRCWidth) : 0);
-
-    CRCType crc;
     unsigned char byte = 0;
 
     // Loop over each dividend (each possible number storable in an unsigned char)
     do
     {
-        crc = CRC::CalculateRemainder<CRCType, CRCWidth>(&byte, sizeof(byte), parameters, CRCType(0));
+        table[byte] = CRC::CalculateTableEntry<CRCType, CRCWidth>(byte, parameters);
+    }
+    while (++byte);
+}
+
+/**
+    @brief Computes one entry of a CRC lookup table, the remainder of a single byte with a zero initial value.
+    @note Same result as CalculateRemainder() on that byte, written without static locals or pointer casts
+        so that it can be evaluated at compile time.
+    @param[in] byte Dividend
+    @param[in] parameters CRC parameters
+    @tparam CRCType Integer type for storing the CRC result
+    @tparam CRCWidth Number of bits in the CRC
+    @return CRC table entry
+*/
+template <typename CRCType, crcpp_uint16 CRCWidth>
+inline crcpp_table_constexpr CRCType CRC::CalculateTableEntry(unsigned char byte, const Parameters<CRCType, CRCWidth> & parameters)
+{
+    // For masking off the bits for the CRC (in the event that the number of bits in CRCType is larger than CRCWidth)
+    const CRCType BIT_MASK((CRCType(1) << (CRCWidth - CRCType(1))) |
+                          ((CRCType(1) << (CRCWidth - CRCType(1))) - CRCType(1)));
+
+    CRCType remainder(0);
+
+    if (parameters.reflectInput)
+    {
+        const CRCType polynomial = CRC::Reflect(parameters.polynomial, CRCWidth);
+        remainder = static_cast<CRCType>(byte);
 
-        // This mask might not be necessary; all unit tests pass with this line commented out,
-        // but that might just be a coincidence based on the CRC parameters used for testing.
-        // In any case, this is harmless to leave in and only adds a single machine instruction per loop iteration.
-        crc &= BIT_MASK;
+        for (crcpp_size i = 0; i < CHAR_BIT; ++i)
+        {
+            remainder = static_cast<CRCType>((remainder & 1) ? ((remainder >> 1) ^ polynomial) : (remainder >> 1));
+        }
+    }
+    else if (CRCWidth >= CHAR_BIT)
+    {
+        const CRCType CRC_HIGHEST_BIT_MASK(CRCType(1) << (CRCWidth - CRCType(1)));
+
+        // The conditional expression is used to avoid a -Wshift-count-overflow warning.
+        const CRCType SHIFT((CRCWidth >= CHAR_BIT) ? static_cast<CRCType>(CRCWidth - CHAR_BIT) : 0);
 
-        if (!parameters.reflectInput && CRCWidth < CHAR_BIT)
+        remainder = static_cast<CRCType>(static_cast<CRCType>(byte) << SHIFT);
+
+        for (crcpp_size i = 0; i < CHAR_BIT; ++i)
+        {
+            remainder = static_cast<CRCType>((remainder & CRC_HIGHEST_BIT_MASK) ? ((remainder << 1) ^ parameters.polynomial) : (remainder << 1));
+        }
+    }
+    else
+    {
+        const CRCType CHAR_BIT_HIGHEST_BIT_MASK(CRCType(1) << (CHAR_BIT - 1));
+
+        // The conditional expression is used to avoid a -Wshift-count-overflow warning.
+        const CRCType SHIFT((CHAR_BIT >= CRCWidth) ? static_cast<CRCType>(CHAR_BIT - CRCWidth) : 0);
+
+        // Table entries of non-reflected CRCs < CHAR_BIT stay shifted up, see CalculateRemainder() with a table
+        const CRCType polynomial = static_cast<CRCType>(parameters.polynomial << SHIFT);
+        remainder = static_cast<CRCType>(byte);
+
+        for (crcpp_size i = 0; i < CHAR_BIT; ++i)
         {
-            // Undo the special operation at the end of the CalculateRemainder()
-            // function for non-reflected CRCs < CHAR_BIT.
-            crc = static_cast<CRCType>(crc << SHIFT);
+            remainder = static_cast<CRCType>((remainder & CHAR_BIT_HIGHEST_BIT_MASK) ? ((remainder << 1) ^ polynomial) : (remainder << 1));
         }
 
-        table[byte] = crc;
+        return static_cast<CRCType>(remainder & (BIT_MASK << SHIFT));
     }
-    while (++byte);
+
+    return static_cast<CRCType>(remainder & BIT_MASK);
 }
 
 /**
@@ -682,7 +765,7 @@ inline CRCType CRC::CalculateBits(const void * data, crcpp_size size, const Tabl
     @return Reflected value
 */
 template <typename IntegerType>
-inline IntegerType CRC::Reflect(IntegerType value, crcpp_uint16 numBits)
+inline crcpp_table_constexpr IntegerType CRC::Reflect(IntegerType value, crcpp_uint16 numBits)
 {
     IntegerType reversedValue(0);
 
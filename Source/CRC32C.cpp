@@ -0,0 +1,270 @@
+/*
+  ==============================================================================
+
+    CRC-32C (Castagnoli) for bulk integrity checks.
+
+  ==============================================================================
+*/
+
+#include "CRC32C.h"
+
+#include <array>
+#include <cstring>
+
+#include "CRC.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+ #define MIDIRTC_CRC32C_X86 1
+ #include <nmmintrin.h>
+ #if defined(_MSC_VER)
+  #include <intrin.h>
+ #else
+  #include <cpuid.h>
+ #endif
+#elif defined(__aarch64__) || defined(_M_ARM64)
+ #define MIDIRTC_CRC32C_ARM 1
+ #if defined(_MSC_VER)
+  #include <arm64intr.h>
+  #include <windows.h>
+ #else
+  #include <arm_acle.h>
+ #endif
+ #if defined(__linux__)
+  #include <sys/auxv.h>
+  #include <asm/hwcap.h>
+ #endif
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+ #define MIDIRTC_TARGET(features) __attribute__((target(features)))
+#else
+ #define MIDIRTC_TARGET(features)
+#endif
+
+namespace
+{
+	constexpr std::uint32_t reflectedPolynomial = 0x82F63B78;
+
+	//table k advances the crc of a byte by k further zero bytes
+	constexpr std::array<std::array<std::uint32_t, 256>, 8> makeSlicingTables()
+	{
+		std::array<std::array<std::uint32_t, 256>, 8> tables{};
+
+		for (std::uint32_t byte = 0; byte < 256; byte++)
+		{
+			auto crc = byte;
+
+			for (int bit = 0; bit < 8; bit++)
+				crc = (crc & 1) ? (crc >> 1) ^ reflectedPolynomial : crc >> 1;
+
+			tables[0][byte] = crc;
+		}
+
+		for (std::size_t k = 1; k < 8; k++)
+			for (std::size_t byte = 0; byte < 256; byte++)
+				tables[k][byte] = (tables[k - 1][byte] >> 8) ^ tables[0][tables[k - 1][byte] & 0xff];
+
+		return tables;
+	}
+
+	constexpr auto slicingTables = makeSlicingTables();
+
+	std::uint64_t load64(const std::uint8_t* bytes)
+	{
+		std::uint64_t value;
+		std::memcpy(&value, bytes, sizeof(value));
+		return value;
+	}
+
+	//the 64-bit step reads its input little endian, as every target of the plugin is
+	std::uint32_t crcSlicingBy8(std::uint32_t crc, const std::uint8_t* bytes, std::size_t size)
+	{
+		const auto& t = slicingTables;
+
+		for (; size >= 8; size -= 8, bytes += 8)
+		{
+			const auto word = load64(bytes) ^ crc;
+
+			crc = t[7][word & 0xff] ^ t[6][(word >> 8) & 0xff] ^ t[5][(word >> 16) & 0xff] ^ t[4][(word >> 24) & 0xff]
+				^ t[3][(word >> 32) & 0xff] ^ t[2][(word >> 40) & 0xff] ^ t[1][(word >> 48) & 0xff] ^ t[0][word >> 56];
+		}
+
+		for (; size > 0; size--)
+			crc = (crc >> 8) ^ t[0][(crc ^ *bytes++) & 0xff];
+
+		return crc;
+	}
+
+#if MIDIRTC_CRC32C_X86
+	MIDIRTC_TARGET("sse4.2")
+	std::uint32_t crcSse42(std::uint32_t crc, const std::uint8_t* bytes, std::size_t size)
+	{
+  #if defined(__x86_64__) || defined(_M_X64)
+		std::uint64_t crc64 = crc;
+
+		for (; size >= 8; size -= 8, bytes += 8)
+			crc64 = _mm_crc32_u64(crc64, load64(bytes));
+
+		crc = std::uint32_t(crc64);
+  #endif
+
+		for (; size >= 4; size -= 4, bytes += 4)
+		{
+			std::uint32_t word;
+			std::memcpy(&word, bytes, sizeof(word));
+			crc = _mm_crc32_u32(crc, word);
+		}
+
+		for (; size > 0; size--)
+			crc = _mm_crc32_u8(crc, *bytes++);
+
+		return crc;
+	}
+
+	bool cpuHasSse42()
+	{
+  #if defined(_MSC_VER)
+		int info[4] = {};
+		__cpuid(info, 1);
+		return (info[2] & (1 << 20)) != 0;
+  #else
+		unsigned int eax = 0, ebx = 0, ecx = 0, edx = 0;
+		return __get_cpuid(1, &eax, &ebx, &ecx, &edx) && (ecx & bit_SSE4_2) != 0;
+  #endif
+	}
+#endif
+
+#if MIDIRTC_CRC32C_ARM
+  #if defined(__clang__)
+	MIDIRTC_TARGET("crc")
+  #elif defined(__GNUC__)
+	MIDIRTC_TARGET("+crc")
+  #endif
+	std::uint32_t crcArmv8(std::uint32_t crc, const std::uint8_t* bytes, std::size_t size)
+	{
+		for (; size >= 8; size -= 8, bytes += 8)
+			crc = __crc32cd(crc, load64(bytes));
+
+		for (; size > 0; size--)
+			crc = __crc32cb(crc, *bytes++);
+
+		return crc;
+	}
+
+	bool cpuHasArmCrc()
+	{
+  #if defined(__APPLE__)
+		return true;    //every Apple arm64 core has it
+  #elif defined(_MSC_VER)
+		return IsProcessorFeaturePresent(PF_ARM_V8_CRC32_INSTRUCTIONS_AVAILABLE) != 0;
+  #elif defined(__linux__) && defined(HWCAP_CRC32)
+		return (getauxval(AT_HWCAP) & HWCAP_CRC32) != 0;
+  #elif defined(__ARM_FEATURE_CRC32)
+		return true;
+  #else
+		return false;
+  #endif
+	}
+#endif
+
+	using CrcFunction = std::uint32_t (*)(std::uint32_t, const std::uint8_t*, std::size_t);
+
+	CrcFunction functionFor(CRC32C::Implementation implementation)
+	{
+		switch (implementation)
+		{
+#if MIDIRTC_CRC32C_X86
+			case CRC32C::Implementation::sse42:
+				return crcSse42;
+#endif
+#if MIDIRTC_CRC32C_ARM
+			case CRC32C::Implementation::armv8:
+				return crcArmv8;
+#endif
+			default:
+				return crcSlicingBy8;
+		}
+	}
+
+	CRC32C::Implementation detectImplementation()
+	{
+		if (CRC32C::isSupported(CRC32C::Implementation::sse42))
+			return CRC32C::Implementation::sse42;
+
+		if (CRC32C::isSupported(CRC32C::Implementation::armv8))
+			return CRC32C::Implementation::armv8;
+
+		return CRC32C::Implementation::slicingBy8;
+	}
+
+	//CPU detection runs once, the first call from any thread (or static initialiser) waits for it
+	CRC32C::Implementation getBestImplementation()
+	{
+		static const auto implementation = detectImplementation();
+		return implementation;
+	}
+
+	CrcFunction getBestFunction()
+	{
+		static const auto function = functionFor(getBestImplementation());
+		return function;
+	}
+}
+
+//==============================================================================
+bool CRC32C::isSupported(Implementation implementation) noexcept
+{
+	switch (implementation)
+	{
+#if MIDIRTC_CRC32C_X86
+		case Implementation::sse42:
+			return cpuHasSse42();
+#endif
+#if MIDIRTC_CRC32C_ARM
+		case Implementation::armv8:
+			return cpuHasArmCrc();
+#endif
+		case Implementation::slicingBy8:
+			return true;
+
+		default:
+			return false;
+	}
+}
+
+CRC32C::Implementation CRC32C::getImplementation() noexcept
+{
+	return getBestImplementation();
+}
+
+const char* CRC32C::getImplementationName(Implementation implementation) noexcept
+{
+	switch (implementation)
+	{
+		case Implementation::sse42:         return "sse42";
+		case Implementation::armv8:         return "armv8";
+		case Implementation::slicingBy8:
+		default:                            return "slicing-by-8";
+	}
+}
+
+std::uint32_t CRC32C::calculate(const void* data, std::size_t size, std::uint32_t crc) noexcept
+{
+	return ~getBestFunction()(~crc, static_cast<const std::uint8_t*>(data), size);
+}
+
+std::uint32_t CRC32C::calculate(Implementation implementation, const void* data, std::size_t size, std::uint32_t crc) noexcept
+{
+	return ~functionFor(implementation)(~crc, static_cast<const std::uint8_t*>(data), size);
+}
+
+//==============================================================================
+crcpp_uint32 CRC::Calculate(const void * data, crcpp_size size, const Accelerated32C &)
+{
+	return CRC32C::calculate(data, size);
+}
+
+crcpp_uint32 CRC::Calculate(const void * data, crcpp_size size, const Accelerated32C &, crcpp_uint32 crc)
+{
+	return CRC32C::calculate(data, size, crc);
+}
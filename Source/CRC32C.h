@@ -0,0 +1,47 @@
+/*
+  ==============================================================================
+
+    CRC-32C (Castagnoli) for bulk integrity checks: batches, recorded
+    sessions, SysEx dumps.
+
+    Three implementations compute the same value:
+
+        sse42       the crc32 instruction of SSE4.2 (x86/x64)
+        armv8       the crc32c instructions of the ARMv8 CRC extension
+        slicingBy8  portable, eight table lookups per 8 bytes
+
+    The fastest one the CPU supports is picked on first use and kept for
+    the lifetime of the process. CRC::Calculate(data, size, CRC::CRC_32_C_Accelerated())
+    routes here as well.
+
+    Parameters: polynomial 0x1EDC6F41, reflected, initial value and final
+    xor 0xFFFFFFFF, check value 0xE3069283.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace CRC32C
+{
+    enum class Implementation
+    {
+        slicingBy8,
+        sse42,
+        armv8
+    };
+
+    //crc of the data, or of a previous calculation's data followed by this data when crc is its result
+    std::uint32_t calculate(const void* data, std::size_t size, std::uint32_t crc = 0) noexcept;
+
+    //the implementation calculate() dispatches to
+    Implementation getImplementation() noexcept;
+    const char* getImplementationName(Implementation implementation) noexcept;
+
+    //lets benchmarks and tests pick one, calling an unsupported one is undefined
+    bool isSupported(Implementation implementation) noexcept;
+    std::uint32_t calculate(Implementation implementation, const void* data, std::size_t size, std::uint32_t crc = 0) noexcept;
+}
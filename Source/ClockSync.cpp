@@ -0,0 +1,206 @@
+/*
+  ==============================================================================
+
+    NTP-style clock synchronisation between two peers over the DataChannel.
+
+  ==============================================================================
+*/
+
+#include "ClockSync.h"
+
+#include <algorithm>
+
+#include "PacketFramer.h"
+
+namespace
+{
+	//a reader gives up after this many torn reads instead of spinning on the audio thread
+	constexpr int maxReadAttempts = 4;
+
+	void writeInt64(std::uint8_t* bytes, std::int64_t value)
+	{
+		for (int i = 7; i >= 0; i--, value = std::int64_t(std::uint64_t(value) >> 8))
+			bytes[i] = std::uint8_t(value);
+	}
+
+	std::int64_t readInt64(const std::uint8_t* bytes)
+	{
+		std::uint64_t value = 0;
+
+		for (int i = 0; i < 8; i++)
+			value = value << 8 | bytes[i];
+
+		return std::int64_t(value);
+	}
+
+	bool hasValidCrc(const std::uint8_t* bytes, std::size_t size)
+	{
+		return PacketFormat::checksum(bytes, size - 1) == bytes[size - 1];
+	}
+}
+
+//==============================================================================
+void AudioClockAnchorSlot::store(const AudioClockAnchor& anchor) noexcept
+{
+	const auto seq = sequence.load(std::memory_order_relaxed);
+	sequence.store(seq + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	sampleTime.store(anchor.sampleTime, std::memory_order_relaxed);
+	micros.store(anchor.micros, std::memory_order_relaxed);
+	sampleRate.store(anchor.sampleRate, std::memory_order_relaxed);
+
+	sequence.store(seq + 2, std::memory_order_release);
+}
+
+bool AudioClockAnchorSlot::load(AudioClockAnchor& anchor) const noexcept
+{
+	for (int attempt = 0; attempt < maxReadAttempts; attempt++)
+	{
+		const auto before = sequence.load(std::memory_order_acquire);
+
+		if (before & 1)
+			continue;
+
+		AudioClockAnchor copy;
+		copy.sampleTime = sampleTime.load(std::memory_order_relaxed);
+		copy.micros = micros.load(std::memory_order_relaxed);
+		copy.sampleRate = sampleRate.load(std::memory_order_relaxed);
+
+		std::atomic_thread_fence(std::memory_order_acquire);
+
+		if (sequence.load(std::memory_order_relaxed) == before)
+		{
+			anchor = copy;
+			return copy.sampleRate != 0;
+		}
+	}
+
+	return false;
+}
+
+//==============================================================================
+std::size_t ClockSync::makePing(std::int64_t nowMicros, std::uint8_t* out) noexcept
+{
+	out[0] = PacketFormat::clockPing;
+	writeInt64(out + 1, nowMicros);
+	out[pingSize - 1] = PacketFormat::checksum(out, pingSize - 1);
+	return pingSize;
+}
+
+std::size_t ClockSync::makePong(const std::uint8_t* ping, std::size_t size, std::int64_t receiveMicros,
+	std::int64_t sendMicros, const AudioClockAnchor& localAnchor, std::uint8_t* out) noexcept
+{
+	if (size != pingSize || ping[0] != PacketFormat::clockPing || !hasValidCrc(ping, size))
+		return 0;
+
+	out[0] = PacketFormat::clockPong;
+	std::copy(ping + 1, ping + 9, out + 1);
+	writeInt64(out + 9, receiveMicros);
+	writeInt64(out + 17, sendMicros);
+	writeInt64(out + 25, localAnchor.sampleTime);
+	writeInt64(out + 33, localAnchor.micros);
+
+	for (int i = 0; i < 4; i++)
+		out[41 + i] = std::uint8_t(localAnchor.sampleRate >> (24 - 8 * i));
+
+	out[pongSize - 1] = PacketFormat::checksum(out, pongSize - 1);
+	return pongSize;
+}
+
+bool ClockSync::handlePong(const std::uint8_t* pong, std::size_t size, std::int64_t nowMicros) noexcept
+{
+	if (size != pongSize || pong[0] != PacketFormat::clockPong || !hasValidCrc(pong, size))
+		return false;
+
+	const auto t1 = readInt64(pong + 1);
+	const auto t2 = readInt64(pong + 9);
+	const auto t3 = readInt64(pong + 17);
+	const auto t4 = nowMicros;
+
+	Sample sample;
+	sample.roundTrip = (t4 - t1) - (t3 - t2);
+	sample.offset = ((t2 - t1) + (t3 - t4)) / 2;
+
+	if (t4 < t1 || t3 < t2 || sample.roundTrip < 0)
+		return false;
+
+	samples[nextSample] = sample;
+	nextSample = (nextSample + 1) % numSamples;
+	numStored = std::min(numStored + 1, numSamples);
+
+	// min-RTT filter: the least delayed exchange gives the least skewed offset
+	const auto best = *std::min_element(samples.begin(), samples.begin() + numStored,
+		[](const Sample& a, const Sample& b) { return a.roundTrip < b.roundTrip; });
+
+	AudioClockAnchor anchor;
+	anchor.sampleTime = readInt64(pong + 25);
+	anchor.micros = readInt64(pong + 33);
+	anchor.sampleRate = std::uint32_t(pong[41]) << 24 | std::uint32_t(pong[42]) << 16
+		| std::uint32_t(pong[43]) << 8 | std::uint32_t(pong[44]);
+
+	const auto seq = sequence.load(std::memory_order_relaxed);
+	sequence.store(seq + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	offsetMicros.store(best.offset, std::memory_order_relaxed);
+	roundTripMicros.store(best.roundTrip, std::memory_order_relaxed);
+	remoteAnchor.store(anchor);
+	valid.store(true, std::memory_order_relaxed);
+
+	sequence.store(seq + 2, std::memory_order_release);
+	return true;
+}
+
+bool ClockSync::getEstimate(Estimate& estimate) const noexcept
+{
+	for (int attempt = 0; attempt < maxReadAttempts; attempt++)
+	{
+		const auto before = sequence.load(std::memory_order_acquire);
+
+		if (before & 1)
+			continue;
+
+		Estimate copy;
+		const auto isValid = valid.load(std::memory_order_relaxed);
+		copy.offsetMicros = offsetMicros.load(std::memory_order_relaxed);
+		copy.roundTripMicros = roundTripMicros.load(std::memory_order_relaxed);
+		const auto hasAnchor = remoteAnchor.load(copy.remoteAnchor);
+
+		std::atomic_thread_fence(std::memory_order_acquire);
+
+		if (sequence.load(std::memory_order_relaxed) == before)
+		{
+			if (!isValid || !hasAnchor)
+				return false;
+
+			estimate = copy;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void ClockSync::reset() noexcept
+{
+	numStored = 0;
+	nextSample = 0;
+
+	const auto seq = sequence.load(std::memory_order_relaxed);
+	sequence.store(seq + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	valid.store(false, std::memory_order_relaxed);
+	sequence.store(seq + 2, std::memory_order_release);
+}
+
+std::int64_t ClockSync::remoteSampleToLocalMicros(const Estimate& estimate, std::uint32_t remoteSampleTime) noexcept
+{
+	const auto& anchor = estimate.remoteAnchor;
+
+	// 32-bit wire times are taken as the nearest match to the 64-bit anchor
+	const auto samplesFromAnchor = std::int64_t(std::int32_t(remoteSampleTime - std::uint32_t(anchor.sampleTime)));
+	const auto remoteMicros = anchor.micros + samplesFromAnchor * 1000000 / std::int64_t(anchor.sampleRate);
+
+	return remoteMicros - estimate.offsetMicros;
+}
@@ -0,0 +1,106 @@
+/*
+  ==============================================================================
+
+    NTP-style clock synchronisation between two peers over the DataChannel.
+
+    One side sends a ping stamped with its local time t1, the peer answers
+    with a pong carrying t1, its receive time t2 and its send time t3, and
+    the pinger notes the arrival time t4:
+
+        offset = ((t2 - t1) + (t3 - t4)) / 2     (peer clock - local clock)
+        rtt    = (t4 - t1) - (t3 - t2)
+
+    The last few samples are kept and the one with the smallest round trip
+    wins, since queueing delay only ever adds to it and skews the offset.
+
+    A pong also carries the peer's audio clock anchor (a sample time and the
+    local time it was taken at, plus the sample rate), which is what lets
+    remote sample timestamps be placed on the local timeline.
+
+    The current estimate can be read lock-free from any thread, including
+    the audio thread. All times are microseconds.
+
+        ping: [type][t1][crc8]
+        pong: [type][t1][t2][t3][anchor sample][anchor time][sample rate][crc8]
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+//a sample time on some audio clock and the wall time it corresponds to
+struct AudioClockAnchor
+{
+    std::int64_t sampleTime = 0;
+    std::int64_t micros = 0;
+    std::uint32_t sampleRate = 0;
+};
+
+//single-writer publication of an AudioClockAnchor, readers never block the writer
+class AudioClockAnchorSlot
+{
+public:
+    void store(const AudioClockAnchor& anchor) noexcept;
+    bool load(AudioClockAnchor& anchor) const noexcept;
+
+private:
+    std::atomic<std::uint32_t> sequence{ 0 };
+    std::atomic<std::int64_t> sampleTime{ 0 }, micros{ 0 };
+    std::atomic<std::uint32_t> sampleRate{ 0 };
+};
+
+class ClockSync
+{
+public:
+    static constexpr std::size_t pingSize = 1 + 8 + 1;
+    static constexpr std::size_t pongSize = 1 + 8 * 5 + 4 + 1;
+    static constexpr std::size_t numSamples = 16;
+
+    struct Estimate
+    {
+        std::int64_t offsetMicros = 0;      //peer clock minus local clock
+        std::int64_t roundTripMicros = 0;
+        AudioClockAnchor remoteAnchor;      //peer's audio clock, peer wall time
+    };
+
+    //returns the number of bytes written to out (pingSize)
+    static std::size_t makePing(std::int64_t nowMicros, std::uint8_t* out) noexcept;
+
+    //answers a received ping, returns the number of bytes written to out (pongSize) or 0 if the ping is invalid
+    static std::size_t makePong(const std::uint8_t* ping, std::size_t size, std::int64_t receiveMicros,
+        std::int64_t sendMicros, const AudioClockAnchor& localAnchor, std::uint8_t* out) noexcept;
+
+    //network side: feed a received pong, false if it was malformed or implausible
+    bool handlePong(const std::uint8_t* pong, std::size_t size, std::int64_t nowMicros) noexcept;
+
+    //any thread, false until the first pong came back
+    bool getEstimate(Estimate& estimate) const noexcept;
+
+    //forget everything, e.g. when the peer changes
+    void reset() noexcept;
+
+    //peer's audio clock sample time -> local wall time, using the current estimate
+    static std::int64_t remoteSampleToLocalMicros(const Estimate& estimate, std::uint32_t remoteSampleTime) noexcept;
+
+private:
+    struct Sample
+    {
+        std::int64_t offset = 0;
+        std::int64_t roundTrip = 0;
+    };
+
+    std::array<Sample, numSamples> samples{};
+    std::size_t numStored = 0;
+    std::size_t nextSample = 0;
+
+    //published estimate, guarded by a sequence counter
+    std::atomic<std::uint32_t> sequence{ 0 };
+    std::atomic<bool> valid{ false };
+    std::atomic<std::int64_t> offsetMicros{ 0 }, roundTripMicros{ 0 };
+    AudioClockAnchorSlot remoteAnchor;
+};
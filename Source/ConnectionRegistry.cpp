@@ -0,0 +1,127 @@
+/*
+  ==============================================================================
+
+    The PeerConnections and DataChannels of one plugin instance.
+
+  ==============================================================================
+*/
+
+#include "ConnectionRegistry.h"
+
+ConnectionRegistry::ConnectionRegistry()
+	: snapshot(std::make_shared<const Snapshot>())
+{
+}
+
+ConnectionRegistry::~ConnectionRegistry()
+{
+	closeAll();
+}
+
+std::shared_ptr<const ConnectionRegistry::Snapshot> ConnectionRegistry::load() const
+{
+	return std::atomic_load(&snapshot);
+}
+
+ConnectionRegistry::PeerPtr ConnectionRegistry::findPeer(const std::string& partnerId) const
+{
+	const auto current = load();
+	const auto it = current->find(partnerId);
+	return it != current->end() ? it->second.connection : nullptr;
+}
+
+void ConnectionRegistry::setPeer(const std::string& partnerId, PeerPtr connection)
+{
+	Peer replaced;
+	{
+		const std::lock_guard<std::mutex> lock(writerMutex);
+		auto next = std::make_shared<Snapshot>(*load());
+		auto& peer = (*next)[partnerId];
+
+		replaced = std::move(peer);
+		peer = Peer{ std::move(connection), {} };
+		std::atomic_store(&snapshot, std::shared_ptr<const Snapshot>(std::move(next)));
+	}
+
+	close(replaced);
+}
+
+bool ConnectionRegistry::removePeer(const std::string& partnerId, const PeerPtr& connection)
+{
+	Peer removed;
+	{
+		const std::lock_guard<std::mutex> lock(writerMutex);
+		auto next = std::make_shared<Snapshot>(*load());
+		const auto it = next->find(partnerId);
+
+		if (it == next->end() || it->second.connection != connection)
+			return false;
+
+		removed = std::move(it->second);
+		next->erase(it);
+		std::atomic_store(&snapshot, std::shared_ptr<const Snapshot>(std::move(next)));
+	}
+
+	close(removed);
+	return true;
+}
+
+void ConnectionRegistry::addChannel(const std::string& partnerId, ChannelPtr channel)
+{
+	const std::lock_guard<std::mutex> lock(writerMutex);
+	auto next = std::make_shared<Snapshot>(*load());
+	const auto it = next->find(partnerId);
+
+	if (it == next->end())
+		return;
+
+	it->second.channels.push_back(std::move(channel));
+	std::atomic_store(&snapshot, std::shared_ptr<const Snapshot>(std::move(next)));
+}
+
+void ConnectionRegistry::forEachChannel(const std::function<void(const std::string&, const ChannelPtr&)>& visit) const
+{
+	const auto current = load();
+
+	for (const auto& [partnerId, peer] : *current)
+		for (const auto& channel : peer.channels)
+			visit(partnerId, channel);
+}
+
+size_t ConnectionRegistry::getNumPeers() const
+{
+	return load()->size();
+}
+
+void ConnectionRegistry::closeAll()
+{
+	std::shared_ptr<const Snapshot> closing;
+	{
+		const std::lock_guard<std::mutex> lock(writerMutex);
+		closing = load();
+		std::atomic_store(&snapshot, std::make_shared<const Snapshot>());
+	}
+
+	for (const auto& entry : *closing)
+		close(entry.second);
+}
+
+//callbacks capture their owner, they are detached before anything is closed so none runs after teardown
+void ConnectionRegistry::close(const Peer& peer)
+{
+	for (const auto& channel : peer.channels)
+	{
+		channel->resetCallbacks();
+		channel->close();
+	}
+
+	if (const auto& connection = peer.connection)
+	{
+		connection->onDataChannel(nullptr);
+		connection->onLocalDescription(nullptr);
+		connection->onLocalCandidate(nullptr);
+		connection->onStateChange(nullptr);
+		connection->onGatheringStateChange(nullptr);
+		connection->close();
+	}
+}
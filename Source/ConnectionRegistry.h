@@ -0,0 +1,75 @@
+/*
+  ==============================================================================
+
+    The PeerConnections and DataChannels of one plugin instance (or of the
+    relay, see Relay/), keyed by the partner's id.
+
+    Lookups read an immutable snapshot through std::atomic_load, so the
+    WebSocket thread, the message thread and DataChannel callbacks never
+    wait on each other to find a connection. Changes are serialised by a
+    writer mutex, copy the snapshot, edit the copy and publish it; they
+    only happen while connections are set up or torn down.
+
+    closeAll() empties the registry first and then detaches the callbacks
+    of everything it held and closes it, outside the writer mutex. A
+    reader that still holds the old snapshot keeps its connections alive
+    until it lets go.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <rtc/rtc.hpp>
+
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class ConnectionRegistry
+{
+public:
+    using PeerPtr = std::shared_ptr<rtc::PeerConnection>;
+    using ChannelPtr = std::shared_ptr<rtc::DataChannel>;
+
+    ConnectionRegistry();
+    ~ConnectionRegistry();
+
+    ConnectionRegistry(const ConnectionRegistry&) = delete;
+    ConnectionRegistry& operator=(const ConnectionRegistry&) = delete;
+
+    //nullptr if there is no connection to this partner
+    PeerPtr findPeer(const std::string& partnerId) const;
+
+    //replaces any connection to this partner, the old one and its channels are closed
+    void setPeer(const std::string& partnerId, PeerPtr connection);
+
+    //removes and closes the partner's connection, false if another one replaced it meanwhile
+    bool removePeer(const std::string& partnerId, const PeerPtr& connection);
+
+    //keeps the channel alive with its connection, ignored if the partner has no connection any more
+    void addChannel(const std::string& partnerId, ChannelPtr channel);
+
+    void forEachChannel(const std::function<void(const std::string& partnerId, const ChannelPtr&)>& visit) const;
+    size_t getNumPeers() const;
+
+    void closeAll();
+
+private:
+    struct Peer
+    {
+        PeerPtr connection;
+        std::vector<ChannelPtr> channels;
+    };
+
+    using Snapshot = std::unordered_map<std::string, Peer>;
+
+    std::shared_ptr<const Snapshot> load() const;
+    static void close(const Peer& peer);
+
+    std::shared_ptr<const Snapshot> snapshot;
+    std::mutex writerMutex;
+};
@@ -0,0 +1,122 @@
+/*
+  ==============================================================================
+
+    State of the link to the partner.
+
+  ==============================================================================
+*/
+
+#include "ConnectionState.h"
+
+namespace
+{
+	using State = ConnectionState::State;
+
+	constexpr std::uint16_t bit(State state)
+	{
+		return std::uint16_t(1u << unsigned(state));
+	}
+
+	//where each state may go next, closed and failed are reachable from everywhere. failed leads to
+	//open: in a session one partner failing doesn't stop the channel of another from opening
+	constexpr std::uint16_t anyEnd = bit(State::closed) | bit(State::failed);
+
+	constexpr std::uint16_t allowedTargets[ConnectionState::numStates] = {
+		/* idle */          bit(State::signaling) | bit(State::connecting) | anyEnd,
+		/* signaling */     bit(State::idle) | bit(State::ready) | anyEnd,
+		/* ready */         bit(State::idle) | bit(State::signaling) | bit(State::connecting) | anyEnd,
+		/* connecting */    bit(State::ready) | bit(State::iceChecking) | bit(State::open) | anyEnd,
+		/* iceChecking */   bit(State::ready) | bit(State::connecting) | bit(State::open) | anyEnd,
+		/* open */          bit(State::ready) | bit(State::degraded) | anyEnd,
+		/* degraded */      bit(State::ready) | bit(State::open) | anyEnd,
+		/* closed */        bit(State::idle) | bit(State::signaling) | bit(State::connecting) | bit(State::failed),
+		/* failed */        bit(State::idle) | bit(State::signaling) | bit(State::ready) | bit(State::connecting) | bit(State::open)
+		                    | bit(State::closed)
+	};
+}
+
+bool ConnectionState::isAllowed(State fromState, State toState) noexcept
+{
+	return (allowedTargets[std::size_t(fromState)] & bit(toState)) != 0;
+}
+
+bool ConnectionState::transition(State newState, Reason reason, std::int64_t nowMicros) noexcept
+{
+	auto expected = word.load(std::memory_order_acquire);
+
+	for (;;)
+	{
+		if (!isAllowed(unpack(expected).state, newState))
+			return false;
+
+		if (commit(expected, newState, reason, nowMicros))
+			return true;
+	}
+}
+
+bool ConnectionState::transition(State fromState, State newState, Reason reason, std::int64_t nowMicros) noexcept
+{
+	auto expected = word.load(std::memory_order_acquire);
+
+	for (;;)
+	{
+		if (unpack(expected).state != fromState || !isAllowed(fromState, newState))
+			return false;
+
+		if (commit(expected, newState, reason, nowMicros))
+			return true;
+	}
+}
+
+//expected is updated to the current word if another transition got there first
+bool ConnectionState::commit(std::uint64_t& expected, State newState, Reason reason, std::int64_t nowMicros) noexcept
+{
+	if (!word.compare_exchange_weak(expected, pack(newState, reason, nowMicros), std::memory_order_acq_rel, std::memory_order_acquire))
+		return false;
+
+	timeEntered[std::size_t(newState)].store(nowMicros, std::memory_order_relaxed);
+	numTransitions.fetch_add(1, std::memory_order_relaxed);
+	return true;
+}
+
+const char* ConnectionState::getName(State state) noexcept
+{
+	switch (state)
+	{
+		case State::idle:           return "Idle";
+		case State::signaling:      return "Signaling";
+		case State::ready:          return "Ready";
+		case State::connecting:     return "Connecting";
+		case State::iceChecking:    return "ICE checking";
+		case State::open:           return "Open";
+		case State::degraded:       return "Degraded";
+		case State::closed:         return "Closed";
+		case State::failed:         return "Failed";
+		default:                    return "Unknown";
+	}
+}
+
+const char* ConnectionState::getName(Reason reason) noexcept
+{
+	switch (reason)
+	{
+		case Reason::none:              return "";
+		case Reason::signalingStarted:  return "connecting to signaling server";
+		case Reason::signalingOpened:   return "signaling connected";
+		case Reason::signalingClosed:   return "signaling closed";
+		case Reason::signalingFailed:   return "signaling failed";
+		case Reason::offerSent:         return "offer sent";
+		case Reason::offerReceived:     return "offer received";
+		case Reason::iceChecking:       return "ICE checking";
+		case Reason::iceConnected:      return "ICE connected";
+		case Reason::iceDisconnected:   return "ICE disconnected";
+		case Reason::iceFailed:         return "ICE failed";
+		case Reason::channelOpened:     return "channel open";
+		case Reason::channelClosed:     return "channel closed";
+		case Reason::highLoss:          return "high packet loss";
+		case Reason::lossRecovered:     return "loss recovered";
+		case Reason::timedOut:          return "timed out";
+		case Reason::released:          return "released";
+		default:                        return "";
+	}
+}
@@ -0,0 +1,135 @@
+/*
+  ==============================================================================
+
+    State of the link to the partner, shared between the libdatachannel
+    threads that drive it and the audio and message threads that read it.
+
+    The usual path is idle, signaling, ready, connecting, iceChecking and
+    open; open and degraded alternate while the channel is up, and ready
+    follows once it closes. closed and failed can be entered from anywhere,
+    and a channel that opens after failed (another partner of the session)
+    makes the link open again.
+
+    signaling   WebSocket to the signaling server opening
+    ready       signaling connected, no peer
+    connecting  offer/answer being exchanged
+    iceChecking ICE looking for a working candidate pair
+    open        DataChannel open
+    degraded    DataChannel open, but ICE reported a disconnect or loss is high
+
+    State, reason and the time of the last transition are packed into one
+    atomic word, so readers get a consistent view with a single load and
+    never block; transitions are a compare-and-swap. Transitions the table
+    in ConnectionState.cpp does not allow are refused, which keeps late
+    callbacks of an old connection from overwriting the state of a newer
+    one.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+class ConnectionState
+{
+public:
+    enum class State : std::uint8_t
+    {
+        idle,
+        signaling,
+        ready,
+        connecting,
+        iceChecking,
+        open,
+        degraded,
+        closed,
+        failed
+    };
+
+    static constexpr std::size_t numStates = 9;
+
+    enum class Reason : std::uint8_t
+    {
+        none,
+        signalingStarted,
+        signalingOpened,
+        signalingClosed,
+        signalingFailed,
+        offerSent,
+        offerReceived,
+        iceChecking,
+        iceConnected,
+        iceDisconnected,
+        iceFailed,
+        channelOpened,
+        channelClosed,
+        highLoss,
+        lossRecovered,
+        timedOut,
+        released
+    };
+
+    struct Snapshot
+    {
+        State state = State::idle;
+        Reason reason = Reason::none;
+        std::int64_t sinceMicros = 0;   //time of the transition into state, caller's clock
+    };
+
+    //any thread, wait-free
+    Snapshot getSnapshot() const noexcept { return unpack(word.load(std::memory_order_acquire)); }
+    State getState() const noexcept { return getSnapshot().state; }
+
+    //a DataChannel is open, audio can be sent
+    bool isOpen() const noexcept
+    {
+        const auto state = getState();
+        return state == State::open || state == State::degraded;
+    }
+
+    //last time the link entered a state, 0 if it never did
+    std::int64_t getTimeEntered(State state) const noexcept
+    {
+        return timeEntered[std::size_t(state)].load(std::memory_order_relaxed);
+    }
+
+    std::uint64_t getNumTransitions() const noexcept { return numTransitions.load(std::memory_order_relaxed); }
+
+    //false if the current state doesn't lead to newState, or already is newState
+    bool transition(State newState, Reason reason, std::int64_t nowMicros) noexcept;
+
+    //as above, but only out of fromState
+    bool transition(State fromState, State newState, Reason reason, std::int64_t nowMicros) noexcept;
+
+    static bool isAllowed(State fromState, State toState) noexcept;
+    static const char* getName(State state) noexcept;
+    static const char* getName(Reason reason) noexcept;
+
+private:
+    //[state 8][reason 8][micros 48]
+    static std::uint64_t pack(State state, Reason reason, std::int64_t micros) noexcept
+    {
+        return std::uint64_t(state) << 56 | std::uint64_t(reason) << 48 | (std::uint64_t(micros) & timeMask);
+    }
+
+    static Snapshot unpack(std::uint64_t packed) noexcept
+    {
+        Snapshot snapshot;
+        snapshot.state = State(packed >> 56);
+        snapshot.reason = Reason((packed >> 48) & 0xff);
+        snapshot.sinceMicros = std::int64_t(packed & timeMask);
+        return snapshot;
+    }
+
+    bool commit(std::uint64_t& expected, State newState, Reason reason, std::int64_t nowMicros) noexcept;
+
+    static constexpr std::uint64_t timeMask = (std::uint64_t(1) << 48) - 1;   //about 8.9 years of micros
+
+    std::atomic<std::uint64_t> word{ pack(State::idle, Reason::none, 0) };
+    std::array<std::atomic<std::int64_t>, numStates> timeEntered{};
+    std::atomic<std::uint64_t> numTransitions{ 0 };
+};
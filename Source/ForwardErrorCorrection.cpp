@@ -0,0 +1,288 @@
+/*
+  ==============================================================================
+
+    XOR parity forward error correction for MIDI batches.
+
+  ==============================================================================
+*/
+
+#include "ForwardErrorCorrection.h"
+
+#include <algorithm>
+
+#include "PacketFramer.h"
+
+namespace
+{
+	constexpr std::size_t parityHeaderSize = 8;
+
+	void xorInto(std::vector<std::byte>& target, const std::byte* data, std::size_t size)
+	{
+		if (target.size() < size)
+			target.resize(size, std::byte(0));
+
+		for (std::size_t i = 0; i < size; i++)
+			target[i] ^= data[i];
+	}
+
+	std::uint8_t crcOf(const std::vector<std::byte>& bytes, std::size_t size)
+	{
+		return PacketFormat::checksum(bytes.data(), size);
+	}
+
+	std::uint32_t readSequence(const std::vector<std::byte>& bytes)
+	{
+		std::uint32_t sequence = 0;
+		PacketFormat::peekSequence(bytes.data(), bytes.size(), sequence);
+		return sequence;
+	}
+}
+
+//==============================================================================
+void FecEncoder::setGroupSize(int newGroupSize)
+{
+	fixedGroupSize = std::clamp(newGroupSize, 0, maxGroupSize);
+
+	if (fixedGroupSize > 0)
+		groupSize = fixedGroupSize;
+}
+
+int FecEncoder::groupSizeForLoss(double lossRate)
+{
+	if (lossRate < 0.001)
+		return 0;
+	if (lossRate < 0.01)
+		return 8;
+	if (lossRate < 0.05)
+		return 4;
+	if (lossRate < 0.15)
+		return 2;
+
+	return 1;
+}
+
+void FecEncoder::setMeasuredLoss(double lossRate)
+{
+	if (fixedGroupSize == 0)
+		groupSize = groupSizeForLoss(lossRate);
+}
+
+bool FecEncoder::add(const std::vector<std::byte>& packet, std::vector<std::byte>& parity)
+{
+	if (groupSize == 0 || packet.size() < PacketFormat::headerSize || packet.size() > 0xffff)
+	{
+		reset();
+		return false;
+	}
+
+	if (numInGroup == 0)
+	{
+		firstSequence = readSequence(packet);
+		lengthXor = 0;
+		xorBuffer.clear();
+	}
+
+	xorInto(xorBuffer, packet.data(), packet.size());
+	lengthXor ^= std::uint16_t(packet.size());
+
+	if (++numInGroup < groupSize)
+		return false;
+
+	parity.resize(parityHeaderSize + xorBuffer.size() + 1);
+	parity[0] = std::byte(PacketFormat::fecParity);
+	parity[1] = std::byte(firstSequence >> 24);
+	parity[2] = std::byte(firstSequence >> 16);
+	parity[3] = std::byte(firstSequence >> 8);
+	parity[4] = std::byte(firstSequence & 0xff);
+	parity[5] = std::byte(numInGroup);
+	parity[6] = std::byte(lengthXor >> 8);
+	parity[7] = std::byte(lengthXor & 0xff);
+	std::copy(xorBuffer.begin(), xorBuffer.end(), parity.begin() + parityHeaderSize);
+	parity.back() = std::byte(crcOf(parity, parity.size() - 1));
+
+	numInGroup = 0;
+	return true;
+}
+
+void FecEncoder::reset()
+{
+	numInGroup = 0;
+}
+
+//==============================================================================
+void FecDecoder::addDataPacket(const std::vector<std::byte>& packet)
+{
+	std::uint32_t sequence = 0;
+
+	if (!PacketFormat::peekSequence(packet.data(), packet.size(), sequence) || isPresent(sequence))
+		return;
+
+	if (!hasNewest)
+	{
+		hasNewest = true;
+		newestSequence = sequence - 1;
+	}
+
+	// loss accounting only looks at packets that move the sequence forward
+	const auto ahead = std::int32_t(sequence - newestSequence);
+
+	if (ahead > 0)
+	{
+		expectedSinceReport += std::uint32_t(ahead);
+		newestSequence = sequence;
+	}
+
+	receivedSinceReport++;
+
+	auto& slot = slotFor(sequence);
+	slot.valid = true;
+	slot.sequence = sequence;
+	slot.packet = packet;
+
+	for (auto& parity : pending)
+		if (parity.active)
+			tryRecover(parity);
+}
+
+bool FecDecoder::addParityPacket(const std::vector<std::byte>& packet)
+{
+	if (packet.size() < parityHeaderSize + 1 || std::uint8_t(packet[0]) != PacketFormat::fecParity)
+		return false;
+
+	if (crcOf(packet, packet.size() - 1) != std::uint8_t(packet.back()))
+		return false;
+
+	auto& parity = pending[nextPending];
+	nextPending = (nextPending + 1) % pending.size();
+
+	parity.active = true;
+	parity.firstSequence = readSequence(packet);
+	parity.groupSize = std::uint8_t(packet[5]);
+	parity.lengthXor = std::uint16_t(std::uint8_t(packet[6]) << 8 | std::uint8_t(packet[7]));
+	parity.data.assign(packet.begin() + parityHeaderSize, packet.end() - 1);
+
+	if (parity.groupSize == 0 || parity.groupSize > FecEncoder::maxGroupSize)
+	{
+		parity.active = false;
+		return false;
+	}
+
+	tryRecover(parity);
+	return true;
+}
+
+bool FecDecoder::tryRecover(PendingParity& parity)
+{
+	int numMissing = 0;
+	std::uint32_t missing = 0;
+
+	for (int i = 0; i < parity.groupSize; i++)
+	{
+		const auto sequence = parity.firstSequence + std::uint32_t(i);
+
+		if (!isPresent(sequence))
+		{
+			missing = sequence;
+			numMissing++;
+		}
+	}
+
+	// nothing to do, or more than XOR can give back
+	if (numMissing == 0)
+		parity.active = false;
+
+	if (numMissing != 1)
+		return false;
+
+	auto packet = parity.data;
+	auto length = parity.lengthXor;
+
+	for (int i = 0; i < parity.groupSize; i++)
+	{
+		const auto sequence = parity.firstSequence + std::uint32_t(i);
+
+		if (sequence == missing)
+			continue;
+
+		const auto& received = slotFor(sequence).packet;
+		xorInto(packet, received.data(), received.size());
+		length ^= std::uint16_t(received.size());
+	}
+
+	parity.active = false;
+
+	if (length < PacketFormat::headerSize || length > packet.size())
+		return false;
+
+	packet.resize(length);
+
+	if (readSequence(packet) != missing)
+		return false;
+
+	auto& slot = slotFor(missing);
+	slot.valid = true;
+	slot.sequence = missing;
+	slot.packet = packet;
+	recovered.push_back(std::move(packet));
+	return true;
+}
+
+bool FecDecoder::popRecovered(std::vector<std::byte>& packet)
+{
+	if (recovered.empty())
+		return false;
+
+	packet = std::move(recovered.front());
+	recovered.erase(recovered.begin());
+	return true;
+}
+
+bool FecDecoder::isPresent(std::uint32_t sequence) const
+{
+	// a slot that was overwritten by a newer sequence no longer counts
+	const auto& slot = recent[sequence % recent.size()];
+	return slot.valid && slot.sequence == sequence;
+}
+
+double FecDecoder::takeLossRate()
+{
+	const auto expected = expectedSinceReport;
+	const auto received = std::min(receivedSinceReport, expected);
+	expectedSinceReport = 0;
+	receivedSinceReport = 0;
+
+	return expected == 0 ? 0.0 : double(expected - received) / double(expected);
+}
+
+void FecDecoder::reset()
+{
+	for (auto& slot : recent)
+		slot.valid = false;
+
+	recovered.clear();
+	hasNewest = false;
+	expectedSinceReport = 0;
+	receivedSinceReport = 0;
+
+	for (auto& parity : pending)
+		parity.active = false;
+}
+
+//==============================================================================
+void LossReport::write(double lossRate, std::uint8_t* out)
+{
+	const auto scaled = std::uint16_t(std::clamp(lossRate, 0.0, 1.0) * 10000.0);
+	out[0] = PacketFormat::lossReport;
+	out[1] = std::uint8_t(scaled >> 8);
+	out[2] = std::uint8_t(scaled & 0xff);
+	out[3] = PacketFormat::checksum(out, 3);
+}
+
+bool LossReport::read(const std::uint8_t* bytes, std::size_t numBytes, double& lossRate)
+{
+	if (numBytes != size || bytes[0] != PacketFormat::lossReport || PacketFormat::checksum(bytes, 3) != bytes[3])
+		return false;
+
+	lossRate = double(bytes[1] << 8 | bytes[2]) / 10000.0;
+	return true;
+}
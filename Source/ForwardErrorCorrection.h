@@ -0,0 +1,118 @@
+/*
+  ==============================================================================
+
+    XOR parity forward error correction for MIDI batches.
+
+    The sender groups every k consecutive batches and follows them with one
+    parity packet, the byte-wise XOR of the k packets (zero padded to the
+    longest) and of their lengths:
+
+        [type][first sequence, 32 bit][k][length xor, 16 bit][xor of the packets...][crc8]
+
+    If exactly one batch of a group is lost, the receiver XORs the parity
+    with the batches it did get and has the missing one back, without a
+    round trip. k = 1 degenerates to sending every batch twice.
+
+    k follows the loss the receiver reports back in a small lossReport
+    message, or can be fixed. Sequence numbers are the 32-bit batch sequence.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class FecEncoder
+{
+public:
+    static constexpr int maxGroupSize = 16;
+
+    //0 = adapt to the reported loss, otherwise a fixed k
+    void setGroupSize(int newGroupSize);
+    int getGroupSize() const { return groupSize; }
+
+    //fraction of packets the peer reported lost, picks k in adaptive mode
+    void setMeasuredLoss(double lossRate);
+
+    //k for a given loss rate, 0 means no parity at all
+    static int groupSizeForLoss(double lossRate);
+
+    //feed every data packet after it was sent; returns true when a parity packet is ready in parity
+    bool add(const std::vector<std::byte>& packet, std::vector<std::byte>& parity);
+
+    //drops the group in progress
+    void reset();
+
+private:
+    int fixedGroupSize = 0;
+    int groupSize = 4;
+    int numInGroup = 0;
+    std::uint32_t firstSequence = 0;
+    std::uint16_t lengthXor = 0;
+    std::vector<std::byte> xorBuffer;
+};
+
+class FecDecoder
+{
+public:
+    //feed every received data packet (valid or not yet checked), its sequence is at bytes 1 to 4
+    void addDataPacket(const std::vector<std::byte>& packet);
+
+    //feed a received parity packet, false if it is malformed
+    bool addParityPacket(const std::vector<std::byte>& packet);
+
+    //true while recovered packets are waiting, each one is a complete data packet
+    bool popRecovered(std::vector<std::byte>& packet);
+
+    //share of data packets missing since the last call, then starts a new measurement
+    double takeLossRate();
+
+    void reset();
+
+private:
+    struct PendingParity
+    {
+        bool active = false;
+        std::uint32_t firstSequence = 0;
+        int groupSize = 0;
+        std::uint16_t lengthXor = 0;
+        std::vector<std::byte> data;
+    };
+
+    struct Slot
+    {
+        bool valid = false;
+        std::uint32_t sequence = 0;
+        std::vector<std::byte> packet;
+    };
+
+    bool tryRecover(PendingParity& parity);
+    bool isPresent(std::uint32_t sequence) const;
+    Slot& slotFor(std::uint32_t sequence) { return recent[sequence % recent.size()]; }
+
+    //last data packets, indexed by the low bits of their sequence
+    std::array<Slot, 256> recent;
+
+    std::array<PendingParity, 8> pending;
+    std::size_t nextPending = 0;
+
+    std::vector<std::vector<std::byte>> recovered;
+
+    bool hasNewest = false;
+    std::uint32_t newestSequence = 0;
+    std::uint32_t expectedSinceReport = 0;
+    std::uint32_t receivedSinceReport = 0;
+};
+
+namespace LossReport
+{
+    constexpr std::size_t size = 1 + 2 + 1;
+
+    //[lossReport][loss in 1/10000, 16 bit][crc8]
+    void write(double lossRate, std::uint8_t* out);
+    bool read(const std::uint8_t* bytes, std::size_t numBytes, double& lossRate);
+}
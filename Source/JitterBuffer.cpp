@@ -0,0 +1,182 @@
+/*
+  ==============================================================================
+
+    Receive-side playout buffer for remote MIDI events.
+
+  ==============================================================================
+*/
+
+#include "JitterBuffer.h"
+
+#include <cmath>
+#include <limits>
+
+namespace
+{
+	//length of one minimum-transit window
+	constexpr double transitWindowSeconds = 2.0;
+
+	//time constant of the jitter peak decay
+	constexpr double peakDecaySeconds = 4.0;
+}
+
+void JitterBuffer::prepare(double newSampleRate)
+{
+	sampleRate = newSampleRate > 0.0 ? newSampleRate : 44100.0;
+	numEntries = 0;
+	sources.fill(Source());
+	worstJitterSource = 0;
+	jitterPeak = 0.0;
+	currentDelay = getTargetDelay();
+	reportedDelay.store(int(currentDelay) + currentBlockSize, std::memory_order_relaxed);
+}
+
+void JitterBuffer::setSettings(const Settings& newSettings)
+{
+	settings = newSettings;
+	settings.minDelayMs = std::max(0.0, settings.minDelayMs);
+	settings.maxDelayMs = std::max(settings.minDelayMs, settings.maxDelayMs);
+}
+
+void JitterBuffer::resetSource(std::uint8_t source) noexcept
+{
+	sources[source] = Source();
+}
+
+double JitterBuffer::unwrapRemoteTime(Source& source, std::uint32_t remoteTime) noexcept
+{
+	if (!source.hasRemoteTime)
+	{
+		source.lastRemoteTime = remoteTime;
+		source.hasRemoteTime = true;
+	}
+	else
+	{
+		source.lastRemoteTime += std::int32_t(remoteTime - std::uint32_t(source.lastRemoteTime));
+	}
+
+	return double(source.lastRemoteTime);
+}
+
+void JitterBuffer::push(const ReceivedMidiEvent& event, double arrivalSample)
+{
+	auto& source = sources[event.source];
+	const double ratio = event.remoteSampleRate > 0 ? sampleRate / double(event.remoteSampleRate) : 1.0;
+	schedule(source, event, arrivalSample, unwrapRemoteTime(source, event.remoteTime) * ratio, false);
+}
+
+void JitterBuffer::pushSynced(const ReceivedMidiEvent& event, double arrivalSample, double sendSample)
+{
+	auto& source = sources[event.source];
+	unwrapRemoteTime(source, event.remoteTime);
+	schedule(source, event, arrivalSample, sendSample, true);
+}
+
+void JitterBuffer::schedule(Source& source, const ReceivedMidiEvent& event, double arrivalSample, double remoteSample, bool isSynced)
+{
+	const double transit = arrivalSample - remoteSample;
+
+	// the two mappings put the remote clock in different places, so transit history doesn't carry over
+	if (source.hasTransit && isSynced != source.transitIsSynced)
+		source.hasTransit = false;
+
+	source.transitIsSynced = isSynced;
+
+	if (!source.hasTransit || arrivalSample - source.windowStart >= transitWindowSeconds * sampleRate)
+	{
+		source.windowMin[0] = source.hasTransit ? source.windowMin[1] : transit;
+		source.windowMin[1] = std::numeric_limits<double>::max();
+		source.windowStart = arrivalSample;
+
+		if (!source.hasTransit)
+			source.previousTransit = transit;
+
+		source.hasTransit = true;
+	}
+
+	source.windowMin[1] = std::min(source.windowMin[1], transit);
+	const double baseTransit = std::min(source.windowMin[0], source.windowMin[1]);
+
+	// delay variation on top of the fastest recent packet
+	const double variation = transit - baseTransit;
+	jitterPeak = std::max(jitterPeak, variation);
+	source.jitter += (std::abs(transit - source.previousTransit) - source.jitter) / 16.0;
+	source.previousTransit = transit;
+
+	// the stat follows the source with the most jitter, it changes hands when another one overtakes it
+	const auto index = std::size_t(&source - sources.data());
+
+	if (index == worstJitterSource || source.jitter > sources[worstJitterSource].jitter)
+		worstJitterSource = index;
+
+	reportedJitter.store(sources[worstJitterSource].jitter * 1000.0 / sampleRate, std::memory_order_relaxed);
+
+	if (numEntries == capacity)
+	{
+		droppedEvents.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+
+	auto playoutSample = remoteSample + baseTransit + double(currentBlockSize) + currentDelay;
+
+	if (playoutSample < double(currentBlockStart))
+	{
+		lateEvents.fetch_add(1, std::memory_order_relaxed);
+
+		if (numEntries == 0)
+			underruns.fetch_add(1, std::memory_order_relaxed);
+
+		playoutSample = double(currentBlockStart);
+	}
+
+	entries[numEntries++] = { event, playoutSample, nextOrder++ };
+	std::push_heap(entries.begin(), entries.begin() + numEntries, isLater);
+}
+
+double JitterBuffer::getTargetDelay() const noexcept
+{
+	if (settings.mode == Mode::fixed)
+		return toSamples(settings.fixedDelayMs);
+
+	return std::clamp(jitterPeak + toSamples(settings.marginMs),
+		toSamples(settings.minDelayMs), toSamples(settings.maxDelayMs));
+}
+
+void JitterBuffer::beginBlock(std::int64_t blockStart, int numSamples) noexcept
+{
+	currentBlockStart = blockStart;
+	currentBlockSize = std::max(1, numSamples);
+
+	jitterPeak *= std::exp(-double(numSamples) / (peakDecaySeconds * sampleRate));
+
+	const double target = getTargetDelay();
+
+	// jump while nothing is scheduled, otherwise glide so queued events don't bunch up or stretch
+	if (numEntries == 0)
+	{
+		currentDelay = target;
+	}
+	else
+	{
+		const double maxStep = double(numSamples) / 16.0;
+		currentDelay += std::clamp(target - currentDelay, -maxStep, maxStep);
+	}
+
+	reportedDelay.store(int(std::lround(currentDelay)) + currentBlockSize, std::memory_order_relaxed);
+}
+
+double JitterBuffer::getDelayMs() const noexcept
+{
+	return double(getDelaySamples()) * 1000.0 / sampleRate;
+}
+
+JitterBuffer::Stats JitterBuffer::getStats() const noexcept
+{
+	Stats stats;
+	stats.eventsPlayed = eventsPlayed.load(std::memory_order_relaxed);
+	stats.lateEvents = lateEvents.load(std::memory_order_relaxed);
+	stats.underruns = underruns.load(std::memory_order_relaxed);
+	stats.droppedEvents = droppedEvents.load(std::memory_order_relaxed);
+	stats.jitterMs = reportedJitter.load(std::memory_order_relaxed);
+	return stats;
+}
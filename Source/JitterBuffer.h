@@ -0,0 +1,163 @@
+/*
+  ==============================================================================
+
+    Receive-side playout buffer for remote MIDI events.
+
+    Every event carries the sender's sample time. Once ClockSync has an
+    estimate that time is mapped onto the local clock directly, before that
+    the sender's sample clock is only rescaled to the local rate; either way
+    the playout time is
+
+        playout = remote time + base transit + block size + delay
+
+    where the base transit is the smallest transit time seen recently (the
+    part of the network delay every packet pays), the block size covers the
+    wait until the next audio callback picks an arrival up, and the delay is
+    the extra headroom that absorbs jitter. In adaptive mode the delay follows a
+    decaying peak of the observed delay variation, bounded by a minimum and
+    a maximum; in fixed mode it stays where it was set.
+
+    Every sender (ReceivedMidiEvent::source) has its own clock, so the
+    remote time unwrapping, the base transit and the jitter estimate are
+    kept per source; the delay follows the worst of them.
+
+    Audio thread only, apart from getDelaySamples()/getStats() which may be
+    read from anywhere. Storage is a fixed-size heap, nothing allocates after
+    prepare().
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include "MidiEventQueue.h"
+
+class JitterBuffer
+{
+public:
+    enum class Mode
+    {
+        adaptive,
+        fixed
+    };
+
+    struct Settings
+    {
+        Mode mode = Mode::adaptive;
+        double minDelayMs = 2.0;
+        double maxDelayMs = 80.0;
+        double fixedDelayMs = 20.0;
+        double marginMs = 1.0;          //added on top of the jitter peak in adaptive mode
+    };
+
+    struct Stats
+    {
+        std::uint64_t eventsPlayed = 0;
+        std::uint64_t lateEvents = 0;   //arrived after their playout time, played at once
+        std::uint64_t underruns = 0;    //late events that found the buffer empty
+        std::uint64_t droppedEvents = 0;
+        double jitterMs = 0.0;          //RFC 3550 style smoothed delay variation, of the worst source
+    };
+
+    static constexpr std::size_t capacity = 1024;
+    static constexpr std::size_t maxSources = 256;      //every value of ReceivedMidiEvent::source
+
+    //a new sender took over the source, its timing starts from scratch; audio thread
+    void resetSource(std::uint8_t source) noexcept;
+
+    //resets all timing state, not while the audio thread is running
+    void prepare(double newSampleRate);
+
+    //cheap enough to be called every block
+    void setSettings(const Settings& newSettings);
+
+    //once per audio block, before the block's arrivals are pushed
+    void beginBlock(std::int64_t blockStart, int numSamples) noexcept;
+
+    //arrivalSample is the arrival time converted to the local sample clock
+    void push(const ReceivedMidiEvent& event, double arrivalSample);
+
+    //same, with the remote send time already mapped onto the local sample clock by ClockSync
+    void pushSynced(const ReceivedMidiEvent& event, double arrivalSample, double sendSample);
+
+    //calls callback(const ReceivedMidiEvent&, int position) for everything due in the current block
+    template <typename Callback>
+    void popDueEvents(Callback&& callback)
+    {
+        const auto blockEnd = double(currentBlockStart + currentBlockSize);
+
+        while (numEntries > 0 && entries[0].playoutSample < blockEnd)
+        {
+            std::pop_heap(entries.begin(), entries.begin() + numEntries, isLater);
+            const auto& entry = entries[--numEntries];
+
+            const auto position = std::clamp(int(entry.playoutSample - double(currentBlockStart)), 0, currentBlockSize - 1);
+            callback(entry.event, position);
+            eventsPlayed.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    //total playout latency on top of the base transit, block size included
+    int getDelaySamples() const noexcept { return reportedDelay.load(std::memory_order_relaxed); }
+    double getDelayMs() const noexcept;
+    Stats getStats() const noexcept;
+
+private:
+    struct Entry
+    {
+        ReceivedMidiEvent event;
+        double playoutSample = 0.0;
+        std::uint64_t order = 0;    //arrival order, breaks ties so a retrigger's note-off stays ahead of its note-on
+    };
+
+    static bool isLater(const Entry& a, const Entry& b) noexcept
+    {
+        return a.playoutSample > b.playoutSample || (a.playoutSample == b.playoutSample && a.order > b.order);
+    }
+
+    //timing of one sender, the clocks of different senders have nothing to do with each other
+    struct Source
+    {
+        bool hasRemoteTime = false;
+        std::int64_t lastRemoteTime = 0;
+
+        //minimum transit over two alternating windows, so that drift can pull it back up
+        double windowMin[2] = {};
+        double windowStart = 0.0;
+        bool hasTransit = false;
+        bool transitIsSynced = false;
+
+        double previousTransit = 0.0;
+        double jitter = 0.0;
+    };
+
+    double toSamples(double ms) const noexcept { return ms * sampleRate / 1000.0; }
+    static double unwrapRemoteTime(Source& source, std::uint32_t remoteTime) noexcept;
+    double getTargetDelay() const noexcept;
+    void schedule(Source& source, const ReceivedMidiEvent& event, double arrivalSample, double remoteSample, bool isSynced);
+
+    std::array<Entry, capacity> entries{};
+    std::size_t numEntries = 0;
+    std::uint64_t nextOrder = 0;
+
+    Settings settings;
+    double sampleRate = 44100.0;
+    std::int64_t currentBlockStart = 0;
+    int currentBlockSize = 1;
+
+    std::array<Source, maxSources> sources{};
+    std::size_t worstJitterSource = 0;
+
+    double jitterPeak = 0.0;
+    double currentDelay = 0.0;
+
+    std::atomic<int> reportedDelay{ 0 };
+    std::atomic<double> reportedJitter{ 0.0 };
+    std::atomic<std::uint64_t> eventsPlayed{ 0 }, lateEvents{ 0 }, underruns{ 0 }, droppedEvents{ 0 };
+};
@@ -0,0 +1,146 @@
+/*
+  ==============================================================================
+
+    Wire codec for single MIDI messages.
+
+    Everything about a message is looked up once from its status byte in a
+    table built at compile time: how many bytes it has and what kind of
+    message it is. Encoding and decoding are then a single pass over at most
+    three bytes. Covered are all channel-voice messages (all 16 channels),
+    system common and system realtime messages; SysEx (0xF0/0xF7) and the
+    undefined status bytes have length 0 and are rejected.
+
+    Valid messages round-trip unchanged: encode() copies the status byte and
+    masks the data bytes to 7 bits, decode() refuses anything that isn't a
+    well formed message.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace MidiCodec
+{
+    enum class Kind : std::uint8_t
+    {
+        invalid = 0,
+        noteOff,
+        noteOn,
+        polyPressure,
+        controller,
+        programChange,
+        channelPressure,
+        pitchBend,
+        systemCommon,
+        systemRealtime
+    };
+
+    struct StatusInfo
+    {
+        std::uint8_t length = 0;    //total bytes including the status byte, 0 = not carried
+        Kind kind = Kind::invalid;
+    };
+
+    constexpr std::size_t maxMessageLength = 3;
+
+    constexpr StatusInfo makeStatusInfo(unsigned status)
+    {
+        if (status < 0x80)
+            return {};
+
+        switch (status & 0xf0)
+        {
+            case 0x80: return { 3, Kind::noteOff };
+            case 0x90: return { 3, Kind::noteOn };
+            case 0xa0: return { 3, Kind::polyPressure };
+            case 0xb0: return { 3, Kind::controller };
+            case 0xc0: return { 2, Kind::programChange };
+            case 0xd0: return { 2, Kind::channelPressure };
+            case 0xe0: return { 3, Kind::pitchBend };
+            default: break;
+        }
+
+        switch (status)
+        {
+            case 0xf1: return { 2, Kind::systemCommon };    //MTC quarter frame
+            case 0xf2: return { 3, Kind::systemCommon };    //song position
+            case 0xf3: return { 2, Kind::systemCommon };    //song select
+            case 0xf6: return { 1, Kind::systemCommon };    //tune request
+            case 0xf8: case 0xfa: case 0xfb: case 0xfc: case 0xfe: case 0xff:
+                return { 1, Kind::systemRealtime };
+            default: return {};                             //SysEx and undefined
+        }
+    }
+
+    constexpr std::array<StatusInfo, 256> makeStatusTable()
+    {
+        std::array<StatusInfo, 256> table{};
+
+        for (unsigned status = 0; status < 256; status++)
+            table[status] = makeStatusInfo(status);
+
+        return table;
+    }
+
+    inline constexpr std::array<StatusInfo, 256> statusTable = makeStatusTable();
+
+    static_assert(statusTable[0x93].length == 3 && statusTable[0xc5].length == 2
+        && statusTable[0xf8].length == 1 && statusTable[0xf0].length == 0,
+        "unexpected MIDI status table");
+
+    constexpr std::uint8_t getMessageLength(std::uint8_t status) noexcept
+    {
+        return statusTable[status].length;
+    }
+
+    constexpr Kind getKind(std::uint8_t status) noexcept
+    {
+        return statusTable[status].kind;
+    }
+
+    //writes the wire form of message to out (room for maxMessageLength bytes), returns bytes written or 0
+    inline std::size_t encode(const std::uint8_t* message, std::size_t size, std::uint8_t* out) noexcept
+    {
+        if (size == 0)
+            return 0;
+
+        const std::size_t length = statusTable[message[0]].length;
+
+        if (length == 0 || size < length)
+            return 0;
+
+        out[0] = message[0];
+
+        for (std::size_t i = 1; i < length; i++)
+            out[i] = message[i] & 0x7f;
+
+        return length;
+    }
+
+    //reads one message from in, returns bytes consumed or 0 if it isn't a valid message
+    inline std::size_t decode(const std::uint8_t* in, std::size_t available, std::uint8_t* message) noexcept
+    {
+        if (available == 0)
+            return 0;
+
+        const std::size_t length = statusTable[in[0]].length;
+
+        if (length == 0 || available < length)
+            return 0;
+
+        std::uint8_t highBits = 0;
+        message[0] = in[0];
+
+        for (std::size_t i = 1; i < length; i++)
+        {
+            message[i] = in[i];
+            highBits |= in[i];
+        }
+
+        return (highBits & 0x80) == 0 ? length : 0;
+    }
+}
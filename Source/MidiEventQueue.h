@@ -0,0 +1,118 @@
+/*
+  ==============================================================================
+
+    Bounded single-producer/single-consumer queue used to hand MIDI events
+    between the audio thread (processBlock) and the DataChannel side, in
+    both directions.
+
+    push() and pop() are wait-free: each side only ever writes its own index
+    and reads the other one, so the audio thread never blocks and never
+    allocates. When the ring is full the event is rejected and counted in
+    getNumDropped() instead of overwriting older data.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+//fixed-size record of one outbound MIDI message, the sender numbers and encodes it
+struct MidiEventRecord
+{
+    std::uint8_t data[3] = {};
+    std::uint8_t size = 0;
+    std::int64_t timestamp = 0;         //host sample clock: block start + position in block
+};
+
+//one decoded remote event as the network thread hands it to processBlock
+struct ReceivedMidiEvent
+{
+    std::uint8_t data[3] = {};
+    std::uint8_t size = 0;
+    std::uint8_t source = 0;            //session slot of the partner that sent it
+    std::uint32_t remoteTime = 0;       //sender's sample clock, low 32 bits
+    std::uint32_t remoteSampleRate = 0;
+    std::int64_t arrivalTicks = 0;      //local high resolution time its batch arrived at
+};
+
+template <typename T, std::size_t Capacity>
+class SpscQueue
+{
+public:
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0,
+        "SpscQueue capacity must be a power of two");
+
+    //producer side only
+    bool push(const T& item) noexcept
+    {
+        const auto tail = tailIndex.load(std::memory_order_relaxed);
+
+        if (tail - cachedHead == Capacity)
+        {
+            cachedHead = headIndex.load(std::memory_order_acquire);
+
+            if (tail - cachedHead == Capacity)
+            {
+                numDropped.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+        }
+
+        slots[tail & mask] = item;
+        tailIndex.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    //consumer side only
+    bool pop(T& item) noexcept
+    {
+        const auto head = headIndex.load(std::memory_order_relaxed);
+
+        if (head == cachedTail)
+        {
+            cachedTail = tailIndex.load(std::memory_order_acquire);
+
+            if (head == cachedTail)
+                return false;
+        }
+
+        item = slots[head & mask];
+        headIndex.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    //approximate when called from a third thread, exact from either side
+    std::size_t getNumReady() const noexcept
+    {
+        return static_cast<std::size_t>(tailIndex.load(std::memory_order_acquire)
+            - headIndex.load(std::memory_order_acquire));
+    }
+
+    bool isEmpty() const noexcept { return getNumReady() == 0; }
+
+    static constexpr std::size_t getCapacity() noexcept { return Capacity; }
+
+    //events rejected by push() because the ring was full
+    std::uint64_t getNumDropped() const noexcept
+    {
+        return numDropped.load(std::memory_order_relaxed);
+    }
+
+private:
+    static constexpr std::size_t mask = Capacity - 1;
+
+    //producer and consumer indices live on separate cache lines
+    alignas(64) std::atomic<std::size_t> tailIndex{ 0 };
+    std::size_t cachedHead = 0;
+
+    alignas(64) std::atomic<std::size_t> headIndex{ 0 };
+    std::size_t cachedTail = 0;
+
+    alignas(64) std::atomic<std::uint64_t> numDropped{ 0 };
+
+    std::array<T, Capacity> slots{};
+};
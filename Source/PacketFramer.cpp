@@ -0,0 +1,173 @@
+/*
+  ==============================================================================
+
+    Framing of several MIDI messages into one DataChannel packet.
+
+  ==============================================================================
+*/
+
+#include "PacketFramer.h"
+
+#include <algorithm>
+
+namespace
+{
+	std::uint32_t readBigEndian(const std::uint8_t* bytes, int numBytes)
+	{
+		std::uint32_t value = 0;
+
+		for (int i = 0; i < numBytes; i++)
+			value = value << 8 | bytes[i];
+
+		return value;
+	}
+
+	void writeBigEndian(std::uint8_t* bytes, std::uint32_t value, int numBytes)
+	{
+		for (int i = numBytes - 1; i >= 0; i--, value >>= 8)
+			bytes[i] = std::uint8_t(value);
+	}
+}
+
+bool PacketFormat::readBatch(const std::byte* data, std::size_t size, BatchView& view)
+{
+	if (size < headerSize + trailerSize)
+		return false;
+
+	const auto* bytes = reinterpret_cast<const std::uint8_t*>(data);
+	const auto crcIndex = size - trailerSize;
+
+	if (bytes[0] != midiBatch)
+		return false;
+
+	if (PacketFormat::checksum(bytes, crcIndex) != bytes[crcIndex])
+		return false;
+
+	view.sequence = readBigEndian(bytes + 1, 4);
+	view.numEvents = bytes[5];
+	view.sampleRate = readBigEndian(bytes + 6, 3);
+	view.baseTime = readBigEndian(bytes + 9, 4);
+	view.payload = bytes + headerSize;
+
+	// the events end where the status bytes say, the rest is journal
+	const auto available = crcIndex - headerSize;
+	std::size_t eventsSize = 0;
+
+	for (std::size_t i = 0; i < view.numEvents; i++)
+	{
+		if (eventsSize + timeOffsetSize >= available)
+			return false;
+
+		const auto length = MidiCodec::getMessageLength(view.payload[eventsSize + timeOffsetSize]);
+
+		if (length == 0)
+			return false;
+
+		eventsSize += timeOffsetSize + length;
+	}
+
+	if (eventsSize > available)
+		return false;
+
+	view.payloadSize = eventsSize;
+	view.journal = view.payload + eventsSize;
+	view.journalSize = available - eventsSize;
+	return true;
+}
+
+//==============================================================================
+PacketBatcher::PacketBatcher(std::size_t maxPacketSize, Clock::duration flushDeadline)
+	: maxPacketSize(0), flushDeadline(flushDeadline)
+{
+	setMaxPacketSize(maxPacketSize);
+	clear();
+}
+
+void PacketBatcher::setMaxPacketSize(std::size_t newMaxPacketSize)
+{
+	maxPacketSize = std::max(newMaxPacketSize, PacketFormat::headerSize + PacketFormat::timeOffsetSize
+		+ MidiCodec::maxMessageLength + journalCapacity + PacketFormat::trailerSize);
+	packet.reserve(maxPacketSize);
+}
+
+void PacketBatcher::setJournalCapacity(std::size_t newJournalCapacity)
+{
+	journalCapacity = newJournalCapacity;
+	setMaxPacketSize(maxPacketSize);
+}
+
+bool PacketBatcher::add(const MidiEventRecord& event, Clock::time_point now)
+{
+	if (finished)
+		clear();
+
+	// the event count is a single byte
+	if (numEvents == 255)
+		return false;
+
+	const auto length = MidiCodec::getMessageLength(event.data[0]);
+
+	if (packet.size() + PacketFormat::timeOffsetSize + length + journalCapacity + PacketFormat::trailerSize > maxPacketSize)
+		return false;
+
+	const auto timeOffset = numEvents == 0 ? 0 : event.timestamp - baseTime;
+
+	if (timeOffset < 0 || timeOffset > PacketFormat::maxTimeOffset)
+		return false;
+
+	std::uint8_t encoded[MidiCodec::maxMessageLength];
+
+	if (MidiCodec::encode(event.data, event.size, encoded) == 0)
+		return false;
+
+	if (numEvents == 0)
+	{
+		firstEventTime = now;
+		baseTime = event.timestamp;
+	}
+
+	packet.push_back(std::byte(timeOffset >> 8));
+	packet.push_back(std::byte(timeOffset & 0xff));
+
+	for (std::size_t i = 0; i < length; i++)
+		packet.push_back(std::byte(encoded[i]));
+
+	numEvents++;
+	return true;
+}
+
+bool PacketBatcher::isDue(Clock::time_point now) const
+{
+	return numEvents > 0 && now - firstEventTime >= flushDeadline;
+}
+
+const std::vector<std::byte>& PacketBatcher::finish(std::uint32_t sequence, std::uint32_t sampleRate,
+	const std::uint8_t* journal, std::size_t journalSize)
+{
+	if (!finished)
+	{
+		if (journal != nullptr && journalSize <= journalCapacity)
+			for (std::size_t i = 0; i < journalSize; i++)
+				packet.push_back(std::byte(journal[i]));
+
+		auto* bytes = reinterpret_cast<std::uint8_t*>(packet.data());
+		writeBigEndian(bytes + 1, sequence, 4);
+		bytes[5] = std::uint8_t(numEvents);
+		writeBigEndian(bytes + 6, sampleRate, 3);
+		writeBigEndian(bytes + 9, std::uint32_t(baseTime), 4);
+
+		const auto crc = PacketFormat::checksum(bytes, packet.size());
+		packet.push_back(std::byte(crc));
+		finished = true;
+	}
+
+	return packet;
+}
+
+void PacketBatcher::clear()
+{
+	packet.assign(PacketFormat::headerSize, std::byte(0));
+	packet[0] = std::byte(PacketFormat::midiBatch);
+	numEvents = 0;
+	finished = false;
+}
@@ -0,0 +1,171 @@
+/*
+  ==============================================================================
+
+    Framing of several MIDI messages into one DataChannel packet.
+
+    A batch goes on the wire as
+
+        [type][sequence, 32 bit][event count][sample rate, 24 bit][base time, 32 bit]
+        [offset, 16 bit][encoded message] ... [recovery journal][crc8]
+
+    Times are in samples of the sender's host clock: the base time is the
+    timestamp of the first event (low 32 bits), every event carries its
+    distance from it, so the receiver can rebuild the original spacing.
+    Messages are written by MidiCodec, their lengths follow from the status
+    byte so no per-event length is needed. Multi-byte fields are big endian.
+    The crc covers every byte before it. Whatever follows the last event is
+    the optional recovery journal, see RecoveryJournal.
+
+    PacketBatcher collects events on the sender side until the packet is
+    full or its flush deadline has passed; readBatch()/forEachMessage() take
+    a received packet apart again.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "CRC.h"
+#include "MidiCodec.h"
+#include "MidiEventQueue.h"
+
+namespace PacketFormat
+{
+    //first byte of every DataChannel message
+    enum PacketType : std::uint8_t
+    {
+        midiBatch = 0x01,
+        clockPing = 0x02,   //see ClockSync
+        clockPong = 0x03,
+        fecParity = 0x04,   //see ForwardErrorCorrection
+        lossReport = 0x05,
+        journalAck = 0x06,  //see RecoveryJournal
+        nack = 0x07,        //see Retransmission
+        streamBundle = 0x08, //see StreamBundle, shared transport only
+        relayBundle = 0x09  //StreamBundle framing, ids are the relay's participant ids
+    };
+
+    //CRC-8 (SMBus) lookup table, built by the compiler
+    inline constexpr CRC::Table<std::uint8_t, 8> crcTable{ CRC::Parameters<std::uint8_t, 8>{ 0x07, 0x00, 0x00, false, false } };
+
+    //crc8 trailer of every packet type, one table lookup per byte
+    inline std::uint8_t checksum(const void* data, std::size_t size)
+    {
+        return CRC::Calculate(data, size, crcTable);
+    }
+
+    constexpr std::size_t headerSize = 13;
+    constexpr std::size_t timeOffsetSize = 2;
+    constexpr std::size_t trailerSize = 1;
+    constexpr std::uint32_t maxTimeOffset = 0xffff;
+
+    //a received batch after its header and crc have been checked
+    struct BatchView
+    {
+        std::uint32_t sequence = 0;
+        std::size_t numEvents = 0;
+        std::uint32_t sampleRate = 0;
+        std::uint32_t baseTime = 0;
+        const std::uint8_t* payload = nullptr;     //the events
+        std::size_t payloadSize = 0;
+        const std::uint8_t* journal = nullptr;
+        std::size_t journalSize = 0;                //0 if the batch has no journal
+    };
+
+    bool readBatch(const std::byte* data, std::size_t size, BatchView& view);
+
+    //sequence number of a batch without checking anything else
+    inline bool peekSequence(const std::byte* data, std::size_t size, std::uint32_t& sequence)
+    {
+        if (size < headerSize)
+            return false;
+
+        sequence = std::uint32_t(data[1]) << 24 | std::uint32_t(data[2]) << 16
+            | std::uint32_t(data[3]) << 8 | std::uint32_t(data[4]);
+        return true;
+    }
+
+    //calls callback(const std::uint8_t* message, std::size_t length, std::uint32_t sampleTime) per event,
+    //false if the payload is malformed
+    template <typename Callback>
+    bool forEachMessage(const BatchView& view, Callback&& callback)
+    {
+        std::size_t offset = 0;
+        std::size_t numEvents = 0;
+        std::uint8_t message[MidiCodec::maxMessageLength];
+
+        while (offset + timeOffsetSize < view.payloadSize)
+        {
+            const auto timeOffset = std::uint32_t(view.payload[offset] << 8 | view.payload[offset + 1]);
+            offset += timeOffsetSize;
+
+            const auto length = MidiCodec::decode(view.payload + offset, view.payloadSize - offset, message);
+
+            if (length == 0)
+                return false;
+
+            callback(static_cast<const std::uint8_t*>(message), length, view.baseTime + timeOffset);
+            offset += length;
+            numEvents++;
+        }
+
+        return offset == view.payloadSize && numEvents == view.numEvents;
+    }
+}
+
+class PacketBatcher
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    static constexpr std::size_t defaultMaxPacketSize = 1024;
+    static constexpr Clock::duration defaultFlushDeadline = std::chrono::milliseconds(2);
+
+    explicit PacketBatcher(std::size_t maxPacketSize = defaultMaxPacketSize,
+        Clock::duration flushDeadline = defaultFlushDeadline);
+
+    //clamped so that at least one event always fits
+    void setMaxPacketSize(std::size_t newMaxPacketSize);
+    std::size_t getMaxPacketSize() const { return maxPacketSize; }
+
+    //room kept free in every batch for the journal passed to finish()
+    void setJournalCapacity(std::size_t newJournalCapacity);
+
+    void setFlushDeadline(Clock::duration newFlushDeadline) { flushDeadline = newFlushDeadline; }
+    Clock::duration getFlushDeadline() const { return flushDeadline; }
+
+    //false if the event doesn't fit any more (finish the batch first) or can't be encoded;
+    //events too far in time from the first one in the batch don't fit either
+    bool add(const MidiEventRecord& event, Clock::time_point now);
+
+    bool isEmpty() const { return numEvents == 0; }
+    std::size_t getNumEvents() const { return numEvents; }
+
+    //true once the oldest event in the batch has waited for flushDeadline
+    bool isDue(Clock::time_point now) const;
+
+    //when isDue() turns true, only meaningful while the batch is not empty
+    Clock::time_point getDueTime() const { return firstEventTime + flushDeadline; }
+
+    //closes the batch under the given sequence number, the packet stays valid until the next add()/clear();
+    //a journal longer than the journal capacity is left out
+    const std::vector<std::byte>& finish(std::uint32_t sequence, std::uint32_t sampleRate,
+        const std::uint8_t* journal = nullptr, std::size_t journalSize = 0);
+
+    void clear();
+
+private:
+    std::vector<std::byte> packet;
+    std::size_t maxPacketSize;
+    std::size_t journalCapacity = 0;
+    Clock::duration flushDeadline;
+    std::size_t numEvents = 0;
+    Clock::time_point firstEventTime;
+    std::int64_t baseTime = 0;
+    bool finished = false;
+};
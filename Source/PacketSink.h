@@ -0,0 +1,114 @@
+/*
+  ==============================================================================
+
+    Where a processor's packets go: a DataChannel of its own, all channels
+    of a session at once, or its stream on the shared transport (see
+    TransportHub).
+
+    The sender, the NACK and pong replies and the control messages only
+    talk to a PacketSink, so the same batching, FEC, journal and
+    retransmission code runs in both cases.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <rtc/rtc.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <exception>
+#include <memory>
+#include <vector>
+
+class PacketSink
+{
+public:
+    virtual ~PacketSink() = default;
+
+    virtual bool isOpen() const = 0;
+
+    //the sender holds back while more than this is buffered; it is also the channels'
+    //bufferedAmountLowThreshold, so onBufferedAmountLow says when to carry on. A few hundred
+    //batches, far more than a session produces between two sends
+    static constexpr std::size_t maxBufferedAmount = 16 * 1024;
+
+    //bytes handed over but not on the wire yet, the sender holds back above maxBufferedAmount
+    virtual std::size_t getBufferedAmount() const = 0;
+
+    //may throw like DataChannel::send
+    virtual void send(const rtc::binary& packet) = 0;
+};
+
+//==============================================================================
+class DataChannelSink : public PacketSink
+{
+public:
+    explicit DataChannelSink(std::shared_ptr<rtc::DataChannel> channelToUse)
+        : channel(std::move(channelToUse))
+    {
+    }
+
+    bool isOpen() const override { return channel != nullptr && channel->isOpen(); }
+    std::size_t getBufferedAmount() const override { return channel->bufferedAmount(); }
+    void send(const rtc::binary& packet) override { channel->send(packet); }
+
+private:
+    std::shared_ptr<rtc::DataChannel> channel;
+};
+
+//==============================================================================
+//every partner of a session: the packet is encoded once and the same bytes go to each channel
+class FanOutSink : public PacketSink
+{
+public:
+    explicit FanOutSink(const std::vector<std::shared_ptr<rtc::DataChannel>>& channelsToUse)
+        : channels(channelsToUse)
+    {
+    }
+
+    bool isOpen() const override
+    {
+        return std::any_of(channels.begin(), channels.end(), [](const auto& channel) { return channel->isOpen(); });
+    }
+
+    //the fastest partner paces the batches, the sender only holds back once every channel is congested
+    std::size_t getBufferedAmount() const override
+    {
+        std::size_t amount = channels.empty() ? 0 : channels.front()->bufferedAmount();
+
+        for (const auto& channel : channels)
+            amount = std::min(amount, channel->bufferedAmount());
+
+        return amount;
+    }
+
+    //a congested partner is skipped and gets the batch from NACK and retransmission later, one that
+    //fails doesn't keep the packet from the others; throws only if nobody got it
+    void send(const rtc::binary& packet) override
+    {
+        std::exception_ptr failure;
+        bool sentAny = false;
+
+        for (const auto& channel : channels)
+        {
+            if (channel->bufferedAmount() > maxBufferedAmount)
+                continue;
+
+            try {
+                channel->send(packet);
+                sentAny = true;
+            }
+            catch (...) {
+                failure = std::current_exception();
+            }
+        }
+
+        if (!sentAny && failure != nullptr)
+            std::rethrow_exception(failure);
+    }
+
+private:
+    const std::vector<std::shared_ptr<rtc::DataChannel>>& channels;
+};
@@ -0,0 +1,88 @@
+/*
+  ==============================================================================
+
+    The offer/answer/candidate exchange over the signaling server.
+
+  ==============================================================================
+*/
+
+#include "PeerSignaling.h"
+
+#include <nlohmann/json.hpp>
+
+using json = nlohmann::json;
+
+std::shared_ptr<rtc::PeerConnection> PeerSignaling::createPeerConnection(const rtc::Configuration& config,
+	const std::string& partnerId, SendFunction send)
+{
+	auto pc = std::make_shared<rtc::PeerConnection>(config);
+
+	pc->onLocalDescription([send, partnerId](rtc::Description description) {
+		json message = {
+			{"id", partnerId},
+			{"type", description.typeString()},
+			{"description", std::string(description)} };
+
+		send(message.dump());
+	});
+
+	pc->onLocalCandidate([send, partnerId](rtc::Candidate candidate) {
+		json message = { {"id", partnerId},
+						{"type", "candidate"},
+						{"candidate", std::string(candidate)},
+						{"mid", candidate.mid()} };
+
+		send(message.dump());
+	});
+
+	return pc;
+}
+
+bool PeerSignaling::parse(const std::string& text, Message& message)
+{
+	const auto parsed = json::parse(text, nullptr, false);
+
+	if (!parsed.is_object())
+		return false;
+
+	const auto id = parsed.find("id");
+	const auto type = parsed.find("type");
+
+	if (id == parsed.end() || !id->is_string() || type == parsed.end() || !type->is_string())
+		return false;
+
+	message.partnerId = id->get<std::string>();
+	message.type = type->get<std::string>();
+	message.mid.clear();
+
+	const auto field = [&](const char* name, std::string& out) {
+		const auto it = parsed.find(name);
+
+		if (it == parsed.end() || !it->is_string())
+			return false;
+
+		out = it->get<std::string>();
+		return true;
+	};
+
+	if (message.type == "offer" || message.type == "answer")
+		return field("description", message.sdp);
+
+	if (message.type == "candidate")
+		return field("candidate", message.sdp) && field("mid", message.mid);
+
+	return false;
+}
+
+bool PeerSignaling::isOffer(const Message& message)
+{
+	return message.type == "offer";
+}
+
+void PeerSignaling::apply(rtc::PeerConnection& connection, const Message& message)
+{
+	if (message.type == "candidate")
+		connection.addRemoteCandidate(rtc::Candidate(message.sdp, message.mid));
+	else
+		connection.setRemoteDescription(rtc::Description(message.sdp, message.type));
+}
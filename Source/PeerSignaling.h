@@ -0,0 +1,52 @@
+/*
+  ==============================================================================
+
+    The offer/answer/candidate exchange over the signaling server, shared by
+    everything that sets up PeerConnections: the processor, the shared
+    transport hub and the relay.
+
+    Signaling messages are JSON objects:
+
+        {"id": partner, "type": "offer" | "answer", "description": sdp}
+        {"id": partner, "type": "candidate", "candidate": sdp, "mid": mid}
+
+    Outgoing messages carry the id of the partner they are for, the server
+    replaces it with the sender's id on the way.
+
+    Free of JUCE, so the relay can use it.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <rtc/rtc.hpp>
+
+#include <functional>
+#include <memory>
+#include <string>
+
+namespace PeerSignaling
+{
+    using SendFunction = std::function<bool(const std::string& message)>;
+
+    //a PeerConnection whose local description and candidates reach the partner through send
+    std::shared_ptr<rtc::PeerConnection> createPeerConnection(const rtc::Configuration& config,
+        const std::string& partnerId, SendFunction send);
+
+    struct Message
+    {
+        std::string partnerId;
+        std::string type;       //offer, answer or candidate
+        std::string sdp;        //description or candidate
+        std::string mid;        //candidates only
+    };
+
+    //false for anything that isn't a well-formed offer, answer or candidate
+    bool parse(const std::string& text, Message& message);
+
+    bool isOffer(const Message& message);
+
+    //hands the description or candidate to the connection
+    void apply(rtc::PeerConnection& connection, const Message& message);
+}
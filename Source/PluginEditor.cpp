@@ -40,10 +40,12 @@ MidiRTCAudioProcessorEditor::MidiRTCAudioProcessorEditor(MidiRTCAudioProcessor&
 	midiInputVolumeSlider.addListener(this);
 	midiOutputVolumeSlider.addListener(this);
 
+	startTimerHz(10);
 }
 
 MidiRTCAudioProcessorEditor::~MidiRTCAudioProcessorEditor()
 {
+	stopTimer();
 	localIdLabel.setLookAndFeel(nullptr);
 	partnerIdLabel.setLookAndFeel(nullptr);
 }
@@ -54,6 +56,30 @@ void MidiRTCAudioProcessorEditor::sliderValueChanged(juce::Slider* slider)
 	audioProcessor.noteOnVel = midiInputVolumeSlider.getValue();
 }
 
+void MidiRTCAudioProcessorEditor::timerCallback()
+{
+	const auto state = audioProcessor.getConnectionState();
+
+	if (state.state != paintedState.state || state.reason != paintedState.reason || getStatsText() != paintedStats)
+		repaint();
+}
+
+juce::String MidiRTCAudioProcessorEditor::getStatsText()
+{
+	using namespace juce;
+
+	const auto jitterStats = audioProcessor.getJitterBufferStats();
+	ClockSync::Estimate clockEstimate;
+	const String roundTrip = audioProcessor.getClockSyncEstimate(clockEstimate)
+		? String(double(clockEstimate.roundTripMicros) / 1000.0, 1) + " ms" : String("-");
+
+	return "Delay: " + String(audioProcessor.getJitterBufferDelayMs(), 1) + " ms\n"
+		+ "Jitter: " + String(jitterStats.jitterMs, 1) + " ms\n"
+		+ "Late: " + String((juce::int64)jitterStats.lateEvents) + "\n"
+		+ "Underruns: " + String((juce::int64)jitterStats.underruns) + "\n"
+		+ "RTT: " + roundTrip;
+}
+
 //==============================================================================
 void MidiRTCAudioProcessorEditor::paint(juce::Graphics& g)
 {
@@ -69,23 +95,40 @@ void MidiRTCAudioProcessorEditor::paint(juce::Graphics& g)
 	//g.fillAll(Colours::lighyellow);
 
 	//handle connection status with colours
-	if (audioProcessor.isConnected())
-	{
-		repaint();
-		g.setColour(Colours::palegreen);
-	}
-	else
+	paintedState = audioProcessor.getConnectionState();
+
+	switch (paintedState.state)
 	{
-		g.setColour(Colours::lightpink);
+		case ConnectionState::State::open:
+			g.setColour(Colours::palegreen);
+			break;
+
+		case ConnectionState::State::degraded:
+		case ConnectionState::State::signaling:
+		case ConnectionState::State::connecting:
+		case ConnectionState::State::iceChecking:
+			g.setColour(Colours::khaki);
+			break;
+
+		default:
+			g.setColour(Colours::lightpink);
+			break;
 	}
 
 	g.fillRect(headerArea);
 
 	//draw header field
+	String status{ ConnectionState::getName(paintedState.state) };
+
+	if (paintedState.reason != ConnectionState::Reason::none)
+		status << " (" << ConnectionState::getName(paintedState.reason) << ")";
+
 	g.setColour(Colours::black);
 	g.setFont(Font("Verdana", 20, 0));
 	g.setFont(Font(17.f, Font::plain));
 	g.drawFittedText(generalDescription, 0, 0, getWidth(), getHeight(), Justification::centredTop, 1);
+	g.setFont(Font(12.f, Font::plain));
+	g.drawFittedText(status, headerArea.reduced(4, 0), Justification::centredRight, 1);
 
 
 	/*
@@ -138,6 +181,14 @@ void MidiRTCAudioProcessorEditor::paint(juce::Graphics& g)
 	g.setColour(Colours::cornflowerblue);
 	g.fillRect(outputVolumeArea);
 
+	//receive side playout delay and counters
+	paintedStats = getStatsText();
+	g.setColour(Colours::black);
+	g.setFont(Font(13.f, Font::plain));
+	g.drawFittedText(paintedStats,
+		outputVolumeArea.withTrimmedLeft(outputVolumeArea.getWidth() * 0.25).reduced(4),
+		Justification::topLeft, 5);
+
 
 }
 
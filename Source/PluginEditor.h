@@ -22,7 +22,8 @@ struct CustomVolumeSlider : juce::Slider
 //==============================================================================
 
 class MidiRTCAudioProcessorEditor  :    public juce::AudioProcessorEditor,
-                                        private juce::Slider::Listener
+                                        private juce::Slider::Listener,
+                                        private juce::Timer
 {
 public:
     MidiRTCAudioProcessorEditor (MidiRTCAudioProcessor&);
@@ -36,6 +37,12 @@ public:
 
 private:
     void sliderValueChanged(juce::Slider* slider) override;
+
+    //repaints when the connection state or one of the readouts changed since the last paint
+    void timerCallback() override;
+    ConnectionState::Snapshot paintedState;
+    juce::String paintedStats;
+    juce::String getStatsText();
     // This reference is provided as a quick way for your editor to
     // access the processor object that created it.
     MidiRTCAudioProcessor& audioProcessor;
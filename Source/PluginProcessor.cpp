@@ -8,8 +8,9 @@
 #include "PluginProcessor.h"
 #include "PluginEditor.h"
 
-#define crcpp_uint8
-#include "CRC.h"
+#include "PacketFramer.h"
+#include "PeerSignaling.h"
+#include "StreamBundle.h"
 
 
 using namespace juce;
@@ -22,21 +23,40 @@ using chrono::milliseconds;
 using chrono::steady_clock;
 using json = nlohmann::json;
 
-std::unordered_map<std::string, std::shared_ptr<rtc::PeerConnection>> peerConnectionMap;
-std::unordered_map<std::string, std::shared_ptr<rtc::DataChannel>> dataChannelMap;
+template <class T> weak_ptr<T> make_weak_ptr(shared_ptr<T> ptr) { return ptr; }
 
-const size_t MessageSize = 65535;
-//const size_t MessageSize = 255;
-binary messageData(MessageSize);
-binary valueData(MessageSize);
+//a partner behind a relay: every packet goes through the relay's channel as a one-entry bundle addressed to it
+class RelayedSink : public PacketSink
+{
+public:
+	RelayedSink(PacketSink& relayToUse, std::uint16_t participantToUse)
+		: relay(relayToUse), participant(participantToUse)
+	{
+	}
 
-int throughtputSetAsKB;
-int bufferSize;
+	RelayedSink(std::unique_ptr<PacketSink> relayToOwn, std::uint16_t participantToUse)
+		: ownedRelay(std::move(relayToOwn)), relay(*ownedRelay), participant(participantToUse)
+	{
+	}
 
-const float StepCountFor1Sec = 100.0;
-const int stepDurationInMs = int(1000 / StepCountFor1Sec);
+	bool isOpen() const override { return relay.isOpen(); }
+	size_t getBufferedAmount() const override { return relay.getBufferedAmount(); }
 
-template <class T> weak_ptr<T> make_weak_ptr(shared_ptr<T> ptr) { return ptr; }
+	void send(const binary& packet) override
+	{
+		StreamBundler bundler(StreamBundle::defaultMaxSize, PacketFormat::relayBundle);
+
+		if (!bundler.add(participant, packet))
+			throw std::length_error("Packet too big for the relay");
+
+		relay.send(bundler.getBundle());
+	}
+
+private:
+	std::unique_ptr<PacketSink> ownedRelay;
+	PacketSink& relay;
+	std::uint16_t participant;
+};
 
 string MidiRTCAudioProcessor::getLocalId()
 {
@@ -45,16 +65,273 @@ string MidiRTCAudioProcessor::getLocalId()
 
 string MidiRTCAudioProcessor::getPartnerId()
 {
-	return partnerId;
+	return *loadPartnerId();
+}
+
+std::shared_ptr<const std::string> MidiRTCAudioProcessor::loadPartnerId() const
+{
+	return std::atomic_load(&partnerId);
+}
+
+//high resolution clock shared by clock sync and the audio clock anchor
+juce::int64 MidiRTCAudioProcessor::nowMicros()
+{
+	return juce::int64(double(Time::getHighResolutionTicks()) * 1.0e6 / double(Time::getHighResolutionTicksPerSecond()));
+}
+
+//dispatch a received DataChannel message by its type byte, packets from partners outside the session are dropped
+bool MidiRTCAudioProcessor::handleIncomingPacket(const rtc::binary& packet, const std::string& fromId, PacketSink& sink)
+{
+	if (packet.empty())
+		return false;
+
+	const auto slot = getSessionSlot(fromId);
+
+	if (slot < 0)
+		return false;
+
+	const auto* bytes = reinterpret_cast<const uint8_t*>(packet.data());
+
+	switch (bytes[0])
+	{
+		case PacketFormat::clockPing:
+		{
+			const auto receiveMicros = nowMicros();
+			AudioClockAnchor anchor;
+			localAudioClock.load(anchor);
+
+			binary pong(ClockSync::pongSize);
+			const auto size = ClockSync::makePong(bytes, packet.size(), receiveMicros, nowMicros(), anchor,
+				reinterpret_cast<uint8_t*>(pong.data()));
+
+			if (size == 0)
+				return false;
+
+			sink.send(pong);
+			return true;
+		}
+
+		case PacketFormat::clockPong:
+		{
+			const auto receiveMicros = nowMicros();
+			const std::lock_guard<std::mutex> lock(channelMutex);
+			return peerClocks[size_t(slot)].handlePong(bytes, packet.size(), receiveMicros);
+		}
+
+		case PacketFormat::midiBatch:
+			return handleMidiBatch(packet, fromId, sink);
+
+		case PacketFormat::fecParity:
+			return handleParityPacket(packet, fromId);
+
+		case PacketFormat::lossReport:
+		{
+			double lossRate = 0.0;
+
+			if (!LossReport::read(bytes, packet.size(), lossRate))
+				return false;
+
+			const std::lock_guard<std::mutex> lock(senderMutex);
+			peerFeedback[size_t(slot)].lossRate = lossRate;
+			applyPeerFeedback();
+			return true;
+		}
+
+		case PacketFormat::journalAck:
+		{
+			uint32_t sequence = 0;
+
+			if (!JournalAck::read(bytes, packet.size(), sequence))
+				return false;
+
+			const std::lock_guard<std::mutex> lock(senderMutex);
+			peerFeedback[size_t(slot)].hasJournalAck = true;
+			peerFeedback[size_t(slot)].journalAck = sequence;
+			applyPeerFeedback();
+			return true;
+		}
+
+		case PacketFormat::nack:
+			retransmitBatches(bytes, packet.size(), sink);
+			return true;
+
+		case PacketFormat::relayBundle:
+			return handleRelayBundle(packet, fromId, sink);
+
+		default:
+			return false;
+	}
+}
+
+//what a relay forwards from the others in its session, each of them is a partner of its own whose replies
+//go back through the relay; an empty packet means the participant left
+bool MidiRTCAudioProcessor::handleRelayBundle(const rtc::binary& packet, const std::string& relayId, PacketSink& sink)
+{
+	bool isNewRelay = false;
+	int relaySlot = -1;
+	{
+		const std::lock_guard<std::mutex> lock(receiverMutex);
+		relaySlot = findSessionSlot(relayId);
+
+		//relays don't forward relays
+		if (relaySlot < 0 || !sessionPeers[size_t(relaySlot)]->relayId.empty())
+			return false;
+
+		isNewRelay = !sessionPeers[size_t(relaySlot)]->isRelay;
+		sessionPeers[size_t(relaySlot)]->isRelay = true;
+	}
+
+	if (isNewRelay) {
+		//the relay acknowledges nothing itself, the participants behind it do
+		const std::lock_guard<std::mutex> lock(senderMutex);
+		peerFeedback[size_t(relaySlot)].inSession = false;
+		applyPeerFeedback();
+	}
+
+	binary relayed;
+
+	return StreamBundle::forEachPacket(packet.data(), packet.size(), [&](std::uint16_t participant, const uint8_t* bytes, size_t length) {
+		const auto id = relayId + "#" + std::to_string(participant);
+
+		if (length == 0) {
+			forgetDroppedParticipant(relayId, participant);
+			leaveSessionSlot(id);
+			return;
+		}
+
+		if (getSessionSlot(id) < 0)
+		{
+			if (joinSessionSlot(id, relayId, participant) < 0) {
+				dropRelayedParticipant(relayId, participant);
+				return;
+			}
+
+			forgetDroppedParticipant(relayId, participant);
+		}
+
+		const auto* first = reinterpret_cast<const std::byte*>(bytes);
+		relayed.assign(first, first + length);
+		RelayedSink reply(sink, participant);
+
+		try {
+			handleIncomingPacket(relayed, id, reply);
+		}
+		catch (const std::exception& e) {
+			DBG("Relayed reply failed: " << e.what());
+		}
+	});
+}
+
+//check crc and sequence of a received batch and hand the decoded messages to processBlock
+bool MidiRTCAudioProcessor::handleMidiBatch(const rtc::binary& packet, const std::string& fromId, PacketSink& sink)
+{
+	const auto arrivalTicks = Time::getHighResolutionTicks();
+	binary nack(Nack::maxSize);
+	{
+		const std::lock_guard<std::mutex> lock(receiverMutex);
+		const auto slot = findSessionSlot(fromId);
+
+		if (slot < 0)
+			return false;
+
+		auto& peer = *sessionPeers[size_t(slot)];
+
+		if (!queueMidiBatch(peer, slot, packet, arrivalTicks))
+			return false;
+
+		//a late batch can complete a parity group
+		peer.fecDecoder.addDataPacket(packet);
+		queueRecoveredBatches(peer, slot, arrivalTicks);
+
+		//ask for whatever is still missing right away, a batch that was only reordered costs one spare retransmission
+		nack.resize(peer.nackTracker.makeNack(Nack::Clock::now(), reinterpret_cast<uint8_t*>(nack.data())));
+	}
+
+	if (!nack.empty()) {
+		sink.send(nack);
+		nacksSent.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	return true;
+}
+
+bool MidiRTCAudioProcessor::handleParityPacket(const rtc::binary& packet, const std::string& fromId)
+{
+	const auto arrivalTicks = Time::getHighResolutionTicks();
+	const std::lock_guard<std::mutex> lock(receiverMutex);
+	const auto slot = findSessionSlot(fromId);
+
+	if (slot < 0)
+		return false;
+
+	auto& peer = *sessionPeers[size_t(slot)];
+
+	if (!peer.fecDecoder.addParityPacket(packet))
+		return false;
+
+	queueRecoveredBatches(peer, slot, arrivalTicks);
+	return true;
+}
+
+//receiverMutex must be held
+void MidiRTCAudioProcessor::queueRecoveredBatches(SessionPeer& peer, int slot, juce::int64 arrivalTicks)
+{
+	binary recovered;
+
+	while (peer.fecDecoder.popRecovered(recovered)) {
+		if (queueMidiBatch(peer, slot, recovered, arrivalTicks))
+			packetsRecovered.fetch_add(1, std::memory_order_relaxed);
+	}
 }
 
-//recreate Midi Message from vector of bytes (rtc binary)
-juce::MidiMessage MidiRTCAudioProcessor::recreateMidiMessage(rtc::binary messageData)
+//receiverMutex must be held
+bool MidiRTCAudioProcessor::queueMidiBatch(SessionPeer& peer, int slot, const rtc::binary& packet, juce::int64 arrivalTicks)
 {
-	auto midiDummy = juce::MidiMessage::noteOn (1, (uint8_t)messageData[1], (juce::uint8)messageData[2]);
-	DBG("New NoteNumber = " << midiDummy.getNoteNumber());
-	DBG("New Velocity = " << midiDummy.getVelocity());
-	return midiDummy;
+	PacketFormat::BatchView batch;
+
+	if (!PacketFormat::readBatch(packet.data(), packet.size(), batch))
+		return false;
+
+	//a batch may show up both recovered and for real, the second one is dropped,
+	//as is one that arrives after the window moved past it
+	if (peer.receiveWindow.check(batch.sequence) != SequenceWindow::Result::accepted)
+		return false;
+
+	//after a gap the journal brings notes, controllers and pitch bend up to date before the events play;
+	//batches from inside a gap the journal already repaired would only undo that
+	const auto journalResult = peer.journalReader.handleBatch(batch, [&](const uint8_t* message, size_t length) {
+		ReceivedMidiEvent event;
+		std::copy(message, message + length, event.data);
+		event.size = uint8_t(length);
+		event.source = uint8_t(slot);
+		event.remoteTime = batch.baseTime;
+		event.remoteSampleRate = batch.sampleRate;
+		event.arrivalTicks = arrivalTicks;
+		inboundQueue.push(event);
+	});
+
+	peer.nackTracker.received(batch.sequence);
+
+	if (journalResult == JournalReader::Result::stale)
+		return false;
+
+	if (journalResult == JournalReader::Result::recovered) {
+		journalRecoveries.fetch_add(1, std::memory_order_relaxed);
+		peer.nackTracker.forgetBefore(batch.sequence);
+	}
+
+	return PacketFormat::forEachMessage(batch, [&](const uint8_t* message, size_t length, uint32_t sampleTime) {
+		peer.journalReader.observe(message, length);
+
+		ReceivedMidiEvent event;
+		std::copy(message, message + length, event.data);
+		event.size = uint8_t(length);
+		event.source = uint8_t(slot);
+		event.remoteTime = sampleTime;
+		event.remoteSampleRate = batch.sampleRate;
+		event.arrivalTicks = arrivalTicks;
+		inboundQueue.push(event);
+	});
 }
 
 void MidiRTCAudioProcessor::setLocalId(string localId)
@@ -62,83 +339,96 @@ void MidiRTCAudioProcessor::setLocalId(string localId)
 	this->localId = localId;
 }
 
-void MidiRTCAudioProcessor::setPartnerId(string partnerId)
+void MidiRTCAudioProcessor::setPartnerId(string id)
 {
-	this->partnerId = partnerId;
+	std::atomic_store(&partnerId, std::make_shared<const std::string>(id));
+
+	if (auto* shared = sharedHub.load())
+		shared->setPartner(*this, id);
 }
 
-//create PeerConnection and check parameters
+//check parameters, the PeerConnection is set up by openConnection on networkJobs
 void MidiRTCAudioProcessor::connectToPartner()
 {
-	auto pc = make_shared<PeerConnection>(config);
 	DBG("Waiting for signaling to be connected...");
 
-	if (partnerId.empty()) {
+	const auto id = getPartnerId();
+
+	if (id.empty()) {
 		DBG("no partnerId given");
 		return;
 	}
-	if (partnerId == localId) {
+
+	joinSession({ id });
+}
+
+bool MidiRTCAudioProcessor::isValidPartnerId(const std::string& id, const std::string& localId)
+{
+	if (id == localId) {
 		DBG("Invalid remote ID (This is my local ID). Exiting...");
-		return;
+		return false;
 	}
-	if (partnerId.length() != 4) {
-		return;
+
+	return id.length() == 4;
+}
+
+//one offer per partner on networkJobs, partners that are connected already stay as they are
+void MidiRTCAudioProcessor::joinSession(const std::vector<std::string>& partnerIds)
+{
+	for (const auto& id : partnerIds)
+	{
+		if (!isValidPartnerId(id, localId))
+			continue;
+
+		//the hub reuses a connection another instance already has to this partner
+		if (auto* shared = sharedHub.load()) {
+			if (id != *loadPartnerId())
+				setPartnerId(id);
+
+			setConnectionState(ConnectionState::State::connecting, ConnectionState::Reason::offerSent);
+			shared->connect(*this, makeDataChannelInit());
+			return;
+		}
+
+		if (const auto pc = connections.findPeer(id); pc != nullptr && pc->state() == PeerConnection::State::Connected)
+			continue;
+
+		networkJobs.addJob([this, id] { openConnection(id); });
 	}
+}
 
-	DBG("Offering to " + partnerId);
-	pc = createPeerConnection(config, ws, partnerId);
+std::vector<std::string> MidiRTCAudioProcessor::getSessionPeers()
+{
+	std::vector<std::string> peers;
+
+	connections.forEachChannel([&](const std::string& id, const ConnectionRegistry::ChannelPtr& channel) {
+		if (channel->isOpen() && std::find(peers.begin(), peers.end(), id) == peers.end())
+			peers.push_back(id);
+	});
+
+	return peers;
+}
+
+//create PeerConnection, network job thread
+void MidiRTCAudioProcessor::openConnection(const std::string& id)
+{
+	DBG("Offering to " + id);
+	auto pc = createPeerConnection(config, id);
+	connections.setPeer(id, pc);
+	setConnectionState(ConnectionState::State::connecting, ConnectionState::Reason::offerSent);
 
 	// We are the offerer, so create a data channel to initiate the process
 	const string label = "DC-" + std::to_string(1);
 	DBG("Creating DataChannel with label \"" + label + "\"");
-	auto dc = pc->createDataChannel(label);
-	connected = true;
+	auto dc = pc->createDataChannel(label, makeDataChannelInit());
 
-	/*
-	if (sending) {
-		try {
-			while (dc->bufferedAmount() <= bufferSize) {
-				if (sending) {
-					for (int i = 0; i < 2; i = i + 1) {
-						dc->send(messageData);
-						DBG("220");
-					}
-					sending = !sending;
-				}
-			}
-		}
-		catch (const std::exception& e) {
-			DBG("Send failed: " << e.what());
-		}
-	}
-	*/
-
-	// Set Buffer Size
-	dc->setBufferedAmountLowThreshold(bufferSize);
+	// the sender holds back above this and onBufferedAmountLow wakes it again
+	dc->setBufferedAmountLowThreshold(PacketSink::maxBufferedAmount);
 
-	dc->onOpen([&, wdc = make_weak_ptr(dc), label]() {
+	dc->onOpen([&, id, label]() {
 	//dc->onOpen([this, wdc = make_weak_ptr(dc), label]() {
-		DBG("DataChannel from " + partnerId + " open");
-		
-		if (auto dcLocked = wdc.lock()) {
-			try {
-				while (dcLocked->bufferedAmount() <= bufferSize) {
-					if(sending){
-						//always sending twice for redundancy
-						for (int i = 0; i < 2; i++) {
-							dcLocked->send(messageData);
-						}
-						DBG(static_cast<uint8_t> (messageData[0]));
-						DBG(static_cast<uint8_t> (messageData[1]));
-						DBG(static_cast<uint8_t> (messageData[2]));
-						sending = !sending;
-					}
-				}
-			}
-			catch (const std::exception& e) {
-				DBG("Send failed: " << e.what());
-			}
-		}
+		DBG("DataChannel from " + id + " open");
+		handleChannelState(id, true);
 	});
 
 	//dc->onBufferedAmountLow([wdc = make_weak_ptr(dc), label]() {
@@ -146,40 +436,24 @@ void MidiRTCAudioProcessor::connectToPartner()
 
 		DBG("dc->onBufferedAmountLow([&, wdc = make_weak_ptr(dc), label]");
 
-		auto dcLocked = wdc.lock();
-		if (!dcLocked)
-			return;
-
-		// Continue sending
-		try {
-			while (dcLocked->isOpen() && dcLocked->bufferedAmount() <= bufferSize) {
-				if (sending) {
-					dcLocked->send(messageData);
-					sending = !sending;
-				}
-			}
-		}
-		catch (const std::exception& e) {
-			DBG("Send failed: " << e.what());
-		}
+		// Continue sending, whatever waited for room goes out on the sender thread
+		wakeSender();
 	});
 
-	dc->onClosed([this]() { DBG("DataChannel from " + partnerId + " closed");
-	connected = false;
+	dc->onClosed([this, id]() { DBG("DataChannel from " + id + " closed");
+	handleChannelState(id, false);
 		});
 
 
 	//a Data Channel, once opened, is bidirectional
 	//dc->onMessage([this, wdc = make_weak_ptr(dc), label](variant<binary, string> data) {
-	dc->onMessage([&, wdc = make_weak_ptr(dc), label](variant<binary, string> data) {	
+	dc->onMessage([&, id, wdc = make_weak_ptr(dc), label](variant<binary, string> data) {	
 
-		DBG("in onMessage");
-		
 		//if data is binary
 		if (const binary* temp = std::get_if<binary>(&data)) {
-			if (static_cast<uint8_t> ((*temp)[0]) == expRunNum){
-			  recreateMidiMessage(*temp);
-			  expRunNum++;
+			if (auto dcLocked = wdc.lock()) {
+				DataChannelSink reply(dcLocked);
+				handleIncomingPacket(*temp, id, reply);
 			}
 		}
 
@@ -191,210 +465,877 @@ void MidiRTCAudioProcessor::connectToPartner()
 		
 	});
 
-	dataChannelMap.emplace(label, dc);
+	connections.addChannel(id, dc);
 };
 
 //function to create and setup PeerConnection
-shared_ptr<PeerConnection> MidiRTCAudioProcessor::createPeerConnection(const Configuration& config,
-	weak_ptr<WebSocket> wws, string id)
+shared_ptr<PeerConnection> MidiRTCAudioProcessor::createPeerConnection(const Configuration& config, string id)
 {
-
-	DBG("State: asdasdasdasd");
-	auto pc = make_shared<PeerConnection>(config);
-
-	pc->onStateChange([](PeerConnection::State state) {
-		DBG("State: " << (int)state);
-		});
+	auto pc = PeerSignaling::createPeerConnection(config, id, [this](const string& message) { return signaling.send(message); });
+
+	pc->onStateChange([this, id, wpc = make_weak_ptr(pc)](PeerConnection::State state) {
+		handlePeerState(state);
+
+		//a connection that is over leaves the registry, so the partner can call in again; not from
+		//inside its own callback, the job holds the last reference and closes it
+		if (state == PeerConnection::State::Failed || state == PeerConnection::State::Closed)
+			if (auto closed = wpc.lock())
+				networkJobs.addJob([this, id, closed] {
+					if (connections.removePeer(id, closed))
+						leaveSessionSlot(id);
+				});
+	});
 
 	pc->onGatheringStateChange(
 		[](PeerConnection::GatheringState state) {
 			DBG("Gathering State: " << (int)state);
 		});
 
-	pc->onLocalDescription([wws, id](Description description) {
-		json message = {
-			{"id", id},
-			{"type", description.typeString()},
-			{"description", string(description)} };
+	//pc->onDataChannel([this, id](shared_ptr<DataChannel> dc) {
+	pc->onDataChannel([&, id](shared_ptr<DataChannel> dc) {
+		const string label = dc->label();
+		DBG("DataChannel from " + id + " received with label \"" + label + "\"");
+
+		// the sender holds back above this and onBufferedAmountLow wakes it again
+		dc->setBufferedAmountLowThreshold(PacketSink::maxBufferedAmount);
+
+		//registered first, the sender only sends to channels it finds in connections
+		connections.addChannel(id, dc);
+		handleChannelState(id, true);
+
+		//dc->onBufferedAmountLow([wdc = make_weak_ptr(dc), label]() {
+		dc->onBufferedAmountLow([&, wdc = make_weak_ptr(dc), label]() {
+
+			// Continue sending
+			wakeSender();
+		});
+
+		dc->onClosed([this, id]() {
+			DBG("DataChannel from " << id << " closed");
+			handleChannelState(id, false);
+			});
+
+		//hier kommen binaries und strings an -> Midi als binary auslesen und weiterverarbeiten
+		dc->onMessage([&, id, wdc = make_weak_ptr(dc), label](variant<binary, string> data){
+			//Prototyp 5: decode into inboundQueue, processBlock plays it out
+			if (const binary* temp = std::get_if<binary>(&data)) {
+				if (auto dcLocked = wdc.lock()) {
+					DataChannelSink reply(dcLocked);
+					handleIncomingPacket(*temp, id, reply);
+				}
+			}
+
+			/*
+			//Prototyp 3
+			if (const binary* temp = std::get_if<binary>(&data)) {
+
+				myMapKey = static_cast<uint8_t>((*temp)[0]);
+
+				myMapValue mapValue;
+
+				mapValue.myNoteNumber = static_cast<uint8_t>((*temp)[1]);
+				mapValue.myVelocity = static_cast<uint8_t>((*temp)[2]);
+
+				compareMap.insert(std::make_pair(myMapKey, mapValue));
+
+
+			}
+			*/
+
+			/*
+			//Prototyp 2
+			if (const binary* temp = std::get_if<binary>(&data)) {
+				if (static_cast<uint8_t> ((*temp)[0]) == expRunNum) {
+					recreateMidiMessage(*temp);
+					expRunNum++;
+				}
+			}
+			*/
+
+			/*
+			binary temp = &data[0];
+
+			if (static_cast <uint8_t>(data[0]) = expRunNum) {
+				recreateMidiMessage(data);
+				expRunNum++;
+			}
+			else {
+				DBG("already received this message");
+				return;
+			
+			}
+			*/
+
+		});
+
+		});
+
+	return pc;
+}
+
+
+
+//SCTP reliability for the channel we offer, the answering side gets the same channel
+rtc::DataChannelInit MidiRTCAudioProcessor::makeDataChannelInit() const
+{
+	DataChannelInit init;
+
+	switch (channelMode.load())
+	{
+		// no retransmissions and no head-of-line blocking: sequencing, duplicates
+		// and loss are handled by receiveWindow, FEC and the jitter buffer
+		case ChannelMode::unreliable:
+			init.reliability.type = Reliability::Type::Rexmit;
+			init.reliability.rexmit = 0;
+			init.reliability.unordered = true;
+			break;
+
+		// retransmit only while a late note would still be worth playing
+		case ChannelMode::partiallyReliable:
+			init.reliability.type = Reliability::Type::Timed;
+			init.reliability.rexmit = milliseconds(maxPacketLifetimeMs.load());
+			init.reliability.unordered = true;
+			break;
+
+		case ChannelMode::reliableOrdered:
+		default:
+			break;
+	}
+
+	return init;
+}
+
+void MidiRTCAudioProcessor::setChannelMode(ChannelMode mode, int packetLifetimeMs)
+{
+	channelMode = mode;
+	maxPacketLifetimeMs = jmax(1, packetLifetimeMs);
+}
+
+//drain the events processBlock queued since the last call into batches, this is the only consumer of outboundQueue
+size_t MidiRTCAudioProcessor::sendQueuedEvents(PacketSink& sink)
+{
+	const std::lock_guard<std::mutex> lock(senderMutex);
+
+	// read before draining: every event of these blocks is in the queue by now
+	const auto blocksDone = completedBlocks.load(std::memory_order_acquire);
+	const auto now = PacketBatcher::Clock::now();
+	size_t numSent = 0;
+
+	while (hasHeldEvent || outboundQueue.pop(heldEvent)) {
+		hasHeldEvent = true;
+
+		if (batcher.add(heldEvent, now) || batcher.isEmpty()) {
+			// either batched, or not encodable at all
+			hasHeldEvent = false;
+			continue;
+		}
+
+		// batch is full, the held event starts the next one
+		if (sink.getBufferedAmount() > PacketSink::maxBufferedAmount)
+			return numSent;
+
+		sendBatch(sink);
+		numSent++;
+	}
+
+	// a finished block goes out right away, anything else waits for the flush deadline
+	if (!batcher.isEmpty() && (blocksDone != flushedBlocks || batcher.isDue(now))
+		&& sink.getBufferedAmount() <= PacketSink::maxBufferedAmount) {
+		sendBatch(sink);
+		numSent++;
+		flushedBlocks = blocksDone;
+	}
+
+	return numSent;
+}
+
+//audio thread and DataChannel callbacks: wait-free, signals that arrive while the sender is busy count for its next round
+void MidiRTCAudioProcessor::wakeSender()
+{
+	wakersInFlight.fetch_add(1);
+
+	if (auto* shared = sharedHub.load())
+		shared->wake();
+	else
+		senderThread.signal();
+
+	wakersInFlight.fetch_sub(1);
+}
+
+//sender thread: drain whatever is queued, then sleep until the next wakeup or until a started batch is due.
+//Every batch is encoded once and goes to all open channels of the session. While one of them is
+//congested it sleeps until onBufferedAmountLow wakes it
+SenderThread::Clock::time_point MidiRTCAudioProcessor::sendPendingEvents()
+{
+	if (auto* loopback = loopbackSink.load())
+	{
+		size_t numSent = 0;
+		const auto dueTime = sendPendingEvents(*loopback, numSent);
+
+		if (numSent > 0)
+			senderThread.noteSent();
+
+		return dueTime;
+	}
+
+	connections.forEachChannel([this](const std::string&, const ConnectionRegistry::ChannelPtr& channel) {
+		if (channel->isOpen())
+			fanOutChannels.push_back(channel);
+	});
+
+	if (fanOutChannels.empty())
+		return SenderThread::Clock::time_point::max();
+
+	FanOutSink sink(fanOutChannels);
+	size_t numSent = 0;
+	const auto dueTime = sendPendingEvents(sink, numSent);
+
+	//channels that close are not kept alive until the next round
+	fanOutChannels.clear();
+
+	if (numSent > 0)
+		senderThread.noteSent();
+
+	return dueTime;
+}
+
+//the sender's round for either transport, numSent counts the batches handed to the sink
+SenderThread::Clock::time_point MidiRTCAudioProcessor::sendPendingEvents(PacketSink& sink, size_t& numSent)
+{
+	try {
+		numSent = sendQueuedEvents(sink);
+
+		const std::lock_guard<std::mutex> lock(senderMutex);
+
+		if (!batcher.isEmpty() && sink.getBufferedAmount() <= PacketSink::maxBufferedAmount)
+			return batcher.getDueTime();
+	}
+	catch (const std::exception& e) {
+		DBG("Send failed: " << e.what());
+	}
+
+	return SenderThread::Clock::time_point::max();
+}
+
+void MidiRTCAudioProcessor::sendBatch(PacketSink& sink)
+{
+	//the journal describes the state before this batch, its own events are recorded once it is out
+	const auto journalSize = journalEnabled ? journalWriter.write(journalBuffer.data()) : 0;
+	const auto& packet = batcher.finish(runningNum, sampleRateHz.load(std::memory_order_relaxed),
+		journalBuffer.data(), journalSize);
+	sink.send(packet);
+
+	if (journalEnabled)
+		journalWriter.recordBatch(packet);
+
+	retransmitBuffer.store(packet, PacketBatcher::Clock::now());
+
+	packetsSent.fetch_add(1, std::memory_order_relaxed);
+	eventsSent.fetch_add(batcher.getNumEvents(), std::memory_order_relaxed);
+	bytesSent.fetch_add(packet.size(), std::memory_order_relaxed);
+
+	//every k batches are followed by their XOR parity
+	if (fecEncoder.add(packet, parityPacket)) {
+		sink.send(parityPacket);
+		parityPacketsSent.fetch_add(1, std::memory_order_relaxed);
+		bytesSent.fetch_add(parityPacket.size(), std::memory_order_relaxed);
+	}
+
+	batcher.clear();
+
+	//32 bit, wrapping is fine for FEC groups and receiveWindow
+	runningNum++;
+}
+
+void MidiRTCAudioProcessor::setFecGroupSize(int groupSize)
+{
+	const std::lock_guard<std::mutex> lock(senderMutex);
+	fecEncoder.setGroupSize(groupSize);
+}
+
+void MidiRTCAudioProcessor::setRecoveryJournalEnabled(bool shouldBeEnabled)
+{
+	const std::lock_guard<std::mutex> lock(senderMutex);
+	journalEnabled = shouldBeEnabled;
+	journalWriter.reset();
+	batcher.setJournalCapacity(shouldBeEnabled ? JournalWriter::maxSize : 0);
+}
+
+//answer a NACK with the batches that are still kept and not past the deadline
+void MidiRTCAudioProcessor::retransmitBatches(const uint8_t* nack, size_t size, PacketSink& sink)
+{
+	std::array<Nack::Range, Nack::maxRanges> ranges;
+	size_t numRanges = 0;
+
+	if (!Nack::read(nack, size, ranges, numRanges))
+		return;
+
+	const auto now = Nack::Clock::now();
+	const auto deadline = std::chrono::milliseconds(retransmitDeadlineMs.load());
+	const std::lock_guard<std::mutex> lock(senderMutex);
+
+	for (size_t i = 0; i < numRanges; i++) {
+		for (uint32_t sequence = ranges[i].first; sequence != ranges[i].first + ranges[i].count; sequence++) {
+			if (const auto* packet = retransmitBuffer.find(sequence, now, deadline)) {
+				sink.send(*packet);
+				retransmissions.fetch_add(1, std::memory_order_relaxed);
+				bytesSent.fetch_add(packet->size(), std::memory_order_relaxed);
+			}
+		}
+	}
+}
+
+void MidiRTCAudioProcessor::setRetransmitDeadline(int deadlineMs)
+{
+	retransmitDeadlineMs = jmax(0, deadlineMs);
+}
+
+void MidiRTCAudioProcessor::setMaxPacketSize(size_t maxPacketSize)
+{
+	const std::lock_guard<std::mutex> lock(senderMutex);
+	batcher.setMaxPacketSize(maxPacketSize);
+}
+
+void MidiRTCAudioProcessor::setFlushDeadline(std::chrono::microseconds flushDeadline)
+{
+	const std::lock_guard<std::mutex> lock(senderMutex);
+	batcher.setFlushDeadline(flushDeadline);
+}
+
+MidiRTCAudioProcessor::SenderStats MidiRTCAudioProcessor::getSenderStats() const
+{
+	SenderStats stats;
+	stats.packetsSent = packetsSent.load(std::memory_order_relaxed);
+	stats.eventsSent = eventsSent.load(std::memory_order_relaxed);
+	stats.bytesSent = bytesSent.load(std::memory_order_relaxed);
+	stats.parityPacketsSent = parityPacketsSent.load(std::memory_order_relaxed);
+	stats.retransmissions = retransmissions.load(std::memory_order_relaxed);
+	stats.nacksSent = nacksSent.load(std::memory_order_relaxed);
+	stats.packetsRecovered = packetsRecovered.load(std::memory_order_relaxed);
+	stats.journalRecoveries = journalRecoveries.load(std::memory_order_relaxed);
+	stats.relayedPeersDropped = relayedPeersDropped.load(std::memory_order_relaxed);
+	return stats;
+}
+
+SequenceWindow::Stats MidiRTCAudioProcessor::getReceiveStats()
+{
+	SequenceWindow::Stats total;
+	const std::lock_guard<std::mutex> lock(receiverMutex);
+
+	for (const auto& peer : sessionPeers) {
+		if (peer == nullptr)
+			continue;
+
+		const auto stats = peer->receiveWindow.getStats();
+		total.accepted += stats.accepted;
+		total.duplicates += stats.duplicates;
+		total.reordered += stats.reordered;
+		total.tooOld += stats.tooOld;
+		total.missing += stats.missing;
+	}
+
+	return total;
+}
+
+//receiverMutex must be held, -1 if the partner is not in the session
+int MidiRTCAudioProcessor::findSessionSlot(const std::string& id) const
+{
+	for (size_t slot = 0; slot < sessionPeers.size(); slot++)
+		if (sessionPeers[slot] != nullptr && sessionPeers[slot]->partnerId == id)
+			return int(slot);
+
+	return -1;
+}
+
+int MidiRTCAudioProcessor::getSessionSlot(const std::string& id)
+{
+	const std::lock_guard<std::mutex> lock(receiverMutex);
+	return findSessionSlot(id);
+}
+
+//a partner whose channel opened starts with fresh receive state, -1 if the session is full;
+//one that is in the session already keeps its slot as it is. Direct partners and relayed ones
+//are counted apart, a large relay session can't keep a direct partner out
+int MidiRTCAudioProcessor::joinSessionSlot(const std::string& id, const std::string& relayId, std::uint16_t relayParticipant)
+{
+	int slot = -1;
+	{
+		const std::lock_guard<std::mutex> lock(receiverMutex);
+
+		if (const auto existing = findSessionSlot(id); existing >= 0)
+			return existing;
+
+		const auto isRelayed = !relayId.empty();
+		size_t numOfKind = 0;
+
+		for (size_t i = 0; i < sessionPeers.size(); i++) {
+			if (sessionPeers[i] == nullptr) {
+				if (slot < 0)
+					slot = int(i);
+			}
+			else if (sessionPeers[i]->relayId.empty() != isRelayed) {
+				numOfKind++;
+			}
+		}
+
+		if (slot < 0 || numOfKind >= (isRelayed ? maxRelayedPeers : maxSessionPeers))
+			return -1;
+
+		sessionPeers[size_t(slot)] = std::make_unique<SessionPeer>();
+		sessionPeers[size_t(slot)]->partnerId = id;
+		sessionPeers[size_t(slot)]->relayId = relayId;
+		sessionPeers[size_t(slot)]->relayParticipant = relayParticipant;
+		slotGenerations[size_t(slot)].fetch_add(1, std::memory_order_relaxed);
+	}
+	{
+		const std::lock_guard<std::mutex> lock(channelMutex);
+		peerClocks[size_t(slot)].reset();
+	}
+	{
+		const std::lock_guard<std::mutex> lock(senderMutex);
+		peerFeedback[size_t(slot)] = PeerFeedback();
+		peerFeedback[size_t(slot)].inSession = true;
+		applyPeerFeedback();
+	}
+
+	return slot;
+}
+
+//a relay takes the partners behind it along
+void MidiRTCAudioProcessor::leaveSessionSlot(const std::string& id)
+{
+	int slot = -1;
+	std::vector<std::string> relayedIds;
+	{
+		const std::lock_guard<std::mutex> lock(receiverMutex);
+		slot = findSessionSlot(id);
+
+		if (slot < 0)
+			return;
+
+		if (sessionPeers[size_t(slot)]->isRelay)
+			for (const auto& peer : sessionPeers)
+				if (peer != nullptr && peer->relayId == id)
+					relayedIds.push_back(peer->partnerId);
+
+		sessionPeers[size_t(slot)].reset();
+	}
+
+	for (const auto& relayedId : relayedIds)
+		leaveSessionSlot(relayedId);
+
+	{
+		const std::lock_guard<std::mutex> lock(channelMutex);
+		peerClocks[size_t(slot)].reset();
+	}
+	{
+		//a partner that leaves no longer holds back the journal
+		const std::lock_guard<std::mutex> lock(senderMutex);
+		peerFeedback[size_t(slot)] = PeerFeedback();
+		applyPeerFeedback();
+	}
+}
+
+//a participant the relay forwards while all relayed slots are taken is counted once, not with every bundle
+void MidiRTCAudioProcessor::dropRelayedParticipant(const std::string& relayId, std::uint16_t participant)
+{
+	const std::lock_guard<std::mutex> lock(receiverMutex);
+	const auto slot = findSessionSlot(relayId);
+
+	if (slot < 0)
+		return;
+
+	auto& dropped = sessionPeers[size_t(slot)]->droppedParticipants;
+
+	if (std::find(dropped.begin(), dropped.end(), participant) != dropped.end())
+		return;
+
+	dropped.push_back(participant);
+	relayedPeersDropped.fetch_add(1, std::memory_order_relaxed);
+}
+
+//it got a slot after all or left, dropping it again counts again
+void MidiRTCAudioProcessor::forgetDroppedParticipant(const std::string& relayId, std::uint16_t participant)
+{
+	const std::lock_guard<std::mutex> lock(receiverMutex);
+	const auto slot = findSessionSlot(relayId);
+
+	if (slot < 0)
+		return;
+
+	auto& dropped = sessionPeers[size_t(slot)]->droppedParticipants;
+	dropped.erase(std::remove(dropped.begin(), dropped.end(), participant), dropped.end());
+}
+
+//senderMutex must be held
+void MidiRTCAudioProcessor::applyPeerFeedback()
+{
+	double worstLoss = 0.0;
+	bool allAcknowledged = true;
+	bool anyAcknowledged = false;
+	uint32_t oldestAck = 0;
+
+	for (const auto& feedback : peerFeedback) {
+		if (!feedback.inSession)
+			continue;
+
+		worstLoss = jmax(worstLoss, feedback.lossRate);
+
+		if (!feedback.hasJournalAck) {
+			allAcknowledged = false;
+			continue;
+		}
+
+		if (!anyAcknowledged || int32_t(feedback.journalAck - oldestAck) < 0)
+			oldestAck = feedback.journalAck;
+
+		anyAcknowledged = true;
+	}
+
+	fecEncoder.setMeasuredLoss(worstLoss);
+
+	if (allAcknowledged && anyAcknowledged)
+		journalWriter.acknowledge(oldestAck);
+}
+
+bool MidiRTCAudioProcessor::hasOpenChannel() const
+{
+	bool anyOpen = false;
+
+	connections.forEachChannel([&](const std::string&, const ConnectionRegistry::ChannelPtr& channel) {
+		anyOpen = anyOpen || channel->isOpen();
+	});
+
+	return anyOpen;
+}
+
+//compare received MIDI-Messages
+/*void compareMessages(rtc::binary messageData) {
+	if(tempRunNum == messageData[0])
+}
+*/
+
+//generate localID
+void MidiRTCAudioProcessor::generateLocalId(size_t length) {
+	static const string characters(
+		"0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz");
+	string id(length, '0');
+	default_random_engine rng(random_device{}());
+	uniform_int_distribution<int> dist(0, int(characters.size() - 1));
+	generate(id.begin(), id.end(), [&]() { return characters.at(dist(rng)); });
+	setLocalId(id);
+}
+
+//==============================================================================
+MidiRTCAudioProcessor::MidiRTCAudioProcessor()
+#ifndef JucePlugin_PreferredChannelConfigurations
+	: AudioProcessor(BusesProperties()
+#if ! JucePlugin_IsMidiEffect
+#if ! JucePlugin_IsSynth
+		.withInput("Input", juce::AudioChannelSet::stereo(), true)
+#endif
+		.withOutput("Output", juce::AudioChannelSet::stereo(), true)
+#endif
+	)
+#endif
+{
+	generateLocalId(4);
+
+	signaling.onStatus([this](SignalingClient::Status status, const std::string& detail) { handleSignalingStatus(status, detail); });
+	signaling.onMessage([this](const std::string& message) { handleSignalingMessage(message); });
+
+	//clock pings, loss reports and jitter buffer delay changes for the host, see timerCallback
+	startTimerHz(4);
+	senderThread.start([this] { return sendPendingEvents(); });
+}
+
+MidiRTCAudioProcessor::~MidiRTCAudioProcessor()
+{
+	stopTimer();
+
+	if (auto* shared = sharedHub.exchange(nullptr))
+		shared->removeStream(*this);
+
+	senderThread.stop();
+	networkJobs.removeAllJobs(true, 2000);
+	closeConnections();
+}
+
+void MidiRTCAudioProcessor::setJitterBufferSettings(const JitterBuffer::Settings& settings)
+{
+	fixedJitterDelay.store(settings.mode == JitterBuffer::Mode::fixed);
+	minJitterDelayMs.store(settings.minDelayMs);
+	maxJitterDelayMs.store(settings.maxDelayMs);
+	fixedJitterDelayMs.store(settings.fixedDelayMs);
+}
+
+void MidiRTCAudioProcessor::setReportLatencyToHost(bool shouldReport)
+{
+	reportLatencyToHost = shouldReport;
+	timerCallback();
+}
+
+//clock ping (the peer answers with a pong that updates its clock sync), our measured loss for the peer's FEC
+//and the newest batch we have, which lets the peer trim its recovery journal; once per partner
+void MidiRTCAudioProcessor::sendControlMessages()
+{
+	std::vector<std::pair<std::string, std::unique_ptr<PacketSink>>> targets;
+
+	if (auto* shared = sharedHub.load(std::memory_order_acquire))
+	{
+		if (auto sink = shared->makeSink(*this))
+			targets.emplace_back(getPartnerId(), std::move(sink));
+	}
+	else
+	{
+		//partners behind a relay get theirs through the relay's channel
+		struct Relayed { std::string id, relayId; std::uint16_t participant; };
+		std::vector<Relayed> relayed;
+		{
+			const std::lock_guard<std::mutex> lock(receiverMutex);
+
+			for (const auto& peer : sessionPeers)
+				if (peer != nullptr && !peer->relayId.empty())
+					relayed.push_back({ peer->partnerId, peer->relayId, peer->relayParticipant });
+		}
+
+		connections.forEachChannel([&](const std::string& id, const ConnectionRegistry::ChannelPtr& channel) {
+			if (!channel->isOpen())
+				return;
+
+			targets.emplace_back(id, std::make_unique<DataChannelSink>(channel));
+
+			for (const auto& partner : relayed)
+				if (partner.relayId == id)
+					targets.emplace_back(partner.id, std::make_unique<RelayedSink>(std::make_unique<DataChannelSink>(channel), partner.participant));
+		});
+	}
+
+	if (targets.empty())
+		return;
+
+	double worstLoss = 0.0;
+
+	for (auto& [id, sink] : targets)
+		worstLoss = jmax(worstLoss, sendControlMessages(id, *sink));
+
+	//hysteresis, and only a degraded state loss caused is lifted by loss going away
+	if (worstLoss > 0.1)
+		setConnectionState(ConnectionState::State::open, ConnectionState::State::degraded, ConnectionState::Reason::highLoss);
+	else if (worstLoss < 0.02 && connectionState.getSnapshot().reason == ConnectionState::Reason::highLoss)
+		setConnectionState(ConnectionState::State::degraded, ConnectionState::State::open, ConnectionState::Reason::lossRecovered);
+}
+
+//returns the loss measured on what this partner sent since the last call
+double MidiRTCAudioProcessor::sendControlMessages(const std::string& toId, PacketSink& sink)
+{
+	const auto slot = getSessionSlot(toId);
+
+	if (slot < 0)
+		return 0.0;
 
-		if (auto ws = wws.lock())
-			ws->send(message.dump());
-		});
+	binary ping(ClockSync::pingSize);
+	ClockSync::makePing(nowMicros(), reinterpret_cast<uint8_t*>(ping.data()));
 
-	pc->onLocalCandidate([wws, id](Candidate candidate) {
-		json message = { {"id", id},
-						{"type", "candidate"},
-						{"candidate", string(candidate)},
-						{"mid", candidate.mid()} };
+	//a NACK is repeated once the answer should have been there, about one round trip
+	ClockSync::Estimate estimate;
+	const auto nackRetryInterval = peerClocks[size_t(slot)].getEstimate(estimate)
+		? std::chrono::microseconds(estimate.roundTripMicros + estimate.roundTripMicros / 4) + std::chrono::milliseconds(2)
+		: std::chrono::microseconds(std::chrono::milliseconds(20));
 
-		if (auto ws = wws.lock())
-			ws->send(message.dump());
-		});
+	binary report(LossReport::size);
+	binary ack;
+	binary nack(Nack::maxSize);
+	double lossRate = 0.0;
+	{
+		const std::lock_guard<std::mutex> lock(receiverMutex);
 
-	//pc->onDataChannel([this, id](shared_ptr<DataChannel> dc) {
-	pc->onDataChannel([&, id](shared_ptr<DataChannel> dc) {
-		connected = true;
-		const string label = dc->label();
-		DBG("DataChannel from " + id + " received with label \"" + label + "\"");
+		if (findSessionSlot(toId) != slot || sessionPeers[size_t(slot)]->isRelay)
+			return 0.0;
 
-		DBG("###########################################");
-		DBG("### Check other peer's screen for stats ###");
-		DBG("###########################################");
+		auto& peer = *sessionPeers[size_t(slot)];
+		lossRate = peer.fecDecoder.takeLossRate();
+		LossReport::write(lossRate, reinterpret_cast<uint8_t*>(report.data()));
 
-		// Set Buffer Size
-		dc->setBufferedAmountLowThreshold(bufferSize);
+		uint32_t newestSequence = 0;
 
-		if (sending) {
-			DBG("this is the remote - sender");
-			for (int i = 0; i < 2; i++) {
-				dc->send(messageData);
-			}
-			messageData.clear();
-			sending = !sending;
+		if (peer.journalReader.getNewestSequence(newestSequence)) {
+			ack.resize(JournalAck::size);
+			JournalAck::write(newestSequence, reinterpret_cast<uint8_t*>(ack.data()));
 		}
 
-		//dc->onBufferedAmountLow([wdc = make_weak_ptr(dc), label]() {
-		dc->onBufferedAmountLow([&, wdc = make_weak_ptr(dc), label]() {
+		//retries are normally sent when the next batch comes in, this catches the end of a phrase
+		peer.nackTracker.setRetryInterval(nackRetryInterval);
+		nack.resize(peer.nackTracker.makeNack(Nack::Clock::now(), reinterpret_cast<uint8_t*>(nack.data())));
+	}
 
-			auto dcLocked = wdc.lock();
-			if (!dcLocked)
-				return;
+	try {
+		sink.send(ping);
+		sink.send(report);
 
-			// Continue sending
-			try {
-				while (dcLocked->isOpen() && dcLocked->bufferedAmount() <= bufferSize) {
-					DBG("Double sending: dcLocked");
-					if (sending) {
-						for (int i = 0; i < 2; i++) {
-							dcLocked->send(messageData);
-							DBG("sending BufAmoLow");
-						}
-						sending = !sending;
-						DBG("sending = !sending");
-					}
-					DBG("not sending, while loop");
-				}
-			}
-			catch (const std::exception& e) {
-				DBG("Sending failed: " << e.what());
-			}
-		});
+		if (!ack.empty())
+			sink.send(ack);
 
-		dc->onClosed([id]() {
-			DBG("DataChannel from " << id << " closed");
-			});
+		if (!nack.empty()) {
+			sink.send(nack);
+			nacksSent.fetch_add(1, std::memory_order_relaxed);
+		}
+	}
+	catch (const std::exception& e) {
+		DBG("Control message failed: " << e.what());
+	}
 
-		//hier kommen binaries und strings an -> Midi als binary auslesen und weiterverarbeiten
-		dc->onMessage([&, id, wdc = make_weak_ptr(dc), label](variant<binary, string> data){
-			DBG("Receive: dc->onMessage");
+	return lossRate;
+}
 
-			//Prototyp 4
-			if (const binary* temp = std::get_if<binary>(&data)) {
-				auto tempRunNum = static_cast<uint8_t>((*temp)[0]);
-				auto tempNoteNumber = static_cast<uint8_t>((*temp)[1]);
-				auto tempVelocity = static_cast<uint8_t>((*temp)[2]);
-				auto tempCrc = static_cast<uint8_t>((*temp)[3]);
+SenderThread::Stats MidiRTCAudioProcessor::getSenderThreadStats() const
+{
+	if (auto* shared = sharedHub.load())
+		return shared->getStats().sender;
 
-				string valueDataString = to_string(tempRunNum) + to_string(tempNoteNumber) + to_string(tempVelocity);
+	return senderThread.getStats();
+}
 
-				std::uint8_t crc = CRC::Calculate(valueDataString.c_str(), sizeof(valueDataString.c_str()), CRC::CRC_8());
+bool MidiRTCAudioProcessor::setSharedTransportEnabled(bool shouldShare, std::uint16_t streamId)
+{
+	if (shouldShare == isSharedTransportEnabled())
+		return true;
 
-				if (crc == tempCrc) {
-					DBG("NOICCE");
-				}
-				else {
-					DBG("DAMN");
-				}
+	if (!shouldShare) {
+		sharedHub.load()->removeStream(*this);
+		sharedStreamId = 0;
+		releaseSharedTransport();
 
-			}
+		setConnectionState(ConnectionState::State::closed, ConnectionState::Reason::released);
+		leaveSessionSlot(getPartnerId());
 
-			/*
-			//Prototyp 3
-			if (const binary* temp = std::get_if<binary>(&data)) {
+		generateLocalId(4);
+		senderThread.start([this] { return sendPendingEvents(); });
+		startTransport();
+		return true;
+	}
 
-				myMapKey = static_cast<uint8_t>((*temp)[0]);
+	//the own transport is gone before the hub calls in, nothing of it runs in parallel
+	senderThread.stop();
+	networkJobs.removeAllJobs(true, 2000);
+	closeConnections();
 
-				myMapValue mapValue;
+	sharedTransport = std::make_unique<juce::SharedResourcePointer<TransportHub>>();
 
-				mapValue.myNoteNumber = static_cast<uint8_t>((*temp)[1]);
-				mapValue.myVelocity = static_cast<uint8_t>((*temp)[2]);
+	auto& hub = sharedTransport->get();
+	setLocalId(hub.getLocalId());
+	sharedHub.store(&hub);
 
-				compareMap.insert(std::make_pair(myMapKey, mapValue));
+	sharedStreamId = hub.addStream(*this, streamId);
 
+	if (sharedStreamId == 0) {
+		releaseSharedTransport();
+		generateLocalId(4);
+		senderThread.start([this] { return sendPendingEvents(); });
+		startTransport();
+		return false;
+	}
 
-			}
-			*/
+	hub.setPartner(*this, getPartnerId());
+	return true;
+}
 
-			/*
-			//Prototyp 2
-			if (const binary* temp = std::get_if<binary>(&data)) {
-				if (static_cast<uint8_t> ((*temp)[0]) == expRunNum) {
-					recreateMidiMessage(*temp);
-					expRunNum++;
-				}
-			}
-			*/
+//message thread, once this instance's stream is gone or was never added
+void MidiRTCAudioProcessor::releaseSharedTransport()
+{
+	sharedHub.store(nullptr);
 
-			/*
-			binary temp = &data[0];
+	//a wake that still saw the hub is over in a few instructions
+	while (wakersInFlight.load() != 0)
+		std::this_thread::yield();
 
-			if (static_cast <uint8_t>(data[0]) = expRunNum) {
-				recreateMidiMessage(data);
-				expRunNum++;
-			}
-			else {
-				DBG("already received this message");
-				return;
-			
-			}
-			*/
+	sharedTransport.reset();
+}
 
-		});
-		
-		dataChannelMap.emplace(label, dc);
+SenderThread::Clock::time_point MidiRTCAudioProcessor::sendPendingPackets(PacketSink& sink)
+{
+	size_t numSent = 0;
+	return sendPendingEvents(sink, numSent);
+}
 
-		});
+void MidiRTCAudioProcessor::receivePacket(const rtc::binary& packet, PacketSink& sink)
+{
+	const auto id = loadPartnerId();
+	handleIncomingPacket(packet, *id, sink);
+}
 
-	peerConnectionMap.emplace(id, pc);
-	return pc;
+void MidiRTCAudioProcessor::signalingStatusChanged(SignalingClient::Status status, const std::string& detail)
+{
+	handleSignalingStatus(status, detail);
 }
 
+void MidiRTCAudioProcessor::peerStateChanged(rtc::PeerConnection::State state)
+{
+	handlePeerState(state);
+}
 
+void MidiRTCAudioProcessor::channelStateChanged(bool isOpen)
+{
+	const auto id = loadPartnerId();
+	handleChannelState(*id, isOpen);
+}
 
-//compare received MIDI-Messages
-/*void compareMessages(rtc::binary messageData) {
-	if(tempRunNum == messageData[0])
+//only for streams whose partner is the caller, the hub must not be called back from here
+void MidiRTCAudioProcessor::offerReceived(const std::string&)
+{
+	setConnectionState(ConnectionState::State::connecting, ConnectionState::Reason::offerReceived);
 }
-*/
 
-//generate localID
-void MidiRTCAudioProcessor::generateLocalId(size_t length) {
-	static const string characters(
-		"0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz");
-	string id(length, '0');
-	default_random_engine rng(random_device{}());
-	uniform_int_distribution<int> dist(0, int(characters.size() - 1));
-	generate(id.begin(), id.end(), [&]() { return characters.at(dist(rng)); });
-	setLocalId(id);
+bool MidiRTCAudioProcessor::getClockSyncEstimate(ClockSync::Estimate& estimate) const
+{
+	for (const auto& clock : peerClocks)
+		if (clock.getEstimate(estimate))
+			return true;
+
+	return false;
 }
 
-//==============================================================================
-MidiRTCAudioProcessor::MidiRTCAudioProcessor()
-#ifndef JucePlugin_PreferredChannelConfigurations
-	: AudioProcessor(BusesProperties()
-#if ! JucePlugin_IsMidiEffect
-#if ! JucePlugin_IsSynth
-		.withInput("Input", juce::AudioChannelSet::stereo(), true)
-#endif
-		.withOutput("Output", juce::AudioChannelSet::stereo(), true)
-#endif
-	)
-#endif
+void MidiRTCAudioProcessor::openLoopback(PacketSink& sink)
 {
+	using S = ConnectionState::State;
+	using R = ConnectionState::Reason;
+
+	networkJobs.removeAllJobs(true, 2000);
+	closeConnections();
+	loopbackSink.store(&sink);
+
+	//closed leads to open only through connecting, signaling is down and can't get in between
+	setConnectionState(S::closed, S::connecting, R::offerSent);
+	setConnectionState(S::connecting, S::open, R::channelOpened);
+	wakeSender();
 }
 
-MidiRTCAudioProcessor::~MidiRTCAudioProcessor()
+bool MidiRTCAudioProcessor::pushReceivedEvent(const ReceivedMidiEvent& event)
+{
+	if (loopbackSink.load() == nullptr)
+		return false;
+
+	return inboundQueue.push(event);
+}
+
+//message thread: hosts may re-prepare the plugin on latency changes, so small changes are ignored
+void MidiRTCAudioProcessor::timerCallback()
 {
+	//an offer or ICE check that gets nowhere ends as failed, connectToPartner() tries again
+	const auto link = connectionState.getSnapshot();
+
+	if ((link.state == ConnectionState::State::connecting || link.state == ConnectionState::State::iceChecking)
+		&& nowMicros() - link.sinceMicros > juce::int64(peerConnectTimeoutMs.load()) * 1000)
+		setConnectionState(link.state, ConnectionState::State::failed, ConnectionState::Reason::timedOut);
+
+	sendControlMessages();
+
+	const auto latency = reportLatencyToHost.load() ? jitterBuffer.getDelaySamples() : 0;
+	const auto reported = getLatencySamples();
+	const auto threshold = jmax(64, reported / 10);
+
+	if (latency == 0 ? reported != 0 : std::abs(latency - reported) > threshold)
+		setLatencySamples(latency);
 }
 
 //==============================================================================
@@ -468,98 +1409,225 @@ void MidiRTCAudioProcessor::prepareToPlay(double sampleRate, int samplesPerBlock
 	// construct message to send
 	string stunServer = "";
 
-	generateLocalId(4);
+	//stamped into every outbound batch so the partner can convert our sample times
+	sampleRateHz.store(uint32_t(sampleRate), std::memory_order_relaxed);
+	localSampleRate = sampleRate;
+	jitterBuffer.prepare(sampleRate);
+
+	//hosts re-prepare on every sample rate or buffer size change, the session carries on
+	startTransport();
+}
 
-	ws = make_shared<WebSocket>();
+//the local id, signaling and peer connections live as long as the processor, not the audio setup;
+//they are started by the first prepareToPlay (so plugin scans stay offline) or again after signaling gave up
+void MidiRTCAudioProcessor::startTransport()
+{
+	if (sharedHub.load() != nullptr)
+		return;
 
-	std::promise<void> wsPromise;
-	auto wsFuture = wsPromise.get_future();
+	const auto status = signaling.getStatus();
 
-	ws->onOpen([&wsPromise]() {
-		DBG("WebSocket connected, signaling ready");
-		wsPromise.set_value();
-		});
+	if (status != SignalingClient::Status::disconnected && status != SignalingClient::Status::failed)
+		return;
 
-	ws->onError([&wsPromise](string s) {
-		DBG("WebSocket error");
-		wsPromise.set_exception(std::make_exception_ptr(std::runtime_error(s)));
-		});
+	//create Websocket
+	string wsPrefix = "ws://";
 
-	ws->onClosed([]() { DBG("WebSocket closed"); });
+	const string url = wsPrefix + "192.168.178.50:8080" + "/" + localId;   // 192.168.178.50:8080 = k3h3pi address
+	//const string url = wsPrefix + "127.0.0.1:8000" + "/" + localId;
 
-	ws->onMessage([&](variant<binary, string> data) {
-		if (!holds_alternative<string>(data))
-		{
-			return;
-		}
+	DBG("Url is " + url);
 
-		json message = json::parse(get<string>(data));
+	//own websocket is opened in the background, retried until the server answers
+	SignalingClient::Settings settings;
+	settings.url = url;
+	signaling.connect(settings);
+}
 
-		auto it = message.find("id");
-		if (it == message.end())
-		{
-			return;
-		}
-		setPartnerId(it->get<string>());
+//signaling status -> connection state, a connected peer doesn't need signaling any more
+void MidiRTCAudioProcessor::handleSignalingStatus(SignalingClient::Status status, const std::string& detail)
+{
+	using S = ConnectionState::State;
+	using R = ConnectionState::Reason;
 
-		it = message.find("type");
-		if (it == message.end())
-		{
-			return;
-		}
-		
-		string type = it->get<string>();
-		shared_ptr<PeerConnection> pc;
-		
-		// entweder connection wird nicht erstellt weil schon ID vorhanden (if), verbindung wird
-		// erstellt, weil vom typ offer und noch nicht vorhanden(else if), oder Abbruch (else)
+	switch (status)
+	{
+		case SignalingClient::Status::connecting:
+			DBG("Connecting to signaling server " << detail);
+			setConnectionState(S::signaling, R::signalingStarted);
+			break;
+
+		case SignalingClient::Status::connected:
+			DBG("WebSocket connected, signaling ready");
+			setConnectionState(S::signaling, S::ready, R::signalingOpened);
+			break;
+
+		case SignalingClient::Status::retrying:
+			DBG("Signaling retrying: " << detail);
+			setConnectionState(S::ready, S::signaling, R::signalingClosed);
+			break;
+
+		case SignalingClient::Status::failed:
+			DBG("WebSocket error: " << detail);
+			setConnectionState(S::signaling, S::failed, R::signalingFailed);
+			break;
+
+		case SignalingClient::Status::disconnected:
+		default:
+			DBG("WebSocket closed");
+			setConnectionState(S::ready, S::idle, R::signalingClosed);
+			break;
+	}
+}
 
-		
-		if (auto jt = peerConnectionMap.find(partnerId); jt != peerConnectionMap.end())
-		{
-			pc = jt->second; // peer connection wird nicht erstellt, weil mit der ID schon eine
-							 // vorhanden ist
-		}
-		else if (type == "offer") {
-			DBG("Answering to " + partnerId);
-			// angegebener ID wird geantwortet -> verbindung aufgebaut
-			pc = createPeerConnection(config, ws, partnerId); // peer connection wird erstellt
-		}
-		else
+//offers, answers and candidates from the signaling server, WebSocket thread
+void MidiRTCAudioProcessor::handleSignalingMessage(const std::string& data)
+{
+	PeerSignaling::Message message;
+
+	if (!PeerSignaling::parse(data, message))
+	{
+		return;
+	}
+	setPartnerId(message.partnerId);
+
+	auto pc = connections.findPeer(message.partnerId);
+
+	//a partner that restarted offers again; a connection of it that is over is replaced, with
+	//everything the old one left in its session slot
+	if (PeerSignaling::isOffer(message))
+	{
+		if (pc == nullptr || pc->state() == PeerConnection::State::Failed || pc->state() == PeerConnection::State::Closed)
 		{
-			return;
-		}
-		
+			DBG("Answering to " + message.partnerId);
 
-		// wird aufgerufen, wenn verbindung bereits besteht
-		if (type == "offer" || type == "answer") {
-			auto sdp = message["description"].get<string>();
-			pc->setRemoteDescription(Description(sdp, type));
-		}
-		else if (type == "candidate") {
-			auto sdp = message["candidate"].get<string>();
-			auto mid = message["mid"].get<string>();
-			pc->addRemoteCandidate(Candidate(sdp, mid));
+			if (pc != nullptr)
+				leaveSessionSlot(message.partnerId);
+
+			pc = createPeerConnection(config, message.partnerId);
+			connections.setPeer(message.partnerId, pc);
+			setConnectionState(ConnectionState::State::connecting, ConnectionState::Reason::offerReceived);
 		}
-		});
+	}
+	else if (pc == nullptr)
+	{
+		return;
+	}
 
-	//create Websocket
-	string wsPrefix = "ws://";
+	PeerSignaling::apply(*pc, message);
+}
 
-	const string url = wsPrefix + "192.168.178.50:8080" + "/" + localId;   // 192.168.178.50:8080 = k3h3pi address
-	//const string url = wsPrefix + "127.0.0.1:8000" + "/" + localId;
+//ICE progress -> connection state, open itself is set when the DataChannel opens
+void MidiRTCAudioProcessor::handlePeerState(PeerConnection::State state)
+{
+	DBG("State: " << (int)state);
 
-	DBG("Url is " + url);
+	using S = ConnectionState::State;
+	using R = ConnectionState::Reason;
+
+	switch (state)
+	{
+		case PeerConnection::State::Connecting:     setConnectionState(S::iceChecking, R::iceChecking); break;
+		case PeerConnection::State::Connected:      setConnectionState(S::degraded, S::open, R::iceConnected); break;
+		case PeerConnection::State::Disconnected:   setConnectionState(S::open, S::degraded, R::iceDisconnected); break;
+		case PeerConnection::State::Failed:
+			//one partner dropping out doesn't end a session that still has others
+			if (!hasOpenChannel())
+				setConnectionState(S::failed, R::iceFailed);
+			break;
+		default: break;
+	}
+}
+
+//a partner's channel joins the session with a new clock sync, whatever processBlock queued meanwhile goes out now;
+//the session is ready again once the last one closed
+void MidiRTCAudioProcessor::handleChannelState(const std::string& id, bool isOpen)
+{
+	if (!isOpen) {
+		leaveSessionSlot(id);
+
+		if (!hasOpenChannel())
+			setConnectionState(ConnectionState::State::ready, ConnectionState::Reason::channelClosed);
+		return;
+	}
+
+	if (joinSessionSlot(id) < 0) {
+		DBG("Session is full, nothing from " + id + " is played");
+		return;
+	}
 
-	//own websocket is opened
-	ws->open(url);
-	wsFuture.get();
+	setConnectionState(ConnectionState::State::open, ConnectionState::Reason::channelOpened);
+	wakeSender();
 }
 
 void MidiRTCAudioProcessor::releaseResources()
 {
 	// When playback stops, you can use this as an opportunity to free up any
 	// spare memory, etc.
+	// The transport stays up, the next prepareToPlay continues the same session.
+}
+
+//detaches every callback that captures this processor before closing, only when the processor goes away
+void MidiRTCAudioProcessor::closeConnections()
+{
+	signaling.disconnect();
+	connections.closeAll();
+
+	std::vector<std::string> sessionIds;
+	{
+		const std::lock_guard<std::mutex> lock(receiverMutex);
+
+		for (const auto& peer : sessionPeers)
+			if (peer != nullptr)
+				sessionIds.push_back(peer->partnerId);
+	}
+
+	for (const auto& id : sessionIds)
+		leaveSessionSlot(id);
+
+	setConnectionState(ConnectionState::State::closed, ConnectionState::Reason::released);
+}
+
+bool MidiRTCAudioProcessor::setConnectionState(ConnectionState::State newState, ConnectionState::Reason reason)
+{
+	if (!connectionState.transition(newState, reason, nowMicros()))
+		return false;
+
+	notifyConnectionState();
+	return true;
+}
+
+bool MidiRTCAudioProcessor::setConnectionState(ConnectionState::State fromState, ConnectionState::State newState,
+	ConnectionState::Reason reason)
+{
+	if (!connectionState.transition(fromState, newState, reason, nowMicros()))
+		return false;
+
+	notifyConnectionState();
+	return true;
+}
+
+void MidiRTCAudioProcessor::notifyConnectionState()
+{
+	std::function<void(const ConnectionState::Snapshot&)> callback;
+	{
+		const std::lock_guard<std::mutex> lock(stateCallbackMutex);
+		callback = connectionStateCallback;
+	}
+
+	if (callback != nullptr)
+		callback(connectionState.getSnapshot());
+}
+
+void MidiRTCAudioProcessor::setConnectionStateCallback(std::function<void(const ConnectionState::Snapshot&)> callback)
+{
+	const std::lock_guard<std::mutex> lock(stateCallbackMutex);
+	connectionStateCallback = std::move(callback);
+}
+
+void MidiRTCAudioProcessor::setPeerConnectTimeout(int timeoutMs)
+{
+	peerConnectTimeoutMs = jmax(1000, timeoutMs);
 }
 
 #ifndef JucePlugin_PreferredChannelConfigurations
@@ -590,58 +1658,113 @@ bool MidiRTCAudioProcessor::isBusesLayoutSupported(const BusesLayout& layouts) c
 
 void MidiRTCAudioProcessor::processBlock(juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiMessages)
 {
-	
+	// Runs on the audio thread: no allocations, no locks, no logging in here.
+	// Incoming MIDI passes through untouched, carried messages are only copied into outboundQueue.
 	buffer.clear();
 
-	juce::MidiBuffer processedMidi;
+	const auto blockStartSample = samplesProcessed;
+	const auto blockMicros = nowMicros();
+	samplesProcessed += buffer.getNumSamples();
+
+	//lets the peer map our sample timestamps onto its own clock
+	AudioClockAnchor anchor;
+	anchor.sampleTime = blockStartSample;
+	anchor.micros = blockMicros;
+	anchor.sampleRate = sampleRateHz.load(std::memory_order_relaxed);
+	localAudioClock.store(anchor);
+
+	bool queuedEvents = false;
+
+	//nothing to encode until a channel is open, one atomic load
+	const bool isOpen = connectionState.isOpen();
 
 	for (const auto metadata : midiMessages)
 	{
-		auto message = metadata.getMessage();
-		const auto time = metadata.samplePosition;
+		if (!isOpen)
+			break;
 
-		if (message.isNoteOn())
-		{
-			//uint8 midiChannel = message.getMidiChannelMetaEventChannel();
-			uint8_t noteNumber = message.getNoteNumber();
-			uint8_t velocity = message.getVelocity();
+		// SysEx and meta events have no table entry and are not carried
+		const auto length = metadata.numBytes > 0 ? MidiCodec::getMessageLength(metadata.data[0]) : 0;
+
+		if (length == 0 || metadata.numBytes != length)
+			continue;
 
-			string valueDataString = to_string(runningNum) + to_string(noteNumber) + to_string(velocity);
+		MidiEventRecord event;
+		std::copy(metadata.data, metadata.data + length, event.data);
+		event.size = length;
+		event.timestamp = blockStartSample + metadata.samplePosition;
 
-			DBG(valueDataString);
+		//never blocks, a full queue only bumps the overflow counter
+		queuedEvents |= outboundQueue.push(event);
+	}
 
-			std::uint8_t crc = CRC::Calculate(valueDataString.c_str(), sizeof(valueDataString.c_str()), CRC::CRC_8());
+	//lets the sender flush this block as one packet without waiting for its deadline
+	completedBlocks.fetch_add(1, std::memory_order_release);
 
-			DBG(runningNum);
+	if (queuedEvents)
+		wakeSender();
 
-			messageData = {(byte)runningNum, (byte)noteNumber, (byte)velocity, (byte)crc};
-			
+	//after the outbound scan, so remote notes are not echoed back to the partner
+	renderReceivedEvents(midiMessages, blockStartSample, blockMicros, buffer.getNumSamples());
+}
 
-			sending = true;
+//move new arrivals into the jitter buffer and play what is due in this block, audio thread only
+void MidiRTCAudioProcessor::renderReceivedEvents(juce::MidiBuffer& midiMessages, juce::int64 blockStartSample,
+	juce::int64 blockMicros, int numSamples)
+{
+	if (numSamples <= 0)
+		return;
 
-			runningNum++;
+	JitterBuffer::Settings settings;
+	settings.mode = fixedJitterDelay.load(std::memory_order_relaxed) ? JitterBuffer::Mode::fixed : JitterBuffer::Mode::adaptive;
+	settings.minDelayMs = minJitterDelayMs.load(std::memory_order_relaxed);
+	settings.maxDelayMs = maxJitterDelayMs.load(std::memory_order_relaxed);
+	settings.fixedDelayMs = fixedJitterDelayMs.load(std::memory_order_relaxed);
+	jitterBuffer.setSettings(settings);
+	jitterBuffer.beginBlock(blockStartSample, numSamples);
 
-			if (runningNum == 250)
-			{
-				resetRunningNum();
-			}
+	// arrival times are mapped onto the sample clock relative to the start of this callback
+	const auto blockTicks = Time::getHighResolutionTicks();
+	const double samplesPerTick = localSampleRate / double(Time::getHighResolutionTicksPerSecond());
+	const double samplesPerMicro = localSampleRate / 1.0e6;
+
+	//every partner's events are placed with that partner's clock, all of them share the jitter buffer
+	std::array<ClockSync::Estimate, numSessionSlots> estimates;
+	std::array<bool, numSessionSlots> isSynced;
+
+	for (size_t slot = 0; slot < numSessionSlots; slot++)
+		isSynced[slot] = peerClocks[slot].getEstimate(estimates[slot]);
+
+	ReceivedMidiEvent event;
+
+	for (size_t i = 0; i < inboundQueue.getCapacity() && inboundQueue.pop(event); i++)
+	{
+		const auto arrivalSample = double(blockStartSample) - double(blockTicks - event.arrivalTicks) * samplesPerTick;
+		const auto slot = jmin(size_t(event.source), numSessionSlots - 1);
+
+		//the queue publishes the bump together with the first event of the slot's new partner
+		if (const auto generation = slotGenerations[slot].load(std::memory_order_relaxed); generation != renderedGenerations[slot])
+		{
+			renderedGenerations[slot] = generation;
+			jitterBuffer.resetSource(event.source);
 		}
 
-		processedMidi.addEvent(message, time);
+		if (isSynced[slot])
+		{
+			const auto sendMicros = ClockSync::remoteSampleToLocalMicros(estimates[slot], event.remoteTime);
+			jitterBuffer.pushSynced(event, arrivalSample, double(blockStartSample) + double(sendMicros - blockMicros) * samplesPerMicro);
+		}
+		else
+		{
+			jitterBuffer.push(event, arrivalSample);
+		}
 	}
-	/*
-	dc->onMessage([&, wdc = make_weak_ptr(dc)](variant<binary, string> data){
-		DBG("Receive: dc->onMessage");
 
-		if (const binary* temp = std::get_if<binary>(&data)) {
-			if (static_cast<uint8_t> ((*temp)[0]) == expRunNum) {
-				recreateMidiMessage(*temp);
-				expRunNum++;
-			}
-		}
+	//straight into the host's buffer, which the plugin wrappers reserve up front; it only allocates
+	//when a block carries more than they reserved
+	jitterBuffer.popDueEvents([&](const ReceivedMidiEvent& due, int position) {
+		midiMessages.addEvent(due.data, due.size, position);
 	});
-	*/
-	midiMessages.swapWith(processedMidi);
 }
 
 /*
@@ -14,20 +14,41 @@
 #include <parse_cl.h>
 #include <nlohmann/json.hpp>
 
+#include "MidiCodec.h"
+#include "ClockSync.h"
+#include "ConnectionRegistry.h"
+#include "ConnectionState.h"
+#include "ForwardErrorCorrection.h"
+#include "JitterBuffer.h"
+#include "MidiEventQueue.h"
+#include "PacketFramer.h"
+#include "PacketSink.h"
+#include "RecoveryJournal.h"
+#include "Retransmission.h"
+#include "SenderThread.h"
+#include "SignalingClient.h"
+#include "SequenceWindow.h"
+#include "TransportHub.h"
+
 //standard bibs c
 #include <algorithm>
+#include <array>
 #include <atomic>
 #include <chrono>
-#include <future>
+#include <functional>
 #include <iomanip>
 #include <iostream>
 #include <memory>
+#include <mutex>
 #include <random>
 #include <stdexcept>
 #include <thread>
 #include <unordered_map>
+#include <vector>
 
-class MidiRTCAudioProcessor  : public juce::AudioProcessor
+class MidiRTCAudioProcessor  : public juce::AudioProcessor,
+                               private juce::Timer,
+                               private TransportHub::Stream
 {
 public:
     float noteOnVel;
@@ -70,14 +91,124 @@ public:
 
     std::string getLocalId();
     std::string getPartnerId();
-    void setPartnerId(std::string partnerId);
+    void setPartnerId(std::string id);
+    //returns right away, the PeerConnection is set up on a background thread
     void connectToPartner();
+
+    //a session with several partners: each one gets its own PeerConnection, every batch is encoded
+    //once and sent to all of them, and what they send is merged into one stream. Partners that call
+    //in join too, up to maxSessionPeers; already connected ones are skipped. With the shared
+    //transport a stream has one partner, only the first id is used.
+    //Joining the id of a relay (see Relay/) sends every batch once to the relay, which forwards it
+    //to everybody else there; each of them takes a slot as "<relay id>#<participant>", up to
+    //maxRelayedPeers across all relays. Participants beyond that are not heard, see SenderStats
+    static constexpr size_t maxSessionPeers = 8;
+    static constexpr size_t maxRelayedPeers = 56;
+    static constexpr size_t numSessionSlots = maxSessionPeers + maxRelayedPeers;
+    static_assert(numSessionSlots <= JitterBuffer::maxSources, "a slot index has to fit ReceivedMidiEvent::source");
+    void joinSession(const std::vector<std::string>& partnerIds);
+
+    //partners with an open channel
+    std::vector<std::string> getSessionPeers();
     
-    bool isConnected() {
-        return connected;
-    };    
+    //lock-free, from any thread including the audio thread
+    bool isConnected() const {
+        return connectionState.isOpen();
+    };
+    ConnectionState::Snapshot getConnectionState() const {
+        return connectionState.getSnapshot();
+    };
+    std::int64_t getConnectionStateTime(ConnectionState::State state) const {
+        return connectionState.getTimeEntered(state);
+    };
+
+    //called after every state change, on whichever network thread made it
+    void setConnectionStateCallback(std::function<void(const ConnectionState::Snapshot&)> callback);
+
+    //connecting or ICE checking for longer than this fails the attempt
+    void setPeerConnectTimeout(int timeoutMs);
+
+    //messages processBlock could not queue because the sender fell behind
+    std::uint64_t getNumDroppedEvents() const {
+        return outboundQueue.getNumDropped();
+    };
+
+    //upper bound for one batched packet and how long its first event may wait for company
+    void setMaxPacketSize(size_t maxPacketSize);
+    void setFlushDeadline(std::chrono::microseconds flushDeadline);
+
+    //SCTP delivery of the DataChannel, takes effect with the next connectToPartner()
+    enum class ChannelMode {
+        reliableOrdered,
+        unreliable,         //unordered, no retransmissions
+        partiallyReliable   //unordered, retransmitted within packetLifetimeMs
+    };
+    void setChannelMode(ChannelMode mode, int packetLifetimeMs = 50);
+    ChannelMode getChannelMode() const {
+        return channelMode;
+    };
+
+    //XOR parity after every k batches, 0 = adapt k to the loss the partner reports
+    void setFecGroupSize(int groupSize);
+
+    //append recent note, controller and pitch bend state to every batch, see RecoveryJournal
+    void setRecoveryJournalEnabled(bool shouldBeEnabled);
+
+    //batches the partner NACKs are sent again while they are younger than this
+    void setRetransmitDeadline(int deadlineMs);
+
+    //running totals of the batching sender, bytes include parity packets
+    struct SenderStats {
+        std::uint64_t packetsSent = 0;
+        std::uint64_t eventsSent = 0;
+        std::uint64_t bytesSent = 0;
+        std::uint64_t parityPacketsSent = 0;
+        std::uint64_t retransmissions = 0;      //batches sent again on request
+        std::uint64_t nacksSent = 0;            //receive side, requests for missing batches
+        std::uint64_t packetsRecovered = 0;     //receive side, rebuilt from parity
+        std::uint64_t journalRecoveries = 0;    //receive side, gaps repaired from a journal
+        std::uint64_t relayedPeersDropped = 0;  //receive side, relayed participants left out of a full session
+    };
+    SenderStats getSenderStats() const;
+
+    //how long the sender thread takes from processBlock's wakeup to running and to sending,
+    //the shared one while the shared transport is used
+    SenderThread::Stats getSenderThreadStats() const;
+
+    //message thread: carry this instance as one stream of the process-wide TransportHub instead of
+    //its own signaling and PeerConnection; the partner's instance has to use the same stream id
+    //(0 = lowest free one). Switching drops the current connection, false if the id is taken
+    bool setSharedTransportEnabled(bool shouldShare, std::uint16_t streamId = 0);
+    bool isSharedTransportEnabled() const {
+        return sharedHub.load() != nullptr;
+    };
+    std::uint16_t getSharedStreamId() const {
+        return sharedStreamId;
+    };
 
-    std::uint8_t expRunNum = 0;
+    //batches accepted, duplicated, reordered, too late or still missing on the receive side,
+    //summed over the session's partners
+    SequenceWindow::Stats getReceiveStats();
+
+    //receive side playout, settings can be changed from any thread
+    void setJitterBufferSettings(const JitterBuffer::Settings& settings);
+    void setReportLatencyToHost(bool shouldReport);
+    double getJitterBufferDelayMs() const {
+        return jitterBuffer.getDelayMs();
+    };
+    JitterBuffer::Stats getJitterBufferStats() const {
+        return jitterBuffer.getStats();
+    };
+
+    //offset and round trip to the first partner that has one, false until a clock pong arrived
+    bool getClockSyncEstimate(ClockSync::Estimate& estimate) const;
+
+    //testing without a network (Tests/ProcessBlockAllocationTest.cpp): drops the transport and acts
+    //as if a channel were open, the sender thread hands every batch to sink, which has to outlive the
+    //processor. pushReceivedEvent() queues an event as if it had arrived in a batch; from one thread
+    //only, and only in loopback, where no partner produces into the same queue
+    void openLoopback(PacketSink& sink);
+    bool pushReceivedEvent(const ReceivedMidiEvent& event);
 
     //struct myMapValue{
     //    uint8_t myNoteNumber;
@@ -91,24 +222,162 @@ private:
     //std::future<void> wsFuture;
 
     //const String label;
-    std::uint8_t runningNum = 0;
-    bool connected = false;
-    bool sending = false;
+    std::uint32_t runningNum = 0;   //sender side only
+    ConnectionState connectionState;
+    bool setConnectionState(ConnectionState::State newState, ConnectionState::Reason reason);
+    bool setConnectionState(ConnectionState::State fromState, ConnectionState::State newState, ConnectionState::Reason reason);
+    void notifyConnectionState();
+    std::mutex stateCallbackMutex;
+    std::function<void(const ConnectionState::Snapshot&)> connectionStateCallback;
+    std::atomic<int> peerConnectTimeoutMs{ 15000 };
+
+    //audio thread -> DataChannel, single producer (processBlock), single consumer (sendQueuedEvents)
+    SpscQueue<MidiEventRecord, 1024> outboundQueue;
+    std::mutex senderMutex;
+    std::atomic<std::uint64_t> completedBlocks{ 0 };
+    std::atomic<std::uint32_t> sampleRateHz{ 44100 };
+    std::int64_t samplesProcessed = 0;  //host sample clock, audio thread only, survives prepareToPlay
+    size_t sendQueuedEvents(PacketSink& sink);
+
+    //the only thread outbound batches are sent from, processBlock wakes it after queueing events
+    SenderThread senderThread;
+    void wakeSender();
+    SenderThread::Clock::time_point sendPendingEvents();
+    SenderThread::Clock::time_point sendPendingEvents(PacketSink& sink, size_t& numSent);
+
+    //sender side, guarded by senderMutex
+    PacketBatcher batcher;
+    MidiEventRecord heldEvent;
+    bool hasHeldEvent = false;
+    std::uint64_t flushedBlocks = 0;
+    FecEncoder fecEncoder;
+    rtc::binary parityPacket;
+    JournalWriter journalWriter;
+    std::array<std::uint8_t, JournalWriter::maxSize> journalBuffer;
+    bool journalEnabled = false;
+    RetransmitBuffer retransmitBuffer;
+    std::atomic<int> retransmitDeadlineMs{ 80 };
+    void retransmitBatches(const std::uint8_t* nack, size_t size, PacketSink& sink);
+    void sendBatch(PacketSink& sink);
+    std::atomic<std::uint64_t> packetsSent{ 0 }, eventsSent{ 0 }, bytesSent{ 0 }, parityPacketsSent{ 0 }, retransmissions{ 0 };
     rtc::Configuration config;
-    std::weak_ptr<rtc::WebSocket> wws;
-    std::shared_ptr<rtc::WebSocket> ws;
     std::shared_ptr<rtc::DataChannel> dc;
-    std::shared_ptr<rtc::PeerConnection> createPeerConnection(const rtc::Configuration& config, 
-        std::weak_ptr<rtc::WebSocket> wws, std::string id);
+    ConnectionRegistry connections;     //this instance's peers only, closed with the processor
+    void startTransport();
+    void closeConnections();
+    std::shared_ptr<rtc::PeerConnection> createPeerConnection(const rtc::Configuration& config, std::string id);
+
+    //signaling and PeerConnection setup never run on the audio or message thread
+    SignalingClient signaling;
+    juce::ThreadPool networkJobs{ 1 };
+    void openConnection(const std::string& id);
+    void handleSignalingStatus(SignalingClient::Status status, const std::string& detail);
+    void handleSignalingMessage(const std::string& message);
+    void handlePeerState(rtc::PeerConnection::State state);
+    void handleChannelState(const std::string& id, bool isOpen);
+    static bool isValidPartnerId(const std::string& id, const std::string& localId);
     std::string localId;
-    std::string partnerId;
 
-    juce::MidiMessage recreateMidiMessage(rtc::binary messageData);
+    //written by the GUI and signaling, read from everywhere; replaced whole with
+    //atomic_store, readers atomic_load their own reference and keep it as long as they need it
+    std::shared_ptr<const std::string> partnerId = std::make_shared<const std::string>();
+    std::shared_ptr<const std::string> loadPartnerId() const;
+
+    std::atomic<ChannelMode> channelMode{ ChannelMode::reliableOrdered };
+    std::atomic<int> maxPacketLifetimeMs{ 50 };
+    rtc::DataChannelInit makeDataChannelInit() const;
+
+    //DataChannel callbacks -> audio thread, producers serialised by receiverMutex
+    SpscQueue<ReceivedMidiEvent, 1024> inboundQueue;
+    std::mutex receiverMutex;
+    std::atomic<std::uint64_t> packetsRecovered{ 0 }, journalRecoveries{ 0 }, nacksSent{ 0 }, relayedPeersDropped{ 0 };
+    bool handleIncomingPacket(const rtc::binary& packet, const std::string& fromId, PacketSink& sink);
+    bool handleMidiBatch(const rtc::binary& packet, const std::string& fromId, PacketSink& sink);
+    bool handleParityPacket(const rtc::binary& packet, const std::string& fromId);
+    bool handleRelayBundle(const rtc::binary& packet, const std::string& relayId, PacketSink& sink);
+    void renderReceivedEvents(juce::MidiBuffer& midiMessages, juce::int64 blockStartSample,
+        juce::int64 blockMicros, int numSamples);
+
+    //receive side of one partner, guarded by receiverMutex; the index of its slot tags the events
+    //it queues, so the audio thread maps them with that partner's clock
+    struct SessionPeer
+    {
+        std::string partnerId;
+        SequenceWindow receiveWindow;
+        FecDecoder fecDecoder;
+        JournalReader journalReader;
+        NackTracker nackTracker;
+        std::string relayId;                    //set for a partner reached through that relay
+        std::uint16_t relayParticipant = 0;     //its id at the relay
+        bool isRelay = false;                   //only forwards the others, plays nothing of its own
+        std::vector<std::uint16_t> droppedParticipants;     //of a relay, the ones that found no slot
+    };
+    std::array<std::unique_ptr<SessionPeer>, numSessionSlots> sessionPeers;     //nullptr = free slot
+    int findSessionSlot(const std::string& partnerId) const;
+    int getSessionSlot(const std::string& partnerId);
+    int joinSessionSlot(const std::string& partnerId, const std::string& relayId = {}, std::uint16_t relayParticipant = 0);
+    void leaveSessionSlot(const std::string& partnerId);
+    void dropRelayedParticipant(const std::string& relayId, std::uint16_t participant);
+    void forgetDroppedParticipant(const std::string& relayId, std::uint16_t participant);
+    bool queueMidiBatch(SessionPeer& peer, int slot, const rtc::binary& packet, juce::int64 arrivalTicks);
+    void queueRecoveredBatches(SessionPeer& peer, int slot, juce::int64 arrivalTicks);
+    bool hasOpenChannel() const;
+
+    //what each partner reports back, guarded by senderMutex; FEC follows the worst loss and the
+    //journal only forgets what every partner acknowledged
+    struct PeerFeedback
+    {
+        bool inSession = false;
+        double lossRate = 0.0;
+        bool hasJournalAck = false;
+        std::uint32_t journalAck = 0;
+    };
+    std::array<PeerFeedback, numSessionSlots> peerFeedback;
+    void applyPeerFeedback();
+
+    //sender thread only, the open channels of the current round
+    std::vector<std::shared_ptr<rtc::DataChannel>> fanOutChannels;
+    std::atomic<PacketSink*> loopbackSink{ nullptr };
+
+    //in-band clock sync with every partner, written under channelMutex, read lock-free
+    std::array<ClockSync, numSessionSlots> peerClocks;
+
+    //bumped when a slot gets a new partner, the audio thread then restarts that source in the jitter buffer
+    std::array<std::atomic<std::uint32_t>, numSessionSlots> slotGenerations{};
+    std::array<std::uint32_t, numSessionSlots> renderedGenerations{};      //audio thread only
+    AudioClockAnchorSlot localAudioClock;
+    std::mutex channelMutex;
+    static juce::int64 nowMicros();
+    void sendControlMessages();
+    double sendControlMessages(const std::string& toId, PacketSink& sink);
+
+    //audio thread owns the jitter buffer, the atomics carry settings in
+    JitterBuffer jitterBuffer;
+    double localSampleRate = 44100.0;
+    std::atomic<bool> fixedJitterDelay{ false };
+    std::atomic<double> minJitterDelayMs{ 2.0 }, maxJitterDelayMs{ 80.0 }, fixedJitterDelayMs{ 20.0 };
+    std::atomic<bool> reportLatencyToHost{ true };
+    void timerCallback() override;
+
+    //shared transport: sharedHub is what the other threads check. Turning it off releases the
+    //pointer once no wakeSender() is between loading sharedHub and waking it, the last instance
+    //to let go takes the hub's connections down with it
+    std::unique_ptr<juce::SharedResourcePointer<TransportHub>> sharedTransport;
+    std::atomic<TransportHub*> sharedHub{ nullptr };
+    std::atomic<int> wakersInFlight{ 0 };
+    void releaseSharedTransport();
+    std::uint16_t sharedStreamId = 0;
+
+    //TransportHub::Stream, on the hub's threads
+    SenderThread::Clock::time_point sendPendingPackets(PacketSink& sink) override;
+    void receivePacket(const rtc::binary& packet, PacketSink& sink) override;
+    void signalingStatusChanged(SignalingClient::Status status, const std::string& detail) override;
+    void peerStateChanged(rtc::PeerConnection::State state) override;
+    void channelStateChanged(bool isOpen) override;
+    void offerReceived(const std::string& partnerId) override;
+
     void setLocalId(std::string localId);
     void generateLocalId(size_t length);
-    void resetRunningNum() {
-        runningNum = 0;
-    };
 
     //std::map <uint8_t, myMapValue> compareMap;
     //==============================================================================
@@ -0,0 +1,210 @@
+/*
+  ==============================================================================
+
+    Recovery journal for MIDI batches.
+
+  ==============================================================================
+*/
+
+#include "RecoveryJournal.h"
+
+#include <algorithm>
+
+namespace
+{
+	//note on with velocity 0 is a note off, the journal only knows the latter
+	void normalise(std::uint8_t* message)
+	{
+		if ((message[0] & 0xf0) == 0x90 && message[2] == 0)
+			message[0] = std::uint8_t(0x80 | (message[0] & 0x0f));
+	}
+
+	bool isJournalled(MidiCodec::Kind kind)
+	{
+		return kind == MidiCodec::Kind::noteOn || kind == MidiCodec::Kind::noteOff
+			|| kind == MidiCodec::Kind::controller || kind == MidiCodec::Kind::pitchBend;
+	}
+
+	//two messages that describe the same piece of state, the newer one replaces the older
+	bool sameState(const std::uint8_t* a, const std::uint8_t* b)
+	{
+		if ((a[0] & 0x0f) != (b[0] & 0x0f))
+			return false;
+
+		const auto kindA = MidiCodec::getKind(a[0]);
+		const auto kindB = MidiCodec::getKind(b[0]);
+		const auto isNoteA = kindA == MidiCodec::Kind::noteOn || kindA == MidiCodec::Kind::noteOff;
+		const auto isNoteB = kindB == MidiCodec::Kind::noteOn || kindB == MidiCodec::Kind::noteOff;
+
+		if (isNoteA || isNoteB)
+			return isNoteA && isNoteB && a[1] == b[1];
+
+		if (kindA != kindB)
+			return false;
+
+		return kindA == MidiCodec::Kind::pitchBend || a[1] == b[1];
+	}
+}
+
+//==============================================================================
+void JournalWriter::recordBatch(const std::vector<std::byte>& packet)
+{
+	PacketFormat::BatchView batch;
+
+	if (!PacketFormat::readBatch(packet.data(), packet.size(), batch))
+		return;
+
+	PacketFormat::forEachMessage(batch, [&](const std::uint8_t* message, std::size_t length, std::uint32_t) {
+		record(message, length, batch.sequence);
+	});
+}
+
+void JournalWriter::record(const std::uint8_t* message, std::size_t size, std::uint32_t sequence)
+{
+	if (size != 3 || !isJournalled(MidiCodec::getKind(message[0])))
+		return;
+
+	Entry entry;
+	std::copy(message, message + size, entry.message);
+	entry.size = std::uint8_t(size);
+	entry.sequence = sequence;
+	normalise(entry.message);
+
+	auto end = entries.begin() + numEntries;
+	auto existing = std::find_if(entries.begin(), end,
+		[&](const Entry& e) { return sameState(e.message, entry.message); });
+
+	// the changed state moves to the back, when full the oldest entry makes room
+	if (existing == end && numEntries == maxEntries)
+		existing = entries.begin();
+
+	if (existing != end)
+		std::move(existing + 1, end, existing);
+	else
+		numEntries++;
+
+	entries[numEntries - 1] = entry;
+}
+
+void JournalWriter::acknowledge(std::uint32_t sequence)
+{
+	auto end = entries.begin() + numEntries;
+	auto kept = std::remove_if(entries.begin(), end,
+		[&](const Entry& e) { return std::int32_t(e.sequence - sequence) <= 0; });
+
+	numEntries = std::size_t(kept - entries.begin());
+}
+
+std::size_t JournalWriter::write(std::uint8_t* out) const
+{
+	if (numEntries == 0)
+		return 0;
+
+	std::size_t size = 1;
+	out[0] = std::uint8_t(numEntries);
+
+	for (std::size_t i = 0; i < numEntries; i++)
+	{
+		std::copy(entries[i].message, entries[i].message + entries[i].size, out + size);
+		size += entries[i].size;
+	}
+
+	return size;
+}
+
+void JournalWriter::reset()
+{
+	numEntries = 0;
+}
+
+//==============================================================================
+void JournalReader::observe(const std::uint8_t* message, std::size_t size)
+{
+	if (size != 3)
+		return;
+
+	const auto channel = message[0] & 0x0f;
+
+	switch (MidiCodec::getKind(message[0]))
+	{
+		case MidiCodec::Kind::noteOn:
+			noteVelocities[channel * 128 + message[1]] = message[2];
+			break;
+
+		case MidiCodec::Kind::noteOff:
+			noteVelocities[channel * 128 + message[1]] = 0;
+			break;
+
+		case MidiCodec::Kind::controller:
+			controllerValues[channel * 128 + message[1]] = message[2];
+			break;
+
+		case MidiCodec::Kind::pitchBend:
+			pitchBends[channel] = std::uint16_t(message[2] << 7 | message[1]);
+			break;
+
+		default:
+			break;
+	}
+}
+
+bool JournalReader::differsFromState(const std::uint8_t* message) const
+{
+	const auto channel = message[0] & 0x0f;
+
+	switch (MidiCodec::getKind(message[0]))
+	{
+		// a sounding note is only restarted if it was off, a retrigger would be audible
+		case MidiCodec::Kind::noteOn:
+			return message[2] != 0 && noteVelocities[channel * 128 + message[1]] == 0;
+
+		case MidiCodec::Kind::noteOff:
+			return noteVelocities[channel * 128 + message[1]] != 0;
+
+		case MidiCodec::Kind::controller:
+			return controllerValues[channel * 128 + message[1]] != message[2];
+
+		case MidiCodec::Kind::pitchBend:
+			return pitchBends[channel] != std::uint16_t(message[2] << 7 | message[1]);
+
+		default:
+			return false;
+	}
+}
+
+bool JournalReader::getNewestSequence(std::uint32_t& sequence) const
+{
+	sequence = newestSequence;
+	return hasNewest;
+}
+
+void JournalReader::reset()
+{
+	noteVelocities.fill(0);
+	controllerValues.fill(unknownValue);
+	pitchBends.fill(unknownPitchBend);
+	hasNewest = false;
+	hasRecovered = false;
+	numRecoveries = 0;
+}
+
+//==============================================================================
+void JournalAck::write(std::uint32_t sequence, std::uint8_t* out)
+{
+	out[0] = PacketFormat::journalAck;
+
+	for (int i = 0; i < 4; i++)
+		out[1 + i] = std::uint8_t(sequence >> (24 - 8 * i));
+
+	out[5] = PacketFormat::checksum(out, 5);
+}
+
+bool JournalAck::read(const std::uint8_t* bytes, std::size_t numBytes, std::uint32_t& sequence)
+{
+	if (numBytes != size || bytes[0] != PacketFormat::journalAck || PacketFormat::checksum(bytes, 5) != bytes[5])
+		return false;
+
+	sequence = std::uint32_t(bytes[1]) << 24 | std::uint32_t(bytes[2]) << 16
+		| std::uint32_t(bytes[3]) << 8 | std::uint32_t(bytes[4]);
+	return true;
+}
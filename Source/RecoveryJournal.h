@@ -0,0 +1,164 @@
+/*
+  ==============================================================================
+
+    Recovery journal for MIDI batches, in the spirit of the RTP-MIDI
+    recovery journal (RFC 6295), cut down to what this plugin sends.
+
+    Every batch can carry, after its events, the current state of whatever
+    changed since the last batch the peer acknowledged:
+
+        [entry count]{[encoded message]}...
+
+    An entry is a plain MIDI message: the latest note on/off of a note,
+    the latest value of a controller, the latest pitch bend of a channel.
+    When the receiver sees a gap in the sequence numbers it compares the
+    journal of the next batch with its own idea of the sender's state and
+    plays only the messages that differ, so a lost note off or controller
+    move is repaired one packet later instead of after a retransmission.
+
+    The writer keeps at most maxEntries entries (oldest dropped first) and
+    forgets entries once the peer acknowledged a batch at least as new:
+
+        ack: [type][sequence, 32 bit][crc8]
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "MidiCodec.h"
+#include "PacketFramer.h"
+
+class JournalWriter
+{
+public:
+    static constexpr std::size_t maxEntries = 32;
+    static constexpr std::size_t maxSize = 1 + maxEntries * MidiCodec::maxMessageLength;
+
+    //takes note of the notes, controllers and pitch bends of a batch that was just sent
+    void recordBatch(const std::vector<std::byte>& packet);
+
+    //the peer has the sender's state up to and including this batch
+    void acknowledge(std::uint32_t sequence);
+
+    //journal for the next batch, returns the number of bytes written to out (at most maxSize, 0 if empty)
+    std::size_t write(std::uint8_t* out) const;
+
+    std::size_t getNumEntries() const { return numEntries; }
+
+    void reset();
+
+private:
+    struct Entry
+    {
+        std::uint8_t message[MidiCodec::maxMessageLength] = {};
+        std::uint8_t size = 0;
+        std::uint32_t sequence = 0;
+    };
+
+    void record(const std::uint8_t* message, std::size_t size, std::uint32_t sequence);
+
+    //oldest first
+    std::array<Entry, maxEntries> entries;
+    std::size_t numEntries = 0;
+};
+
+class JournalReader
+{
+public:
+    enum class Result
+    {
+        play,           //in sequence, nothing to repair
+        recovered,      //batches were missing, the journal was used to repair the state
+        stale           //older than a gap the journal already repaired, don't play it
+    };
+
+    JournalReader() { reset(); }
+
+    //call for every batch the sequence window accepted, before its events;
+    //calls correction(const std::uint8_t* message, std::size_t length) per message needed to catch up
+    template <typename Callback>
+    Result handleBatch(const PacketFormat::BatchView& batch, Callback&& correction)
+    {
+        if (!hasNewest)
+        {
+            hasNewest = true;
+            newestSequence = batch.sequence;
+            return Result::play;
+        }
+
+        const auto ahead = std::int32_t(batch.sequence - newestSequence);
+
+        if (ahead <= 0)
+            return hasRecovered && std::int32_t(batch.sequence - recoveredThrough) <= 0 ? Result::stale : Result::play;
+
+        newestSequence = batch.sequence;
+
+        if (ahead == 1 || batch.journalSize == 0)
+            return Result::play;
+
+        std::uint8_t message[MidiCodec::maxMessageLength];
+        std::size_t offset = 1;
+
+        for (std::size_t i = 0; i < batch.journal[0]; i++)
+        {
+            const auto length = MidiCodec::decode(batch.journal + offset, batch.journalSize - offset, message);
+
+            if (length == 0)
+                break;
+
+            offset += length;
+
+            if (differsFromState(message))
+            {
+                observe(message, length);
+                correction(static_cast<const std::uint8_t*>(message), length);
+            }
+        }
+
+        hasRecovered = true;
+        recoveredThrough = batch.sequence - 1;
+        numRecoveries++;
+        return Result::recovered;
+    }
+
+    //call for every message that is played, keeps track of the sender's state
+    void observe(const std::uint8_t* message, std::size_t size);
+
+    //newest batch seen, false before the first one
+    bool getNewestSequence(std::uint32_t& sequence) const;
+
+    std::uint64_t getNumRecoveries() const { return numRecoveries; }
+
+    void reset();
+
+private:
+    bool differsFromState(const std::uint8_t* message) const;
+
+    static constexpr std::uint8_t unknownValue = 0xff;
+    static constexpr std::uint16_t unknownPitchBend = 0xffff;
+
+    //velocity of the sounding notes (0 = off), latest controller values and pitch bends per channel
+    std::array<std::uint8_t, 16 * 128> noteVelocities{};
+    std::array<std::uint8_t, 16 * 128> controllerValues{};
+    std::array<std::uint16_t, 16> pitchBends{};
+
+    bool hasNewest = false;
+    std::uint32_t newestSequence = 0;
+    bool hasRecovered = false;
+    std::uint32_t recoveredThrough = 0;
+    std::uint64_t numRecoveries = 0;
+};
+
+namespace JournalAck
+{
+    constexpr std::size_t size = 1 + 4 + 1;
+
+    void write(std::uint32_t sequence, std::uint8_t* out);
+    bool read(const std::uint8_t* bytes, std::size_t numBytes, std::uint32_t& sequence);
+}
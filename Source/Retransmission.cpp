@@ -0,0 +1,186 @@
+/*
+  ==============================================================================
+
+    NACK-driven selective retransmission of MIDI batches.
+
+  ==============================================================================
+*/
+
+#include "Retransmission.h"
+
+#include <algorithm>
+
+#include "PacketFramer.h"
+
+//==============================================================================
+std::size_t Nack::write(const Range* ranges, std::size_t numRanges, std::uint8_t* out)
+{
+	numRanges = std::min(numRanges, maxRanges);
+
+	out[0] = PacketFormat::nack;
+	out[1] = std::uint8_t(numRanges);
+	std::size_t size = 2;
+
+	for (std::size_t i = 0; i < numRanges; i++, size += 5)
+	{
+		for (int j = 0; j < 4; j++)
+			out[size + j] = std::uint8_t(ranges[i].first >> (24 - 8 * j));
+
+		out[size + 4] = ranges[i].count;
+	}
+
+	out[size] = PacketFormat::checksum(out, size);
+	return size + 1;
+}
+
+bool Nack::read(const std::uint8_t* bytes, std::size_t numBytes, std::array<Range, maxRanges>& ranges, std::size_t& numRanges)
+{
+	if (numBytes < 3 || bytes[0] != PacketFormat::nack || bytes[1] > maxRanges || numBytes != 2 + bytes[1] * 5u + 1)
+		return false;
+
+	if (PacketFormat::checksum(bytes, numBytes - 1) != bytes[numBytes - 1])
+		return false;
+
+	numRanges = bytes[1];
+
+	for (std::size_t i = 0; i < numRanges; i++)
+	{
+		const auto* range = bytes + 2 + i * 5;
+		ranges[i].first = std::uint32_t(range[0]) << 24 | std::uint32_t(range[1]) << 16
+			| std::uint32_t(range[2]) << 8 | std::uint32_t(range[3]);
+		ranges[i].count = range[4];
+	}
+
+	return true;
+}
+
+//==============================================================================
+void NackTracker::received(std::uint32_t sequence)
+{
+	if (!hasNewest)
+	{
+		hasNewest = true;
+		newestSequence = sequence;
+		return;
+	}
+
+	const auto ahead = std::int32_t(sequence - newestSequence);
+
+	if (ahead <= 0)
+	{
+		// a late or retransmitted batch fills its hole
+		for (std::size_t i = 0; i < numMissing; i++)
+		{
+			if (missing[i].sequence == sequence)
+			{
+				remove(i);
+				break;
+			}
+		}
+
+		return;
+	}
+
+	// only the newest maxTracked of a long gap are worth asking for
+	const auto gap = std::min(std::uint32_t(ahead - 1), std::uint32_t(maxTracked));
+
+	for (auto skipped = sequence - gap; skipped != sequence; skipped++)
+	{
+		if (numMissing == maxTracked)
+			remove(0);
+
+		missing[numMissing++] = { skipped, 0, {} };
+	}
+
+	newestSequence = sequence;
+}
+
+void NackTracker::forgetBefore(std::uint32_t sequence)
+{
+	auto end = missing.begin() + numMissing;
+	auto kept = std::remove_if(missing.begin(), end,
+		[&](const Missing& m) { return std::int32_t(m.sequence - sequence) < 0; });
+
+	numMissing = std::size_t(kept - missing.begin());
+}
+
+std::size_t NackTracker::makeNack(Clock::time_point now, std::uint8_t* out)
+{
+	std::array<Nack::Range, Nack::maxRanges> ranges;
+	std::size_t numRanges = 0;
+
+	for (std::size_t i = 0; i < numMissing;)
+	{
+		auto& entry = missing[i];
+
+		if (entry.numNacks == maxNacks && now - entry.lastNack >= retryInterval)
+		{
+			remove(i);
+			continue;
+		}
+
+		i++;
+
+		if (entry.numNacks == maxNacks || (entry.numNacks > 0 && now - entry.lastNack < retryInterval))
+			continue;
+
+		// entries are in sequence order, neighbours share a range
+		auto& last = ranges[numRanges > 0 ? numRanges - 1 : 0];
+
+		if (numRanges > 0 && last.first + last.count == entry.sequence && last.count < 0xff)
+			last.count++;
+		else if (numRanges < ranges.size())
+			ranges[numRanges++] = { entry.sequence, 1 };
+		else
+			break;
+
+		entry.numNacks++;
+		entry.lastNack = now;
+	}
+
+	return numRanges == 0 ? 0 : Nack::write(ranges.data(), numRanges, out);
+}
+
+void NackTracker::remove(std::size_t index)
+{
+	std::move(missing.begin() + index + 1, missing.begin() + numMissing, missing.begin() + index);
+	numMissing--;
+}
+
+void NackTracker::reset()
+{
+	numMissing = 0;
+	hasNewest = false;
+}
+
+//==============================================================================
+void RetransmitBuffer::store(const std::vector<std::byte>& packet, Clock::time_point now)
+{
+	std::uint32_t sequence = 0;
+
+	if (!PacketFormat::peekSequence(packet.data(), packet.size(), sequence))
+		return;
+
+	// assign() reuses the slot's allocation once the buffer went round
+	auto& slot = slots[sequence % capacity];
+	slot.valid = true;
+	slot.sequence = sequence;
+	slot.sentAt = now;
+	slot.packet.assign(packet.begin(), packet.end());
+}
+
+const std::vector<std::byte>* RetransmitBuffer::find(std::uint32_t sequence, Clock::time_point now, Clock::duration maxAge) const
+{
+	const auto& slot = slots[sequence % capacity];
+
+	if (!slot.valid || slot.sequence != sequence || now - slot.sentAt > maxAge)
+		return nullptr;
+
+	return &slot.packet;
+}
+
+void RetransmitBuffer::reset()
+{
+	for (auto& slot : slots)
+		slot.valid = false;
+}
@@ -0,0 +1,114 @@
+/*
+  ==============================================================================
+
+    NACK-driven selective retransmission of MIDI batches, for channels
+    that run without SCTP reliability.
+
+    The receiver notes every sequence number it skipped and asks for them
+    with a NACK listing ranges of missing batches:
+
+        [type][range count]{[first sequence, 32 bit][count]}...[crc8]
+
+    A missing batch is asked for again after the retry interval (about one
+    round trip), up to maxNacks times, then given up on.
+
+    The sender keeps the last few batches it sent and answers a NACK by
+    sending the requested ones again, unchanged, as long as they are younger
+    than the retransmit deadline. Anything older would arrive too late to
+    be played, so on long links losses simply expire.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace Nack
+{
+    using Clock = std::chrono::steady_clock;
+
+    struct Range
+    {
+        std::uint32_t first = 0;
+        std::uint8_t count = 0;
+    };
+
+    constexpr std::size_t maxRanges = 16;
+    constexpr std::size_t maxSize = 1 + 1 + maxRanges * 5 + 1;
+
+    //returns the number of bytes written to out
+    std::size_t write(const Range* ranges, std::size_t numRanges, std::uint8_t* out);
+    bool read(const std::uint8_t* bytes, std::size_t numBytes, std::array<Range, maxRanges>& ranges, std::size_t& numRanges);
+}
+
+class NackTracker
+{
+public:
+    using Clock = Nack::Clock;
+
+    static constexpr std::size_t maxTracked = 64;
+    static constexpr int maxNacks = 3;
+
+    void setRetryInterval(Clock::duration newRetryInterval) { retryInterval = newRetryInterval; }
+
+    //every batch that was accepted, gaps before it become missing
+    void received(std::uint32_t sequence);
+
+    //stop asking for anything older than this, e.g. because its state was recovered otherwise
+    void forgetBefore(std::uint32_t sequence);
+
+    //NACK for everything that is due, returns its size or 0 if nothing is; out needs Nack::maxSize bytes
+    std::size_t makeNack(Clock::time_point now, std::uint8_t* out);
+
+    void reset();
+
+private:
+    struct Missing
+    {
+        std::uint32_t sequence = 0;
+        int numNacks = 0;
+        Clock::time_point lastNack;
+    };
+
+    void remove(std::size_t index);
+
+    //oldest first
+    std::array<Missing, maxTracked> missing;
+    std::size_t numMissing = 0;
+
+    bool hasNewest = false;
+    std::uint32_t newestSequence = 0;
+    Clock::duration retryInterval = std::chrono::milliseconds(20);
+};
+
+class RetransmitBuffer
+{
+public:
+    using Clock = Nack::Clock;
+
+    static constexpr std::size_t capacity = 64;
+
+    //every batch right after it was sent
+    void store(const std::vector<std::byte>& packet, Clock::time_point now);
+
+    //the batch sent under this sequence, nullptr if it is no longer kept or older than maxAge
+    const std::vector<std::byte>* find(std::uint32_t sequence, Clock::time_point now, Clock::duration maxAge) const;
+
+    void reset();
+
+private:
+    struct Slot
+    {
+        bool valid = false;
+        std::uint32_t sequence = 0;
+        Clock::time_point sentAt;
+        std::vector<std::byte> packet;
+    };
+
+    std::array<Slot, capacity> slots;
+};
@@ -0,0 +1,283 @@
+/*
+  ==============================================================================
+
+    The network sender thread and the semaphore the audio thread wakes it
+    with.
+
+  ==============================================================================
+*/
+
+#include "SenderThread.h"
+
+#include <algorithm>
+
+#if defined(_WIN32)
+ #ifndef NOMINMAX
+  #define NOMINMAX
+ #endif
+ #include <windows.h>
+#elif defined(__APPLE__)
+ #include <dispatch/dispatch.h>
+ #include <pthread.h>
+#else
+ #include <cerrno>
+ #include <ctime>
+ #include <pthread.h>
+ #include <sched.h>
+ #include <semaphore.h>
+#endif
+
+//==============================================================================
+#if defined(_WIN32)
+struct LightweightSemaphore::Native
+{
+	Native() : handle(CreateSemaphoreW(nullptr, 0, MAXLONG, nullptr)) {}
+	~Native() { CloseHandle(handle); }
+
+	void signal() { ReleaseSemaphore(handle, 1, nullptr); }
+	void wait() { WaitForSingleObject(handle, INFINITE); }
+	bool tryWait() { return WaitForSingleObject(handle, 0) == WAIT_OBJECT_0; }
+
+	bool waitFor(std::int64_t micros)
+	{
+		return WaitForSingleObject(handle, DWORD((micros + 999) / 1000)) == WAIT_OBJECT_0;
+	}
+
+	HANDLE handle;
+};
+#elif defined(__APPLE__)
+struct LightweightSemaphore::Native
+{
+	Native() : semaphore(dispatch_semaphore_create(0)) {}
+	~Native() { dispatch_release(semaphore); }
+
+	void signal() { dispatch_semaphore_signal(semaphore); }
+	void wait() { dispatch_semaphore_wait(semaphore, DISPATCH_TIME_FOREVER); }
+	bool tryWait() { return dispatch_semaphore_wait(semaphore, DISPATCH_TIME_NOW) == 0; }
+
+	bool waitFor(std::int64_t micros)
+	{
+		return dispatch_semaphore_wait(semaphore, dispatch_time(DISPATCH_TIME_NOW, micros * 1000)) == 0;
+	}
+
+	dispatch_semaphore_t semaphore;
+};
+#else
+struct LightweightSemaphore::Native
+{
+	Native() { sem_init(&semaphore, 0, 0); }
+	~Native() { sem_destroy(&semaphore); }
+
+	void signal() { sem_post(&semaphore); }
+
+	void wait()
+	{
+		while (sem_wait(&semaphore) != 0 && errno == EINTR) {}
+	}
+
+	bool tryWait()
+	{
+		while (sem_trywait(&semaphore) != 0)
+		{
+			if (errno != EINTR)
+				return false;
+		}
+
+		return true;
+	}
+
+	//sem_timedwait takes an absolute CLOCK_REALTIME time
+	bool waitFor(std::int64_t micros)
+	{
+		timespec deadline;
+		clock_gettime(CLOCK_REALTIME, &deadline);
+		const auto nanos = std::int64_t(deadline.tv_nsec) + micros * 1000;
+		deadline.tv_sec += time_t(nanos / 1000000000);
+		deadline.tv_nsec = long(nanos % 1000000000);
+
+		while (sem_timedwait(&semaphore, &deadline) != 0)
+		{
+			if (errno != EINTR)
+				return false;
+		}
+
+		return true;
+	}
+
+	sem_t semaphore;
+};
+#endif
+
+//==============================================================================
+LightweightSemaphore::LightweightSemaphore()
+	: native(std::make_unique<Native>())
+{
+}
+
+LightweightSemaphore::~LightweightSemaphore() = default;
+
+void LightweightSemaphore::signalSleeper() noexcept
+{
+	native->signal();
+}
+
+void LightweightSemaphore::wait()
+{
+	waitAfterSpinning(-1);
+}
+
+bool LightweightSemaphore::waitFor(std::chrono::microseconds timeout)
+{
+	return waitAfterSpinning(std::max(std::int64_t(0), std::int64_t(timeout.count())));
+}
+
+//a short spin catches a signal that is already on its way without a system call,
+//then the count goes negative and the waiter sleeps on the native semaphore; timeoutMicros < 0 waits forever
+bool LightweightSemaphore::waitAfterSpinning(std::int64_t timeoutMicros)
+{
+	for (int spin = 0; spin < 256; spin++)
+	{
+		if (tryWait())
+			return true;
+
+		std::atomic_signal_fence(std::memory_order_acquire);
+	}
+
+	if (count.fetch_sub(1, std::memory_order_acquire) > 0)
+		return true;
+
+	if (timeoutMicros < 0)
+	{
+		native->wait();
+		return true;
+	}
+
+	if (timeoutMicros > 0 && native->waitFor(timeoutMicros))
+		return true;
+
+	// timed out: take back the decrement, unless a signal() already counted on it,
+	// in which case its native signal is on the way and has to be consumed
+	for (;;)
+	{
+		auto oldCount = count.load(std::memory_order_acquire);
+
+		if (oldCount >= 0 && native->tryWait())
+			return true;
+
+		if (oldCount < 0 && count.compare_exchange_strong(oldCount, oldCount + 1, std::memory_order_relaxed, std::memory_order_relaxed))
+			return false;
+	}
+}
+
+//==============================================================================
+namespace
+{
+	//above normal for the network, below what hosts give their audio threads; false if the system says no
+	bool raiseCurrentThreadPriority()
+	{
+#if defined(_WIN32)
+		return SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_HIGHEST) != 0;
+#elif defined(__APPLE__)
+		return pthread_set_qos_class_self_np(QOS_CLASS_USER_INTERACTIVE, 0) == 0;
+#else
+		sched_param param{};
+		param.sched_priority = std::min(sched_get_priority_min(SCHED_FIFO) + 10, sched_get_priority_max(SCHED_FIFO));
+		return pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) == 0;
+#endif
+	}
+}
+
+SenderThread::~SenderThread()
+{
+	stop();
+}
+
+void SenderThread::start(Work newWork, bool raisePriority)
+{
+	stop();
+
+	work = std::move(newWork);
+	shouldExit = false;
+	thread = std::thread([this, raisePriority] { run(raisePriority); });
+}
+
+void SenderThread::stop()
+{
+	if (!thread.joinable())
+		return;
+
+	shouldExit = true;
+	semaphore.signal();
+	thread.join();
+}
+
+void SenderThread::run(bool raisePriority)
+{
+	elevatedPriority = raisePriority && raiseCurrentThreadPriority();
+
+	while (!shouldExit.load(std::memory_order_acquire))
+	{
+		// cleared before the work runs: anything queued after this point signals again
+		signalPending.exchange(false, std::memory_order_acq_rel);
+		wokenForNanos = signalNanos.exchange(0, std::memory_order_relaxed);
+
+		if (wokenForNanos != 0)
+		{
+			const auto latency = nowNanos() - wokenForNanos;
+			wakeups.fetch_add(1, std::memory_order_relaxed);
+			totalWakeNanos.fetch_add(latency, std::memory_order_relaxed);
+
+			if (latency > maxWakeNanos.load(std::memory_order_relaxed))
+				maxWakeNanos.store(latency, std::memory_order_relaxed);
+		}
+
+		const auto wakeAt = work();
+
+		if (shouldExit.load(std::memory_order_acquire))
+			break;
+
+		if (wakeAt == Clock::time_point::max())
+		{
+			semaphore.wait();
+			continue;
+		}
+
+		const auto timeout = std::chrono::ceil<std::chrono::microseconds>(wakeAt - Clock::now());
+
+		if (timeout.count() > 0)
+			semaphore.waitFor(timeout);
+	}
+}
+
+void SenderThread::noteSent() noexcept
+{
+	if (wokenForNanos == 0)
+		return;
+
+	const auto latency = nowNanos() - wokenForNanos;
+	wokenForNanos = 0;
+
+	sends.fetch_add(1, std::memory_order_relaxed);
+	totalSendNanos.fetch_add(latency, std::memory_order_relaxed);
+
+	if (latency > maxSendNanos.load(std::memory_order_relaxed))
+		maxSendNanos.store(latency, std::memory_order_relaxed);
+}
+
+SenderThread::Stats SenderThread::getStats() const
+{
+	Stats stats;
+	stats.elevatedPriority = elevatedPriority.load(std::memory_order_relaxed);
+	stats.wakeups = wakeups.load(std::memory_order_relaxed);
+	stats.sends = sends.load(std::memory_order_relaxed);
+
+	if (stats.wakeups > 0)
+		stats.meanWakeMicros = double(totalWakeNanos.load(std::memory_order_relaxed)) / 1000.0 / double(stats.wakeups);
+
+	if (stats.sends > 0)
+		stats.meanSendMicros = double(totalSendNanos.load(std::memory_order_relaxed)) / 1000.0 / double(stats.sends);
+
+	stats.maxWakeMicros = double(maxWakeNanos.load(std::memory_order_relaxed)) / 1000.0;
+	stats.maxSendMicros = double(maxSendNanos.load(std::memory_order_relaxed)) / 1000.0;
+	return stats;
+}
@@ -0,0 +1,147 @@
+/*
+  ==============================================================================
+
+    The network sender thread and the semaphore the audio thread wakes it
+    with.
+
+    LightweightSemaphore keeps its count in an atomic and only falls back
+    to the operating system semaphore (a futex on Linux, a dispatch
+    semaphore on macOS, a kernel semaphore on Windows) when the waiter
+    actually has to sleep. signal() is a single atomic add, plus one system
+    call if the waiter is asleep; it never takes a mutex, never allocates
+    and never blocks, so it is safe to call from processBlock.
+
+    SenderThread runs a work function every time it is signalled or the
+    deadline that function returned has passed. Signals that arrive while
+    the work function runs are folded into one wakeup. The thread asks for
+    a raised scheduling priority when it starts, which the system may
+    refuse (e.g. real-time scheduling on Linux without rtkit or
+    RLIMIT_RTPRIO); the stats tell whether it got it.
+
+    Latency stats, from the audio thread's signal() to:
+
+        wake    the sender running again
+        send    noteSent(), i.e. the events being handed to the DataChannel
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <thread>
+
+class LightweightSemaphore
+{
+public:
+    LightweightSemaphore();
+    ~LightweightSemaphore();
+
+    LightweightSemaphore(const LightweightSemaphore&) = delete;
+    LightweightSemaphore& operator=(const LightweightSemaphore&) = delete;
+
+    //wait-free apart from waking a sleeping waiter
+    void signal() noexcept
+    {
+        if (count.fetch_add(1, std::memory_order_release) < 0)
+            signalSleeper();
+    }
+
+    bool tryWait() noexcept
+    {
+        auto oldCount = count.load(std::memory_order_relaxed);
+
+        while (oldCount > 0)
+        {
+            if (count.compare_exchange_weak(oldCount, oldCount - 1, std::memory_order_acquire, std::memory_order_relaxed))
+                return true;
+        }
+
+        return false;
+    }
+
+    void wait();
+
+    //false if the timeout passed without a signal
+    bool waitFor(std::chrono::microseconds timeout);
+
+private:
+    struct Native;
+
+    void signalSleeper() noexcept;
+    bool waitAfterSpinning(std::int64_t timeoutMicros);
+
+    std::atomic<int> count{ 0 };
+    std::unique_ptr<Native> native;
+};
+
+//==============================================================================
+class SenderThread
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    //runs on the sender thread after every wakeup, returns when to run again at the latest;
+    //Clock::time_point::max() sleeps until the next signal
+    using Work = std::function<Clock::time_point()>;
+
+    struct Stats
+    {
+        bool elevatedPriority = false;
+        std::uint64_t wakeups = 0;
+        std::uint64_t sends = 0;
+        double meanWakeMicros = 0.0;
+        double maxWakeMicros = 0.0;
+        double meanSendMicros = 0.0;
+        double maxSendMicros = 0.0;
+    };
+
+    SenderThread() = default;
+    ~SenderThread();
+
+    SenderThread(const SenderThread&) = delete;
+    SenderThread& operator=(const SenderThread&) = delete;
+
+    void start(Work work, bool raisePriority = true);
+    void stop();
+
+    //any thread, including the audio thread: wait-free, never blocks
+    void signal() noexcept
+    {
+        std::int64_t unstamped = 0;
+        signalNanos.compare_exchange_strong(unstamped, nowNanos(), std::memory_order_relaxed);
+
+        if (!signalPending.exchange(true, std::memory_order_acq_rel))
+            semaphore.signal();
+    }
+
+    //sender thread, from inside the work function once the events it was woken for went out
+    void noteSent() noexcept;
+
+    Stats getStats() const;
+
+private:
+    static std::int64_t nowNanos() noexcept
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count();
+    }
+
+    void run(bool raisePriority);
+
+    std::thread thread;
+    Work work;
+    LightweightSemaphore semaphore;
+    std::atomic<bool> signalPending{ false }, shouldExit{ false };
+
+    //time of the first signal since the sender last woke up, 0 = none
+    std::atomic<std::int64_t> signalNanos{ 0 };
+    std::int64_t wokenForNanos = 0;     //sender thread only
+
+    std::atomic<bool> elevatedPriority{ false };
+    std::atomic<std::uint64_t> wakeups{ 0 }, sends{ 0 };
+    std::atomic<std::int64_t> totalWakeNanos{ 0 }, maxWakeNanos{ 0 }, totalSendNanos{ 0 }, maxSendNanos{ 0 };
+};
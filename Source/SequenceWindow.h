@@ -0,0 +1,127 @@
+/*
+  ==============================================================================
+
+    Sliding-window duplicate and reorder detection for 32-bit sequence
+    numbers, in the style of the IPsec/SRTP replay window.
+
+    The window remembers which of the last windowSize sequence numbers below
+    the highest one have been seen, as a 128-bit bitmap that is shifted when
+    a newer packet arrives. Every sequence number is accepted exactly once;
+    anything older than the window is rejected as too late. Sequence numbers
+    are compared with serial number arithmetic, so wrapping is harmless.
+
+    check() is O(1) and never allocates.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <cstdint>
+
+class SequenceWindow
+{
+public:
+    static constexpr std::uint32_t windowSize = 128;
+
+    enum class Result
+    {
+        accepted,
+        duplicate,
+        tooOld
+    };
+
+    struct Stats
+    {
+        std::uint64_t accepted = 0;
+        std::uint64_t duplicates = 0;
+        std::uint64_t reordered = 0;    //accepted, but after a newer one
+        std::uint64_t tooOld = 0;       //fell out of the window before it arrived
+        std::uint64_t missing = 0;      //skipped sequence numbers that never turned up (yet)
+    };
+
+    Result check(std::uint32_t sequence) noexcept
+    {
+        if (!hasHighest)
+        {
+            hasHighest = true;
+            highest = sequence;
+            bits[0] = 1;
+            bits[1] = 0;
+            stats.accepted++;
+            return Result::accepted;
+        }
+
+        const auto ahead = std::int32_t(sequence - highest);
+
+        if (ahead > 0)
+        {
+            shift(std::uint32_t(ahead));
+            bits[0] |= 1;
+            highest = sequence;
+            stats.missing += std::uint32_t(ahead) - 1;
+            stats.accepted++;
+            return Result::accepted;
+        }
+
+        const auto behind = std::uint32_t(-std::int64_t(ahead));
+
+        if (behind >= windowSize)
+        {
+            stats.tooOld++;
+            return Result::tooOld;
+        }
+
+        auto& word = bits[behind / 64];
+        const auto mask = std::uint64_t(1) << (behind % 64);
+
+        if (word & mask)
+        {
+            stats.duplicates++;
+            return Result::duplicate;
+        }
+
+        word |= mask;
+        stats.accepted++;
+        stats.reordered++;
+
+        if (stats.missing > 0)
+            stats.missing--;
+
+        return Result::accepted;
+    }
+
+    const Stats& getStats() const noexcept { return stats; }
+
+    void reset() noexcept
+    {
+        hasHighest = false;
+        bits[0] = bits[1] = 0;
+        stats = {};
+    }
+
+private:
+    //bit i of the window stands for sequence number highest - i
+    void shift(std::uint32_t distance) noexcept
+    {
+        if (distance >= windowSize)
+        {
+            bits[0] = bits[1] = 0;
+        }
+        else if (distance >= 64)
+        {
+            bits[1] = bits[0] << (distance - 64);
+            bits[0] = 0;
+        }
+        else
+        {
+            bits[1] = (bits[1] << distance) | (bits[0] >> (64 - distance));
+            bits[0] <<= distance;
+        }
+    }
+
+    bool hasHighest = false;
+    std::uint32_t highest = 0;
+    std::uint64_t bits[2] = {};
+    Stats stats;
+};
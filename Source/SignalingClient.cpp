@@ -0,0 +1,183 @@
+/*
+  ==============================================================================
+
+    WebSocket connection to the signaling server, kept up in the
+    background.
+
+  ==============================================================================
+*/
+
+#include "SignalingClient.h"
+
+#include <algorithm>
+#include <variant>
+
+SignalingClient::~SignalingClient()
+{
+	disconnect();
+}
+
+void SignalingClient::connect(Settings newSettings)
+{
+	disconnect();
+
+	//connecting from here on, not only once the worker got to it, so getStatus() right after
+	//connect() doesn't look like there is nothing to do
+	const std::lock_guard<std::mutex> lock(mutex);
+	settings = std::move(newSettings);
+	shouldStop = false;
+	status = Status::connecting;
+	worker = std::thread([this] { run(); });
+}
+
+void SignalingClient::disconnect()
+{
+	{
+		const std::lock_guard<std::mutex> lock(mutex);
+		shouldStop = true;
+	}
+	wakeup.notify_all();
+
+	if (worker.joinable())
+		worker.join();
+}
+
+bool SignalingClient::send(const std::string& message)
+{
+	std::shared_ptr<rtc::WebSocket> connected;
+	{
+		const std::lock_guard<std::mutex> lock(mutex);
+
+		if (status == Status::connected)
+			connected = socket;
+	}
+
+	if (connected == nullptr)
+		return false;
+
+	try {
+		return connected->send(message);
+	}
+	catch (const std::exception&) {
+		return false;
+	}
+}
+
+SignalingClient::Status SignalingClient::getStatus() const
+{
+	const std::lock_guard<std::mutex> lock(mutex);
+	return status;
+}
+
+//WebSocket callbacks, any libdatachannel thread
+void SignalingClient::post(std::uint64_t socketGeneration, Event newEvent, const std::string& detail)
+{
+	{
+		const std::lock_guard<std::mutex> lock(mutex);
+
+		if (socketGeneration != generation || event == Event::error)
+			return;
+
+		event = newEvent;
+		eventDetail = detail;
+	}
+	wakeup.notify_all();
+}
+
+//mutex held on entry and exit, released around the callback
+void SignalingClient::report(std::unique_lock<std::mutex>& lock, Status newStatus, const std::string& detail)
+{
+	status = newStatus;
+
+	if (statusCallback == nullptr)
+		return;
+
+	lock.unlock();
+	statusCallback(newStatus, detail);
+	lock.lock();
+}
+
+//the socket may still be in one of its callbacks, which then finds a newer generation
+void SignalingClient::discard(const std::shared_ptr<rtc::WebSocket>& closing)
+{
+	if (closing == nullptr)
+		return;
+
+	closing->resetCallbacks();
+	closing->close();
+}
+
+void SignalingClient::run()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	int failedAttempts = 0;
+
+	while (!shouldStop)
+	{
+		auto next = std::make_shared<rtc::WebSocket>();
+		const auto socketGeneration = ++generation;
+		socket = next;
+		event = Event::none;
+
+		next->onOpen([this, socketGeneration] { post(socketGeneration, Event::opened); });
+		next->onClosed([this, socketGeneration] { post(socketGeneration, Event::closed); });
+		next->onError([this, socketGeneration](std::string error) { post(socketGeneration, Event::error, error); });
+		next->onMessage([this](std::variant<rtc::binary, std::string> data) {
+			if (const auto* message = std::get_if<std::string>(&data); message != nullptr && messageCallback != nullptr)
+				messageCallback(*message);
+		});
+
+		if (status != Status::retrying)
+			report(lock, Status::connecting, settings.url);
+
+		lock.unlock();
+
+		try {
+			next->open(settings.url);
+		}
+		catch (const std::exception& e) {
+			post(socketGeneration, Event::error, e.what());
+		}
+
+		lock.lock();
+
+		const auto opened = wakeup.wait_for(lock, settings.connectTimeout, [this] { return shouldStop || event != Event::none; })
+			&& event == Event::opened;
+
+		if (opened)
+		{
+			failedAttempts = 0;
+			report(lock, Status::connected, settings.url);
+
+			wakeup.wait(lock, [this] { return shouldStop || event == Event::closed || event == Event::error; });
+		}
+
+		const auto detail = shouldStop ? std::string() : !opened && event == Event::none ? std::string("timed out") : eventDetail;
+		socket = nullptr;
+		generation++;
+
+		lock.unlock();
+		discard(next);
+		lock.lock();
+
+		if (shouldStop)
+			break;
+
+		if (!opened)
+			failedAttempts++;
+
+		if (settings.maxRetries >= 0 && failedAttempts > settings.maxRetries)
+		{
+			report(lock, Status::failed, detail);
+			return;
+		}
+
+		// a dropped connection is reopened after retryDelay, every failed attempt doubles it
+		const auto delay = std::min(settings.maxRetryDelay, settings.retryDelay * (1 << std::min(failedAttempts, 16)));
+
+		report(lock, Status::retrying, detail);
+		wakeup.wait_for(lock, delay, [this] { return shouldStop; });
+	}
+
+	report(lock, Status::disconnected, {});
+}
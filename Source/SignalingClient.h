@@ -0,0 +1,105 @@
+/*
+  ==============================================================================
+
+    WebSocket connection to the signaling server, kept up in the
+    background.
+
+    connect() only hands the settings to a worker thread and returns. The
+    worker opens the WebSocket, gives up on an attempt after the connect
+    timeout, and retries with exponential backoff (retryDelay, doubled per
+    attempt up to maxRetryDelay) until maxRetries attempts in a row have
+    failed. A connection that drops later is reopened the same way.
+
+    Status changes are reported on the worker thread, messages on the
+    libdatachannel thread they arrive on. Both callbacks have to be set
+    before connect() and must not call connect() or disconnect().
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <rtc/rtc.hpp>
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+class SignalingClient
+{
+public:
+    enum class Status
+    {
+        disconnected,
+        connecting,     //first attempt
+        connected,
+        retrying,       //waiting for or in a later attempt
+        failed          //maxRetries attempts failed, connect() starts over
+    };
+
+    struct Settings
+    {
+        std::string url;
+        std::chrono::milliseconds connectTimeout{ 5000 };
+        int maxRetries = 8;                                 //-1 retries forever
+        std::chrono::milliseconds retryDelay{ 250 };
+        std::chrono::milliseconds maxRetryDelay{ 8000 };
+    };
+
+    using StatusCallback = std::function<void(Status status, const std::string& detail)>;
+    using MessageCallback = std::function<void(const std::string& message)>;
+
+    SignalingClient() = default;
+    ~SignalingClient();
+
+    SignalingClient(const SignalingClient&) = delete;
+    SignalingClient& operator=(const SignalingClient&) = delete;
+
+    void onStatus(StatusCallback callback) { statusCallback = std::move(callback); }
+    void onMessage(MessageCallback callback) { messageCallback = std::move(callback); }
+
+    //returns immediately with the status connecting, replaces any earlier connection
+    void connect(Settings newSettings);
+
+    //waits for the worker to close the WebSocket, which does not involve the network
+    void disconnect();
+
+    //false if not connected right now
+    bool send(const std::string& message);
+
+    Status getStatus() const;
+
+private:
+    enum class Event
+    {
+        none,
+        opened,
+        closed,
+        error
+    };
+
+    void run();
+    void post(std::uint64_t socketGeneration, Event event, const std::string& detail = {});
+    void report(std::unique_lock<std::mutex>& lock, Status newStatus, const std::string& detail);
+    static void discard(const std::shared_ptr<rtc::WebSocket>& socket);
+
+    Settings settings;
+    StatusCallback statusCallback;
+    MessageCallback messageCallback;
+
+    std::thread worker;
+    mutable std::mutex mutex;
+    std::condition_variable wakeup;
+
+    //guarded by mutex
+    bool shouldStop = false;
+    Status status = Status::disconnected;
+    std::shared_ptr<rtc::WebSocket> socket;
+    std::uint64_t generation = 0;       //callbacks of replaced sockets are ignored
+    Event event = Event::none;
+    std::string eventDetail;
+};
@@ -0,0 +1,47 @@
+/*
+  ==============================================================================
+
+    Several streams' packets in one DataChannel message.
+
+  ==============================================================================
+*/
+
+#include "StreamBundle.h"
+
+StreamBundler::StreamBundler(std::size_t maxSizeToUse, std::uint8_t typeToUse)
+	: maxSize(maxSizeToUse), type(typeToUse)
+{
+	bundle.reserve(maxSize);
+	clear();
+}
+
+bool StreamBundler::add(std::uint16_t streamId, const std::vector<std::byte>& packet)
+{
+	return add(streamId, packet.data(), packet.size());
+}
+
+bool StreamBundler::add(std::uint16_t streamId, const void* packet, std::size_t size)
+{
+	if (size > StreamBundle::maxPacketSize || numPackets == StreamBundle::maxPackets)
+		return false;
+
+	if (numPackets > 0 && bundle.size() + StreamBundle::entryHeaderSize + size > maxSize)
+		return false;
+
+	const auto* bytes = static_cast<const std::byte*>(packet);
+
+	bundle.push_back(std::byte(streamId >> 8));
+	bundle.push_back(std::byte(streamId & 0xff));
+	bundle.push_back(std::byte(size >> 8));
+	bundle.push_back(std::byte(size & 0xff));
+	bundle.insert(bundle.end(), bytes, bytes + size);
+
+	bundle[1] = std::byte(++numPackets);
+	return true;
+}
+
+void StreamBundler::clear()
+{
+	bundle.assign({ std::byte(type), std::byte(0) });
+	numPackets = 0;
+}
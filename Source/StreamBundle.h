@@ -0,0 +1,109 @@
+/*
+  ==============================================================================
+
+    Several streams' packets in one DataChannel message, for the shared
+    transport that carries many plugin instances over one PeerConnection.
+
+        [type][packet count]{[stream id, 16 bit][length, 16 bit][packet]}...
+
+    The relay (see Relay/) uses the same framing with its own type byte:
+    there the id is a participant, the sender on the way to a client and
+    the destination on the way to the relay.
+
+    Every packet is an unchanged processor packet (batch, parity, ping,
+    NACK, ...) with its own crc8, so the bundle adds no checksum of its own.
+    Multi-byte fields are big endian.
+
+    StreamBundler collects packets on the sending side until the bundle is
+    full; forEachPacket() takes a received bundle apart again and checks
+    the whole framing before it hands out the first packet.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "PacketFramer.h"
+
+namespace StreamBundle
+{
+    constexpr std::size_t headerSize = 2;
+    constexpr std::size_t entryHeaderSize = 4;
+    constexpr std::size_t maxPackets = 255;
+    constexpr std::size_t maxPacketSize = 0xffff;
+    constexpr std::size_t defaultMaxSize = 16384;
+
+    //the packets of a well-formed bundle of either type in order, false (and no callback) if it isn't one
+    template <typename Callback>
+    bool forEachPacket(const void* data, std::size_t size, Callback&& callback)
+    {
+        const auto* bytes = static_cast<const std::uint8_t*>(data);
+
+        if (size < headerSize || (bytes[0] != PacketFormat::streamBundle && bytes[0] != PacketFormat::relayBundle))
+            return false;
+
+        const std::size_t count = bytes[1];
+        std::size_t offset = headerSize;
+
+        for (std::size_t i = 0; i < count; i++)
+        {
+            if (size - offset < entryHeaderSize)
+                return false;
+
+            const std::size_t length = std::size_t(bytes[offset + 2]) << 8 | bytes[offset + 3];
+
+            if (size - offset - entryHeaderSize < length)
+                return false;
+
+            offset += entryHeaderSize + length;
+        }
+
+        if (offset != size)
+            return false;
+
+        offset = headerSize;
+
+        for (std::size_t i = 0; i < count; i++)
+        {
+            const auto streamId = std::uint16_t(bytes[offset] << 8 | bytes[offset + 1]);
+            const std::size_t length = std::size_t(bytes[offset + 2]) << 8 | bytes[offset + 3];
+
+            callback(streamId, bytes + offset + entryHeaderSize, length);
+            offset += entryHeaderSize + length;
+        }
+
+        return true;
+    }
+}
+
+class StreamBundler
+{
+public:
+    explicit StreamBundler(std::size_t maxSize = StreamBundle::defaultMaxSize,
+                           std::uint8_t type = PacketFormat::streamBundle);
+
+    void setMaxSize(std::size_t newMaxSize) { maxSize = newMaxSize; }
+
+    //false if the packet doesn't fit any more (send the bundle first); one that is bigger than
+    //the maximum bundle size still fits an empty bundle, only packets over 64 KB never do
+    bool add(std::uint16_t streamId, const std::vector<std::byte>& packet);
+    bool add(std::uint16_t streamId, const void* packet, std::size_t size);
+
+    bool isEmpty() const { return numPackets == 0; }
+    std::size_t getNumPackets() const { return numPackets; }
+
+    //valid until the next add()/clear()
+    const std::vector<std::byte>& getBundle() const { return bundle; }
+
+    void clear();
+
+private:
+    std::vector<std::byte> bundle;
+    std::size_t maxSize;
+    std::uint8_t type;
+    std::size_t numPackets = 0;
+};
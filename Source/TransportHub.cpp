@@ -0,0 +1,519 @@
+/*
+  ==============================================================================
+
+    Process-wide transport shared by the plugin instances.
+
+  ==============================================================================
+*/
+
+#include "TransportHub.h"
+#include "PeerSignaling.h"
+
+#include <algorithm>
+#include <random>
+
+//a stream's view of its link, packets are bundled with the stream id; an immediate sink sends every one right away
+class TransportHub::StreamSink : public PacketSink
+{
+public:
+	StreamSink(TransportHub& hubToUse, std::shared_ptr<Link> linkToUse, std::uint16_t streamIdToUse, bool isImmediate)
+		: hub(hubToUse), link(std::move(linkToUse)), streamId(streamIdToUse), immediate(isImmediate)
+	{
+	}
+
+	bool isOpen() const override
+	{
+		return TransportHub::isOpen(*link);
+	}
+
+	std::size_t getBufferedAmount() const override
+	{
+		const std::lock_guard<std::mutex> lock(link->mutex);
+		return link->channel != nullptr ? link->channel->bufferedAmount() : 0;
+	}
+
+	void send(const rtc::binary& packet) override
+	{
+		hub.append(*link, streamId, packet);
+
+		if (immediate)
+			hub.flush(*link);
+	}
+
+private:
+	TransportHub& hub;
+	std::shared_ptr<Link> link;
+	std::uint16_t streamId;
+	bool immediate;
+};
+
+//==============================================================================
+TransportHub::TransportHub()
+{
+	static const std::string characters("0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz");
+	localId.assign(4, '0');
+	std::default_random_engine rng(std::random_device{}());
+	std::uniform_int_distribution<int> dist(0, int(characters.size() - 1));
+	std::generate(localId.begin(), localId.end(), [&]() { return characters.at(dist(rng)); });
+
+	signaling.onStatus([this](SignalingClient::Status status, const std::string& detail) { handleSignalingStatus(status, detail); });
+	signaling.onMessage([this](const std::string& message) { handleSignalingMessage(message); });
+
+	senderThread.start([this] { return sendRound(); });
+}
+
+//instances remove their streams before they go, so nothing calls back into a plugin from here on
+TransportHub::~TransportHub()
+{
+	jobs.removeAllJobs(true, 2000);
+	signaling.disconnect();
+	senderThread.stop();
+	connections.closeAll();
+}
+
+//==============================================================================
+std::uint16_t TransportHub::addStream(Stream& stream, std::uint16_t streamId)
+{
+	{
+		const std::unique_lock<std::shared_mutex> lock(streamsMutex);
+
+		const auto isTaken = [&](std::uint16_t id) {
+			return std::any_of(streams.begin(), streams.end(), [id](const StreamEntry& entry) { return entry.id == id; });
+		};
+
+		if (streamId == 0)
+		{
+			streamId = 1;
+
+			while (isTaken(streamId))
+				if (++streamId == 0)
+					return 0;
+		}
+		else if (isTaken(streamId))
+		{
+			return 0;
+		}
+
+		streams.push_back({ &stream, streamId, {} });
+	}
+
+	//catch the stream up with a signaling connection an earlier stream started
+	if (signaling.getStatus() == SignalingClient::Status::connected)
+	{
+		stream.signalingStatusChanged(SignalingClient::Status::connecting, {});
+		stream.signalingStatusChanged(SignalingClient::Status::connected, {});
+	}
+
+	startSignaling();
+	return streamId;
+}
+
+void TransportHub::removeStream(Stream& stream)
+{
+	const std::unique_lock<std::shared_mutex> lock(streamsMutex);
+
+	streams.erase(std::remove_if(streams.begin(), streams.end(), [&](const StreamEntry& entry) { return entry.stream == &stream; }),
+		streams.end());
+}
+
+void TransportHub::setPartner(Stream& stream, const std::string& partnerId)
+{
+	const std::unique_lock<std::shared_mutex> lock(streamsMutex);
+
+	for (auto& entry : streams)
+		if (entry.stream == &stream)
+			entry.partnerId = partnerId;
+}
+
+void TransportHub::connect(Stream& stream, const rtc::DataChannelInit& channelInit)
+{
+	std::string partnerId;
+	{
+		const std::shared_lock<std::shared_mutex> lock(streamsMutex);
+
+		for (const auto& entry : streams)
+			if (entry.stream == &stream)
+				partnerId = entry.partnerId;
+	}
+
+	if (partnerId.empty() || partnerId == localId)
+		return;
+
+	jobs.addJob([this, &stream, partnerId, channelInit] { offer(stream, partnerId, channelInit); });
+}
+
+std::unique_ptr<PacketSink> TransportHub::makeSink(Stream& stream)
+{
+	const std::shared_lock<std::shared_mutex> lock(streamsMutex);
+
+	for (const auto& entry : streams)
+	{
+		if (entry.stream != &stream)
+			continue;
+
+		auto link = findLink(entry.partnerId);
+
+		if (link == nullptr || !isOpen(*link))
+			return nullptr;
+
+		return std::make_unique<StreamSink>(*this, std::move(link), entry.id, true);
+	}
+
+	return nullptr;
+}
+
+TransportHub::Stats TransportHub::getStats() const
+{
+	Stats stats;
+	{
+		const std::shared_lock<std::shared_mutex> lock(streamsMutex);
+		stats.numStreams = streams.size();
+	}
+
+	stats.numPeers = connections.getNumPeers();
+	stats.bundlesSent = bundlesSent.load(std::memory_order_relaxed);
+	stats.packetsSent = packetsSent.load(std::memory_order_relaxed);
+	stats.bytesSent = bytesSent.load(std::memory_order_relaxed);
+	stats.sender = senderThread.getStats();
+	return stats;
+}
+
+template <typename Visitor>
+void TransportHub::forEachStreamOf(const std::string& partnerId, Visitor&& visit)
+{
+	const std::shared_lock<std::shared_mutex> lock(streamsMutex);
+
+	for (const auto& entry : streams)
+		if (entry.partnerId == partnerId)
+			visit(*entry.stream);
+}
+
+//==============================================================================
+//sender thread: every stream with an open link adds what it has queued to its link's bundle,
+//then each bundle goes out as one message. Sleeps until woken or the earliest batch deadline
+SenderThread::Clock::time_point TransportHub::sendRound()
+{
+	auto wakeAt = SenderThread::Clock::time_point::max();
+	{
+		const std::shared_lock<std::shared_mutex> lock(streamsMutex);
+
+		for (const auto& entry : streams)
+		{
+			auto link = findLink(entry.partnerId);
+
+			if (link == nullptr || !isOpen(*link))
+				continue;
+
+			StreamSink sink(*this, link, entry.id, false);
+
+			try {
+				wakeAt = std::min(wakeAt, entry.stream->sendPendingPackets(sink));
+			}
+			catch (const std::exception& e) {
+				DBG("Send failed: " << e.what());
+			}
+
+			if (std::find(roundLinks.begin(), roundLinks.end(), link) == roundLinks.end())
+				roundLinks.push_back(std::move(link));
+		}
+	}
+
+	bool sentAny = false;
+
+	for (const auto& link : roundLinks)
+	{
+		try {
+			sentAny |= flush(*link);
+		}
+		catch (const std::exception& e) {
+			DBG("Send failed: " << e.what());
+		}
+	}
+
+	roundLinks.clear();
+
+	if (sentAny)
+		senderThread.noteSent();
+
+	return wakeAt;
+}
+
+void TransportHub::append(Link& link, std::uint16_t streamId, const rtc::binary& packet)
+{
+	const std::lock_guard<std::mutex> lock(link.mutex);
+
+	if (link.bundler.add(streamId, packet))
+		return;
+
+	//the bundle is full, send it and start the next one
+	if (link.channel != nullptr && link.channel->isOpen())
+	{
+		link.channel->send(link.bundler.getBundle());
+		bundlesSent.fetch_add(1, std::memory_order_relaxed);
+		packetsSent.fetch_add(link.bundler.getNumPackets(), std::memory_order_relaxed);
+		bytesSent.fetch_add(link.bundler.getBundle().size(), std::memory_order_relaxed);
+	}
+
+	link.bundler.clear();
+
+	//only a packet over 64 KB doesn't fit an empty bundle, the processor never makes one
+	link.bundler.add(streamId, packet);
+}
+
+//true if a bundle went out; a bundle for a channel that closed meanwhile is dropped
+bool TransportHub::flush(Link& link)
+{
+	const std::lock_guard<std::mutex> lock(link.mutex);
+
+	if (link.bundler.isEmpty())
+		return false;
+
+	if (link.channel == nullptr || !link.channel->isOpen())
+	{
+		link.bundler.clear();
+		return false;
+	}
+
+	try {
+		link.channel->send(link.bundler.getBundle());
+	}
+	catch (...) {
+		link.bundler.clear();
+		throw;
+	}
+
+	bundlesSent.fetch_add(1, std::memory_order_relaxed);
+	packetsSent.fetch_add(link.bundler.getNumPackets(), std::memory_order_relaxed);
+	bytesSent.fetch_add(link.bundler.getBundle().size(), std::memory_order_relaxed);
+	link.bundler.clear();
+	return true;
+}
+
+bool TransportHub::isOpen(Link& link)
+{
+	const std::lock_guard<std::mutex> lock(link.mutex);
+	return link.channel != nullptr && link.channel->isOpen();
+}
+
+std::shared_ptr<TransportHub::Link> TransportHub::findLink(const std::string& partnerId) const
+{
+	const std::lock_guard<std::mutex> lock(linksMutex);
+	const auto it = links.find(partnerId);
+	return it != links.end() ? it->second : nullptr;
+}
+
+std::shared_ptr<TransportHub::Link> TransportHub::getLink(const std::string& partnerId)
+{
+	const std::lock_guard<std::mutex> lock(linksMutex);
+	auto& link = links[partnerId];
+
+	if (link == nullptr)
+	{
+		link = std::make_shared<Link>();
+		link->partnerId = partnerId;
+	}
+
+	return link;
+}
+
+//==============================================================================
+//network job thread: one PeerConnection per partner, a stream that connects to a partner
+//another stream already reached is open right away; the others on that link are not told again
+void TransportHub::offer(Stream& stream, const std::string& partnerId, const rtc::DataChannelInit& channelInit)
+{
+	if (const auto link = findLink(partnerId); link != nullptr && isOpen(*link))
+	{
+		{
+			//the stream may have gone or changed partner since it asked
+			const std::shared_lock<std::shared_mutex> lock(streamsMutex);
+
+			for (const auto& entry : streams)
+				if (entry.stream == &stream && entry.partnerId == partnerId)
+					stream.channelStateChanged(true);
+		}
+
+		wake();
+		return;
+	}
+
+	if (const auto existing = connections.findPeer(partnerId))
+	{
+		const auto state = existing->state();
+
+		//an offer or answer for this partner is under way, its channel opens every stream
+		if (state == rtc::PeerConnection::State::New || state == rtc::PeerConnection::State::Connecting)
+			return;
+	}
+
+	DBG("Offering to " + partnerId);
+	auto pc = createPeerConnection(partnerId);
+	connections.setPeer(partnerId, pc);
+
+	auto dc = pc->createDataChannel("DC-hub", channelInit);
+	attachChannel(partnerId, dc, false);
+	connections.addChannel(partnerId, dc);
+}
+
+std::shared_ptr<rtc::PeerConnection> TransportHub::createPeerConnection(const std::string& partnerId)
+{
+	auto pc = PeerSignaling::createPeerConnection(config, partnerId,
+		[this](const std::string& message) { return signaling.send(message); });
+
+	pc->onStateChange([this, partnerId](rtc::PeerConnection::State state) {
+		forEachStreamOf(partnerId, [&](Stream& stream) { stream.peerStateChanged(state); });
+	});
+
+	pc->onDataChannel([this, partnerId](std::shared_ptr<rtc::DataChannel> dc) {
+		DBG("DataChannel from " + partnerId + " received with label \"" + dc->label() + "\"");
+		attachChannel(partnerId, dc, true);
+		connections.addChannel(partnerId, dc);
+	});
+
+	return pc;
+}
+
+void TransportHub::attachChannel(const std::string& partnerId, std::shared_ptr<rtc::DataChannel> channel, bool isOpenAlready)
+{
+	channel->setBufferedAmountLowThreshold(PacketSink::maxBufferedAmount);
+
+	channel->onOpen([this, partnerId] {
+		channelOpened(partnerId);
+	});
+
+	channel->onClosed([this, partnerId] {
+		DBG("DataChannel from " << partnerId << " closed");
+		forEachStreamOf(partnerId, [](Stream& stream) { stream.channelStateChanged(false); });
+	});
+
+	// Continue sending, whatever waited for room goes out with the next round
+	channel->onBufferedAmountLow([this] {
+		wake();
+	});
+
+	channel->onMessage([this, partnerId](std::variant<rtc::binary, std::string> data) {
+		if (const auto* bundle = std::get_if<rtc::binary>(&data))
+			receiveBundle(partnerId, *bundle);
+	});
+
+	{
+		const auto link = getLink(partnerId);
+		const std::lock_guard<std::mutex> lock(link->mutex);
+		link->channel = std::move(channel);
+		link->bundler.clear();
+	}
+
+	if (isOpenAlready)
+		channelOpened(partnerId);
+}
+
+void TransportHub::channelOpened(const std::string& partnerId)
+{
+	forEachStreamOf(partnerId, [](Stream& stream) { stream.channelStateChanged(true); });
+	wake();
+}
+
+//DataChannel thread: each packet goes to the stream with its id, their replies leave as one bundle
+void TransportHub::receiveBundle(const std::string& partnerId, const rtc::binary& bundle)
+{
+	const auto link = findLink(partnerId);
+
+	if (link == nullptr || bundle.empty() || bundle.front() != std::byte(PacketFormat::streamBundle))
+		return;
+
+	{
+		const std::shared_lock<std::shared_mutex> lock(streamsMutex);
+		rtc::binary packet;
+
+		StreamBundle::forEachPacket(bundle.data(), bundle.size(), [&](std::uint16_t streamId, const std::uint8_t* bytes, std::size_t length) {
+			const auto entry = std::find_if(streams.begin(), streams.end(), [&](const StreamEntry& candidate) {
+				return candidate.id == streamId && candidate.partnerId == partnerId;
+			});
+
+			if (entry == streams.end())
+				return;
+
+			const auto* first = reinterpret_cast<const std::byte*>(bytes);
+			packet.assign(first, first + length);
+			StreamSink reply(*this, link, streamId, false);
+
+			try {
+				entry->stream->receivePacket(packet, reply);
+			}
+			catch (const std::exception& e) {
+				DBG("Reply failed: " << e.what());
+			}
+		});
+	}
+
+	try {
+		flush(*link);
+	}
+	catch (const std::exception& e) {
+		DBG("Reply failed: " << e.what());
+	}
+}
+
+//==============================================================================
+void TransportHub::startSignaling()
+{
+	const auto status = signaling.getStatus();
+
+	if (status != SignalingClient::Status::disconnected && status != SignalingClient::Status::failed)
+		return;
+
+	SignalingClient::Settings settings;
+	settings.url = "ws://192.168.178.50:8080/" + localId;   // 192.168.178.50:8080 = k3h3pi address
+	signaling.connect(settings);
+}
+
+void TransportHub::handleSignalingStatus(SignalingClient::Status status, const std::string& detail)
+{
+	const std::shared_lock<std::shared_mutex> lock(streamsMutex);
+
+	for (const auto& entry : streams)
+		entry.stream->signalingStatusChanged(status, detail);
+}
+
+//offers, answers and candidates; an offer is answered if a stream asked for that partner,
+//with several instances in the process there is no telling which one an unknown caller meant
+void TransportHub::handleSignalingMessage(const std::string& text)
+{
+	PeerSignaling::Message message;
+
+	if (!PeerSignaling::parse(text, message) || message.partnerId == localId)
+		return;
+
+	auto pc = connections.findPeer(message.partnerId);
+
+	if (PeerSignaling::isOffer(message))
+	{
+		bool isExpected = false;
+		forEachStreamOf(message.partnerId, [&](Stream&) { isExpected = true; });
+
+		if (!isExpected)
+		{
+			DBG("No stream is set up for " + message.partnerId + ", offer ignored");
+			return;
+		}
+
+		if (pc == nullptr || pc->state() == rtc::PeerConnection::State::Failed || pc->state() == rtc::PeerConnection::State::Closed)
+		{
+			DBG("Answering to " + message.partnerId);
+
+			//replacing the connection detaches its channel before it could report closing
+			if (pc != nullptr)
+				forEachStreamOf(message.partnerId, [](Stream& stream) { stream.channelStateChanged(false); });
+
+			pc = createPeerConnection(message.partnerId);
+			connections.setPeer(message.partnerId, pc);
+		}
+
+		forEachStreamOf(message.partnerId, [&](Stream& stream) { stream.offerReceived(message.partnerId); });
+	}
+	else if (pc == nullptr)
+	{
+		return;
+	}
+
+	PeerSignaling::apply(*pc, message);
+}
@@ -0,0 +1,170 @@
+/*
+  ==============================================================================
+
+    Optional process-wide transport shared by every plugin instance in a
+    host that turns it on (see MidiRTCAudioProcessor::setSharedTransportEnabled).
+    Instances get it through juce::SharedResourcePointer<TransportHub>.
+
+    The hub owns one signaling connection and one local id for the
+    process, one PeerConnection and DataChannel per remote peer, and one
+    sender thread. Every instance registers a Stream with a 16-bit stream
+    id; the partner's instance for that part has to use the same id.
+
+    Each round the sender thread lets every stream whose peer is open
+    turn its queued events into packets, exactly as the processor would
+    for its own DataChannel, and collects them per peer into StreamBundle
+    messages. Instances that processed the same audio block end up in the
+    same DataChannel message, so ten tracks to one partner cost one ICE/
+    DTLS/SCTP session, one sender thread and one message per block rather
+    than ten.
+
+    Received bundles are taken apart and each packet is handed to the
+    stream with its id, replies (pongs, NACKs, retransmissions) go back
+    tagged with the same id.
+
+    Both ends of a connection have to use the shared transport, and an
+    offer is only answered for the streams whose partner is the caller.
+    The hub goes away with the last instance that lets go of it.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <rtc/rtc.hpp>
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <vector>
+
+#include "ConnectionRegistry.h"
+#include "PacketSink.h"
+#include "SenderThread.h"
+#include "SignalingClient.h"
+#include "StreamBundle.h"
+
+class TransportHub
+{
+public:
+    //one plugin instance's part of the shared transport, called on the hub's threads
+    class Stream
+    {
+    public:
+        virtual ~Stream() = default;
+
+        //sender thread: packets for whatever was queued since the last call,
+        //returns when to be called again at the latest (Clock::time_point::max() = when woken)
+        virtual SenderThread::Clock::time_point sendPendingPackets(PacketSink& sink) = 0;
+
+        //one of this stream's packets from the partner, replies go to sink
+        virtual void receivePacket(const rtc::binary& packet, PacketSink& sink) = 0;
+
+        virtual void signalingStatusChanged(SignalingClient::Status status, const std::string& detail) = 0;
+        virtual void peerStateChanged(rtc::PeerConnection::State state) = 0;
+        virtual void channelStateChanged(bool isOpen) = 0;
+
+        //a partner offered a connection to this stream
+        virtual void offerReceived(const std::string& partnerId) = 0;
+    };
+
+    struct Stats
+    {
+        std::size_t numStreams = 0;
+        std::size_t numPeers = 0;
+        std::uint64_t bundlesSent = 0;
+        std::uint64_t packetsSent = 0;      //stream packets inside the bundles
+        std::uint64_t bytesSent = 0;
+        SenderThread::Stats sender;
+    };
+
+    TransportHub();
+    ~TransportHub();
+
+    std::string getLocalId() const { return localId; }
+
+    //0 picks the lowest free id, returns the id used or 0 if the one asked for is taken;
+    //the first stream starts signaling
+    std::uint16_t addStream(Stream& stream, std::uint16_t streamId = 0);
+
+    //returns once no hub thread uses the stream any more
+    void removeStream(Stream& stream);
+
+    void setPartner(Stream& stream, const std::string& partnerId);
+
+    //offers a connection to the stream's partner unless there is one already, returns right away
+    void connect(Stream& stream, const rtc::DataChannelInit& channelInit);
+
+    //for packets outside the sender rounds (the timer's control messages), each one is sent at once;
+    //nullptr while the stream's partner isn't connected. Any thread but the audio thread
+    std::unique_ptr<PacketSink> makeSink(Stream& stream);
+
+    //audio thread, after queueing events
+    void wake() noexcept { senderThread.signal(); }
+
+    Stats getStats() const;
+
+private:
+    //what goes to one partner, kept for the lifetime of the hub; connections holds its PeerConnection
+    struct Link
+    {
+        std::string partnerId;
+        std::mutex mutex;       //channel and bundler
+        std::shared_ptr<rtc::DataChannel> channel;
+        StreamBundler bundler;
+    };
+
+    struct StreamEntry
+    {
+        Stream* stream = nullptr;
+        std::uint16_t id = 0;
+        std::string partnerId;
+    };
+
+    class StreamSink;
+
+    SenderThread::Clock::time_point sendRound();
+    void append(Link& link, std::uint16_t streamId, const rtc::binary& packet);
+    bool flush(Link& link);
+    static bool isOpen(Link& link);
+
+    std::shared_ptr<Link> findLink(const std::string& partnerId) const;
+    std::shared_ptr<Link> getLink(const std::string& partnerId);
+
+    void offer(Stream& stream, const std::string& partnerId, const rtc::DataChannelInit& channelInit);
+    std::shared_ptr<rtc::PeerConnection> createPeerConnection(const std::string& partnerId);
+    void attachChannel(const std::string& partnerId, std::shared_ptr<rtc::DataChannel> channel, bool isOpenAlready);
+    void channelOpened(const std::string& partnerId);
+    void receiveBundle(const std::string& partnerId, const rtc::binary& bundle);
+
+    void handleSignalingStatus(SignalingClient::Status status, const std::string& detail);
+    void handleSignalingMessage(const std::string& message);
+    void startSignaling();
+
+    //visits every stream with this partner, under the shared lock
+    template <typename Visitor>
+    void forEachStreamOf(const std::string& partnerId, Visitor&& visit);
+
+    std::string localId;
+    rtc::Configuration config;
+    SignalingClient signaling;
+    SenderThread senderThread;
+    juce::ThreadPool jobs{ 1 };     //offers, never on the caller's thread
+    ConnectionRegistry connections;
+
+    mutable std::shared_mutex streamsMutex;
+    std::vector<StreamEntry> streams;
+
+    mutable std::mutex linksMutex;
+    std::map<std::string, std::shared_ptr<Link>> links;
+    std::vector<std::shared_ptr<Link>> roundLinks;      //sender thread only
+
+    std::atomic<std::uint64_t> bundlesSent{ 0 }, packetsSent{ 0 }, bytesSent{ 0 };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (TransportHub)
+};
@@ -0,0 +1,112 @@
+/*
+  ==============================================================================
+
+    ConnectionState transitions: the usual path, the ones the table
+    refuses, and a session whose first partner fails before the channel
+    of another one opens.
+
+    Not part of the plugin build. From the repository root:
+
+        c++ -std=c++17 -O2 -ISource Tests/ConnectionStateTest.cpp Source/ConnectionState.cpp -o connection-state-test
+        ./connection-state-test
+
+    Prints every failed check and exits with 1 if there was one.
+
+  ==============================================================================
+*/
+
+#include "ConnectionState.h"
+
+#include <cstdio>
+
+namespace
+{
+	using State = ConnectionState::State;
+	using Reason = ConnectionState::Reason;
+
+	int numFailures = 0;
+
+	void check(bool condition, const char* what)
+	{
+		if (!condition)
+		{
+			std::printf("FAILED: %s\n", what);
+			numFailures++;
+		}
+	}
+
+	void testUsualPath()
+	{
+		ConnectionState link;
+		std::int64_t now = 1000;
+
+		check(link.transition(State::signaling, Reason::signalingStarted, now++), "idle -> signaling");
+		check(link.transition(State::ready, Reason::signalingOpened, now++), "signaling -> ready");
+		check(link.transition(State::connecting, Reason::offerSent, now++), "ready -> connecting");
+		check(link.transition(State::iceChecking, Reason::iceChecking, now++), "connecting -> iceChecking");
+		check(link.transition(State::open, Reason::channelOpened, now), "iceChecking -> open");
+		check(link.isOpen(), "open is open");
+		check(link.getTimeEntered(State::open) == now, "time of entering open");
+
+		check(link.transition(State::degraded, Reason::highLoss, ++now), "open -> degraded");
+		check(link.isOpen(), "degraded is open");
+		check(link.transition(State::open, Reason::lossRecovered, ++now), "degraded -> open");
+		check(link.transition(State::ready, Reason::channelClosed, ++now), "open -> ready");
+		check(!link.isOpen(), "ready is not open");
+		check(link.getNumTransitions() == 8, "number of transitions");
+
+		const auto snapshot = link.getSnapshot();
+		check(snapshot.state == State::ready && snapshot.reason == Reason::channelClosed && snapshot.sinceMicros == now,
+			"snapshot after the last transition");
+	}
+
+	void testRefused()
+	{
+		for (std::size_t i = 0; i < ConnectionState::numStates; i++)
+			check(!ConnectionState::isAllowed(State(i), State(i)), "no state leads to itself");
+
+		ConnectionState link;
+		check(!link.transition(State::open, Reason::channelOpened, 1), "idle -> open is refused");
+		check(!link.transition(State::ready, State::signaling, Reason::signalingClosed, 1), "transition out of a state it isn't in");
+		check(link.getState() == State::idle, "refused transitions leave the state alone");
+
+		//a released processor stays closed, whatever its old connections report later
+		check(link.transition(State::closed, Reason::released, 2), "idle -> closed");
+		check(!link.transition(State::open, Reason::channelOpened, 3), "closed -> open is refused");
+		check(!link.transition(State::iceChecking, Reason::iceChecking, 3), "closed -> iceChecking is refused");
+		check(link.getState() == State::closed, "still closed");
+	}
+
+	//two partners: the first one's ICE fails before anything is open, then the second one's channel opens
+	void testFailedPartnerThenOpen()
+	{
+		ConnectionState link;
+		link.transition(State::signaling, Reason::signalingStarted, 1);
+		link.transition(State::ready, Reason::signalingOpened, 2);
+		link.transition(State::connecting, Reason::offerSent, 3);
+		link.transition(State::iceChecking, Reason::iceChecking, 4);
+
+		check(link.transition(State::failed, Reason::iceFailed, 5), "iceChecking -> failed");
+		check(!link.isOpen(), "failed is not open");
+		check(link.transition(State::open, Reason::channelOpened, 6), "failed -> open when another partner's channel opens");
+		check(link.isOpen(), "open again after failed");
+
+		//the same after a connect timeout, which only leaves connecting or iceChecking
+		ConnectionState timedOut;
+		timedOut.transition(State::connecting, Reason::offerSent, 1);
+		check(timedOut.transition(State::connecting, State::failed, Reason::timedOut, 2), "connecting -> failed on timeout");
+		check(timedOut.transition(State::open, Reason::channelOpened, 3), "failed -> open after a timeout");
+	}
+}
+
+int main()
+{
+	testUsualPath();
+	testRefused();
+	testFailedPartnerThenOpen();
+
+	if (numFailures == 0)
+		std::printf("All ConnectionState checks passed\n");
+
+	return numFailures == 0 ? 0 : 1;
+}
@@ -0,0 +1,238 @@
+/*
+  ==============================================================================
+
+    JitterBuffer with several senders: two partners whose sample clocks
+    are far apart and run at different rates, and a slot that is taken
+    over by a new partner with a clock of its own. Every event has to be
+    played on time, a little after it arrived, whatever the other
+    sender's clock says. Events that are due at the same sample have to
+    come out in the order they arrived in.
+
+    Not part of the plugin build. From the repository root:
+
+        c++ -std=c++17 -O2 -ISource Tests/JitterBufferTest.cpp Source/JitterBuffer.cpp -o jitter-buffer-test
+        ./jitter-buffer-test
+
+    Prints every failed check and exits with 1 if there was one.
+
+  ==============================================================================
+*/
+
+#include "JitterBuffer.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <map>
+#include <utility>
+#include <vector>
+
+namespace
+{
+	constexpr double sampleRate = 48000.0;
+	constexpr int blockSize = 256;
+
+	int numFailures = 0;
+
+	void check(bool condition, const char* what)
+	{
+		if (!condition)
+		{
+			std::printf("FAILED: %s\n", what);
+			numFailures++;
+		}
+	}
+
+	//one partner sending a note every interval, over a network with a constant transit time
+	struct Sender
+	{
+		std::uint8_t source = 0;
+		std::uint32_t remoteSampleRate = 48000;
+		std::uint32_t remoteStart = 0;          //its sample clock when the local one is at 0
+		double transitSamples = 0.0;
+		double firstSend = 0.0;                 //local sample time, the run is [firstSend, lastSend)
+		double lastSend = 0.0;
+		double interval = 480.0;
+	};
+
+	struct Arrival
+	{
+		double sample = 0.0;
+		ReceivedMidiEvent event;
+	};
+
+	struct Result
+	{
+		std::size_t numSent = 0;
+		std::size_t numPlayed = 0;
+		double maxWait = 0.0;                   //from arrival to playout, in samples
+		JitterBuffer::Stats stats;
+	};
+
+	std::vector<Arrival> makeArrivals(const std::vector<Sender>& senders)
+	{
+		std::vector<Arrival> arrivals;
+
+		for (const auto& sender : senders)
+		{
+			const auto ratio = double(sender.remoteSampleRate) / sampleRate;
+
+			for (double send = sender.firstSend; send < sender.lastSend; send += sender.interval)
+			{
+				Arrival arrival;
+				arrival.sample = send + sender.transitSamples;
+				arrival.event.data[0] = 0x90;
+				arrival.event.data[1] = 60;
+				arrival.event.data[2] = 100;
+				arrival.event.size = 3;
+				arrival.event.source = sender.source;
+				arrival.event.remoteTime = sender.remoteStart + std::uint32_t(send * ratio);
+				arrival.event.remoteSampleRate = sender.remoteSampleRate;
+				arrivals.push_back(arrival);
+			}
+		}
+
+		std::stable_sort(arrivals.begin(), arrivals.end(),
+			[](const Arrival& a, const Arrival& b) { return a.sample < b.sample; });
+
+		return arrivals;
+	}
+
+	//blocks run until everything had time to play; resetAt restarts a source once the block reaches that sample
+	Result run(const std::vector<Sender>& senders, double duration, double resetAt = -1.0, std::uint8_t resetSource = 0)
+	{
+		const auto arrivals = makeArrivals(senders);
+		std::map<std::pair<std::uint8_t, std::uint32_t>, double> arrivalOf;
+
+		for (const auto& arrival : arrivals)
+			arrivalOf[{ arrival.event.source, arrival.event.remoteTime }] = arrival.sample;
+
+		JitterBuffer buffer;
+		buffer.prepare(sampleRate);
+
+		Result result;
+		result.numSent = arrivals.size();
+		std::size_t next = 0;
+
+		for (std::int64_t blockStart = 0; double(blockStart) < duration; blockStart += blockSize)
+		{
+			if (resetAt >= 0.0 && double(blockStart) >= resetAt)
+			{
+				buffer.resetSource(resetSource);
+				resetAt = -1.0;
+			}
+
+			buffer.beginBlock(blockStart, blockSize);
+
+			//whatever arrived during the previous block is picked up at the start of this one
+			for (; next < arrivals.size() && arrivals[next].sample <= double(blockStart); next++)
+				buffer.push(arrivals[next].event, arrivals[next].sample);
+
+			buffer.popDueEvents([&](const ReceivedMidiEvent& event, int position) {
+				const auto wait = double(blockStart + position) - arrivalOf[{ event.source, event.remoteTime }];
+				result.maxWait = std::max(result.maxWait, wait);
+				result.numPlayed++;
+			});
+		}
+
+		result.stats = buffer.getStats();
+		return result;
+	}
+
+	//far apart clocks: the second one is half the 32 bit range ahead and counts at 44.1 kHz
+	void testOffsetClocks()
+	{
+		Sender near;
+		near.source = 0;
+		near.remoteStart = 1000;
+		near.transitSamples = 240.0;
+		near.lastSend = 2.0 * sampleRate;
+
+		Sender far = near;
+		far.source = 1;
+		far.remoteSampleRate = 44100;
+		far.remoteStart = 0x80000000u + 12345;
+		far.transitSamples = 960.0;
+		far.interval = 357.0;
+
+		const auto result = run({ near, far }, 3.0 * sampleRate);
+
+		check(result.numPlayed == result.numSent, "offset clocks: every event is played");
+		check(result.stats.lateEvents == 0, "offset clocks: nothing is late");
+		check(result.maxWait <= 2.0 * blockSize + 0.002 * sampleRate, "offset clocks: played within the minimum delay after arrival");
+		check(result.stats.jitterMs < 0.1, "offset clocks: constant transit is no jitter");
+	}
+
+	//slot 0 changes hands: the new partner's clock is far behind the old one's, against the old base transit
+	//its events would all look late
+	void testSourceTakenOver()
+	{
+		Sender first;
+		first.source = 0;
+		first.remoteStart = 5000000;
+		first.transitSamples = 240.0;
+		first.lastSend = 1.0 * sampleRate;
+
+		Sender second = first;
+		second.remoteStart = 0;
+		second.firstSend = 1.25 * sampleRate;
+		second.lastSend = 2.5 * sampleRate;
+
+		const auto result = run({ first, second }, 3.5 * sampleRate, 1.1 * sampleRate, 0);
+
+		check(result.numPlayed == result.numSent, "taken over: every event is played");
+		check(result.stats.lateEvents == 0, "taken over: the new partner starts from its own transit");
+		check(result.maxWait <= 2.0 * blockSize + 0.002 * sampleRate, "taken over: played within the minimum delay after arrival");
+	}
+
+	//a retrigger sends note-off and note-on with the same time stamp, a chord many notes; the heap alone
+	//would hand out equal playout times in any order
+	void testEqualPlayoutTimes()
+	{
+		JitterBuffer buffer;
+		buffer.prepare(sampleRate);
+
+		std::vector<std::uint8_t> sent, played;
+		std::int64_t blockStart = 0;
+
+		for (int chord = 0; chord < 4; chord++, blockStart += blockSize)
+		{
+			buffer.beginBlock(blockStart, blockSize);
+
+			for (std::uint8_t note = 0; note < 24; note++)
+			{
+				ReceivedMidiEvent event;
+				event.data[0] = note % 2 == 0 ? 0x80 : 0x90;
+				event.data[1] = std::uint8_t(chord * 24 + note);
+				event.data[2] = note % 2 == 0 ? 0 : 100;
+				event.size = 3;
+				event.remoteTime = std::uint32_t(1000 + chord * blockSize);
+				event.remoteSampleRate = std::uint32_t(sampleRate);
+				buffer.push(event, double(blockStart));
+				sent.push_back(event.data[1]);
+			}
+
+			buffer.popDueEvents([&](const ReceivedMidiEvent& event, int) { played.push_back(event.data[1]); });
+		}
+
+		for (; blockStart < std::int64_t(sampleRate); blockStart += blockSize)
+		{
+			buffer.beginBlock(blockStart, blockSize);
+			buffer.popDueEvents([&](const ReceivedMidiEvent& event, int) { played.push_back(event.data[1]); });
+		}
+
+		check(played.size() == sent.size(), "equal times: every event is played");
+		check(played == sent, "equal times: events due at the same sample keep their arrival order");
+	}
+}
+
+int main()
+{
+	testOffsetClocks();
+	testSourceTakenOver();
+	testEqualPlayoutTimes();
+
+	if (numFailures == 0)
+		std::printf("All JitterBuffer checks passed\n");
+
+	return numFailures == 0 ? 0 : 1;
+}
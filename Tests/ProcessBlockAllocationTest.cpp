@@ -0,0 +1,260 @@
+/*
+  ==============================================================================
+
+    Checks that processBlock neither allocates nor frees: the global
+    operator new and delete count every call made on the thread that
+    runs processBlock while a block is being processed. Network and
+    message threads allocate as they like and are not counted.
+
+    Every block carries note ons, note offs and controllers at different
+    positions and a pitch bend, in a MidiBuffer reserved up front the way
+    JUCE's plugin wrappers reserve theirs.
+
+    Without --partner no network is needed: the processor runs in loopback
+    (openLoopback), so every block is queued and the sender thread encodes
+    it into batches for a sink that only counts them, and before each block
+    the test queues a partner's note on and note off as if they had
+    arrived, so the jitter buffer plays them into the block. With
+    --partner ID the test first waits for a channel to that instance
+    (through the signaling server the plugin is configured for) and then
+    sends every block to it and plays what comes back, in real time.
+
+    Not part of the plugin build. Needs JUCE and the plugin's sources:
+    add a Console Application with the modules and the JucePlugin_
+    preprocessor definitions of MidiRTC.jucer, all of Source/ and this
+    file, and link libdatachannel. Then:
+
+        ./processblock-allocation-test [--blocks N] [--block-size N] [--partner ID]
+
+    Prints one CSV row:
+
+        blocks,block_size,transport,allocations,frees,packets_sent,events_played
+
+    transport is loopback, partner or none (the partner could not be
+    reached). Exits with 1 if processBlock allocated or freed anything, or
+    if in loopback nothing was sent or played.
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+
+#include "PluginProcessor.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+#include <thread>
+
+namespace
+{
+	thread_local bool isCounting = false;
+	std::atomic<std::uint64_t> numAllocations{ 0 }, numFrees{ 0 };
+
+	struct Options
+	{
+		int numBlocks = 20000;
+		int blockSize = 256;
+		std::string partnerId;
+	};
+
+	//only around processBlock, everything the test itself does stays uncounted
+	struct ScopedCounting
+	{
+		ScopedCounting() { isCounting = true; }
+		~ScopedCounting() { isCounting = false; }
+	};
+
+	//stands in for the DataChannel, on the sender thread
+	class LoopbackSink : public PacketSink
+	{
+	public:
+		bool isOpen() const override { return true; }
+		std::size_t getBufferedAmount() const override { return 0; }
+
+		void send(const rtc::binary&) override { numPackets.fetch_add(1, std::memory_order_relaxed); }
+
+		std::atomic<std::uint64_t> numPackets{ 0 };
+	};
+
+	void fillBlock(juce::MidiBuffer& midi, int block, int blockSize)
+	{
+		midi.clear();
+
+		const auto note = 36 + block % 48;
+		midi.addEvent(juce::MidiMessage::noteOn(1, note, juce::uint8(100)), 0);
+		midi.addEvent(juce::MidiMessage::controllerEvent(1, 1, block % 128), blockSize / 3);
+		midi.addEvent(juce::MidiMessage::pitchWheel(1, (block * 97) % 16384), blockSize / 2);
+		midi.addEvent(juce::MidiMessage::noteOff(1, note), blockSize - 1);
+	}
+
+	//what a partner playing in step with us would have sent for this block
+	void pushPartnerBlock(MidiRTCAudioProcessor& processor, int block, int blockSize, double sampleRate)
+	{
+		const auto note = std::uint8_t(48 + block % 24);
+		const std::uint8_t messages[2][3] = { { 0x91, note, 90 }, { 0x81, note, 0 } };
+
+		for (int i = 0; i < 2; i++)
+		{
+			ReceivedMidiEvent event;
+			std::copy(messages[i], messages[i] + 3, event.data);
+			event.size = 3;
+			event.remoteTime = std::uint32_t(block * blockSize + i * (blockSize / 2));
+			event.remoteSampleRate = std::uint32_t(sampleRate);
+			event.arrivalTicks = juce::Time::getHighResolutionTicks();
+			processor.pushReceivedEvent(event);
+		}
+	}
+
+	bool waitForPartner(MidiRTCAudioProcessor& processor, const std::string& partnerId)
+	{
+		processor.setPartnerId(partnerId);
+		processor.connectToPartner();
+
+		const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(30);
+
+		while (!processor.isConnected())
+		{
+			if (std::chrono::steady_clock::now() > deadline)
+				return false;
+
+			std::this_thread::sleep_for(std::chrono::milliseconds(50));
+		}
+
+		return true;
+	}
+}
+
+void* operator new(std::size_t size)
+{
+	if (isCounting)
+		numAllocations.fetch_add(1, std::memory_order_relaxed);
+
+	if (auto* memory = std::malloc(size > 0 ? size : 1))
+		return memory;
+
+	throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size)
+{
+	return operator new(size);
+}
+
+void operator delete(void* memory) noexcept
+{
+	if (isCounting && memory != nullptr)
+		numFrees.fetch_add(1, std::memory_order_relaxed);
+
+	std::free(memory);
+}
+
+void operator delete[](void* memory) noexcept
+{
+	operator delete(memory);
+}
+
+void operator delete(void* memory, std::size_t) noexcept
+{
+	operator delete(memory);
+}
+
+void operator delete[](void* memory, std::size_t) noexcept
+{
+	operator delete(memory);
+}
+
+int main(int argc, char** argv)
+{
+	Options options;
+
+	for (int i = 1; i < argc; i++)
+	{
+		const auto hasValue = i + 1 < argc;
+
+		if (std::strcmp(argv[i], "--blocks") == 0 && hasValue)
+			options.numBlocks = std::atoi(argv[++i]);
+		else if (std::strcmp(argv[i], "--block-size") == 0 && hasValue)
+			options.blockSize = std::atoi(argv[++i]);
+		else if (std::strcmp(argv[i], "--partner") == 0 && hasValue)
+			options.partnerId = argv[++i];
+		else
+		{
+			std::fprintf(stderr, "usage: %s [--blocks N] [--block-size N] [--partner ID]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	if (options.numBlocks <= 0 || options.blockSize <= 0)
+		return 1;
+
+	const juce::ScopedJuceInitialiser_GUI juceInitialiser;
+	constexpr double sampleRate = 48000.0;
+
+	//outlives the processor, whose sender thread may still be using it
+	LoopbackSink loopback;
+
+	MidiRTCAudioProcessor processor;
+	processor.prepareToPlay(sampleRate, options.blockSize);
+
+	const auto isLoopback = options.partnerId.empty();
+	const auto isConnected = !isLoopback && waitForPartner(processor, options.partnerId);
+
+	if (isLoopback)
+		processor.openLoopback(loopback);
+	else if (!isConnected)
+		std::fprintf(stderr, "No channel to %s, running without\n", options.partnerId.c_str());
+
+	juce::AudioBuffer<float> audio(2, options.blockSize);
+	juce::MidiBuffer midi;
+	midi.ensureSize(2048);
+
+	const auto blockDuration = std::chrono::microseconds(std::int64_t(1.0e6 * options.blockSize / sampleRate));
+	auto nextBlock = std::chrono::steady_clock::now();
+
+	for (int block = 0; block < options.numBlocks; block++)
+	{
+		fillBlock(midi, block, options.blockSize);
+
+		if (isLoopback)
+			pushPartnerBlock(processor, block, options.blockSize, sampleRate);
+
+		{
+			const ScopedCounting counting;
+			processor.processBlock(audio, midi);
+		}
+
+		//with a partner the blocks come at the pace an audio device would ask for them
+		if (isConnected)
+		{
+			nextBlock += blockDuration;
+			std::this_thread::sleep_until(nextBlock);
+		}
+	}
+
+	processor.releaseResources();
+
+	const auto allocations = numAllocations.load();
+	const auto frees = numFrees.load();
+	const auto packetsSent = processor.getSenderStats().packetsSent;
+	const auto eventsPlayed = processor.getJitterBufferStats().eventsPlayed;
+
+	std::printf("blocks,block_size,transport,allocations,frees,packets_sent,events_played\n");
+	std::printf("%d,%d,%s,%llu,%llu,%llu,%llu\n", options.numBlocks, options.blockSize,
+		isLoopback ? "loopback" : isConnected ? "partner" : "none",
+		(unsigned long long) allocations, (unsigned long long) frees,
+		(unsigned long long) packetsSent, (unsigned long long) eventsPlayed);
+
+	if (isLoopback && (loopback.numPackets.load() == 0 || eventsPlayed == 0))
+	{
+		std::fprintf(stderr, "Loopback sent or played nothing, processBlock was not exercised\n");
+		return 1;
+	}
+
+	return allocations == 0 && frees == 0 ? 0 : 1;
+}